@@ -215,15 +215,8 @@ static void
 ArchFree(void *ap)
 {
     Arch *a = (Arch *)ap;
-    Hash_Search search;
-    Hash_Entry *entry;
-
-    /* Free memory from hash entries */
-    for (entry = Hash_EnumFirst(&a->members, &search);
-	 entry != NULL;
-	 entry = Hash_EnumNext(&search))
-	free(Hash_GetValue(entry));
 
+    /* The member headers are in the arena. */
     free(a->name);
     free(a->fnametab);
     Hash_DeleteTable(&a->members);
@@ -658,7 +651,7 @@ ArchStatMember(const char *archive, const char *member, Boolean hash)
 	    {
 		Hash_Entry *he;
 		he = Hash_CreateEntry(&ar->members, memName, NULL);
-		Hash_SetValue(he, bmake_malloc(sizeof(struct ar_hdr)));
+		Hash_SetValue(he, bmake_arena_alloc(sizeof(struct ar_hdr)));
 		memcpy(Hash_GetValue(he), &arh, sizeof(struct ar_hdr));
 	    }
 	}
@@ -1027,10 +1020,10 @@ Arch_MTime(GNode *gn)
 time_t
 Arch_MemMTime(GNode *gn)
 {
-    GNodeListNode *ln;
+    unsigned int i;
 
-    for (ln = gn->parents->first; ln != NULL; ln = ln->next) {
-	GNode *pgn = ln->datum;
+    for (i = 0; i < gn->parents.len; i++) {
+	GNode *pgn = GNodeVec_Get(&gn->parents, i);
 
 	if (pgn->type & OP_ARCHV) {
 	    /*
@@ -1085,7 +1078,7 @@ Arch_FindLib(GNode *gn, SearchPath *path)
     libName = bmake_malloc(sz);
     snprintf(libName, sz, "lib%s.a", &gn->name[2]);
 
-    gn->path = Dir_FindFile(libName, path);
+    Targ_SetPath(gn, Dir_FindFile(libName, path));
 
     free(libName);
 
@@ -1136,9 +1129,9 @@ Arch_LibOODate(GNode *gn)
 
     if (gn->type & OP_PHONY) {
 	oodate = TRUE;
-    } else if (OP_NOP(gn->type) && Lst_IsEmpty(gn->children)) {
+    } else if (OP_NOP(gn->type) && GNodeVec_IsEmpty(&gn->children)) {
 	oodate = FALSE;
-    } else if ((!Lst_IsEmpty(gn->children) && gn->cmgn == NULL) ||
+    } else if ((!GNodeVec_IsEmpty(&gn->children) && gn->cmgn == NULL) ||
 	       (gn->mtime > now) ||
 	       (gn->cmgn != NULL && gn->mtime < gn->cmgn->mtime)) {
 	oodate = TRUE;
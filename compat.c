@@ -98,6 +98,8 @@
 #include "metachar.h"
 #include "pathnames.h"
 
+extern char **environ;
+
 /*	"@(#)compat.c	8.2 (Berkeley) 3/19/94"	*/
 MAKE_RCSID("$NetBSD: compat.c,v 1.165 2020/10/05 19:27:47 rillig Exp $");
 
@@ -195,6 +197,8 @@ Compat_RunCommand(const char *cmdp, struct GNode *gn)
     Boolean useShell;		/* TRUE if command should be executed
 				 * using a shell */
     const char *volatile cmd = cmdp;
+    char **env;			/* Environment for the child */
+    char **volatile parentEnv;	/* Our own environment */
 
     silent = (gn->type & OP_SILENT) != 0;
     errCheck = !(gn->type & OP_IGNORE);
@@ -338,22 +342,29 @@ Compat_RunCommand(const char *cmdp, struct GNode *gn)
 
     /*
      * Fork and execute the single command. If the fork fails, we abort.
+     *
+     * Since execvp needs the path search, the child switches to its own
+     * environment by setting environ.  After vfork, this also affects the
+     * parent, which therefore restores its environment.
      */
+    env = Var_ExportVars();
+    parentEnv = environ;
     compatChild = cpid = vFork();
     if (cpid < 0) {
 	Fatal("Could not fork");
     }
     if (cpid == 0) {
-	Var_ExportVars();
 #ifdef USE_META
 	if (useMeta) {
 	    meta_compat_child();
 	}
 #endif
+	environ = env;
 	(void)execvp(av[0], (char *const *)UNCONST(av));
 	execError("exec", av[0]);
 	_exit(1);
     }
+    environ = parentEnv;
 
     free(mav);
     free(bp);
@@ -467,11 +478,11 @@ RunCommands(GNode *gn)
 }
 
 static void
-MakeNodes(GNodeList *gnodes, GNode *pgn)
+MakeNodes(GNodeVec *gnodes, GNode *pgn)
 {
-    GNodeListNode *ln;
-    for (ln = gnodes->first; ln != NULL; ln = ln->next) {
-	GNode *cohort = ln->datum;
+    unsigned int i;
+    for (i = 0; i < gnodes->len; i++) {
+	GNode *cohort = GNodeVec_Get(gnodes, i);
 	Compat_Make(cohort, pgn);
     }
 }
@@ -502,14 +513,14 @@ Compat_Make(GNode *gn, GNode *pgn)
 	gn->made = BEINGMADE;
 	if (!(gn->type & OP_MADE))
 	    Suff_FindDeps(gn);
-	MakeNodes(gn->children, gn);
+	MakeNodes(&gn->children, gn);
 	if (!(gn->flags & REMAKE)) {
 	    gn->made = ABORTED;
 	    pgn->flags &= ~(unsigned)REMAKE;
 	    goto cohorts;
 	}
 
-	if (Lst_FindDatum(gn->implicitParents, pgn) != NULL) {
+	if (GNodeVec_IndexOf(&gn->implicitParents, pgn) >= 0) {
 	    char *target_freeIt;
 	    Var_Set(IMPSRC, Var_Value(TARGET, gn, &target_freeIt), pgn);
 	    bmake_free(target_freeIt);
@@ -608,7 +619,7 @@ Compat_Make(GNode *gn, GNode *pgn)
 	 */
 	pgn->flags &= ~(unsigned)REMAKE;
     } else {
-	if (Lst_FindDatum(gn->implicitParents, pgn) != NULL) {
+	if (GNodeVec_IndexOf(&gn->implicitParents, pgn) >= 0) {
 	    char *target_freeIt;
 	    const char *target = Var_Value(TARGET, gn, &target_freeIt);
 	    Var_Set(IMPSRC, target != NULL ? target : "", pgn);
@@ -637,7 +648,7 @@ Compat_Make(GNode *gn, GNode *pgn)
     }
 
 cohorts:
-    MakeNodes(gn->cohorts, pgn);
+    MakeNodes(&gn->cohorts, pgn);
 }
 
 /* Initialize this module and start making.
@@ -138,6 +138,60 @@ typedef enum {
     TOK_LPAREN, TOK_RPAREN, TOK_EOF, TOK_NONE, TOK_ERROR
 } Token;
 
+/*
+ * A condition from a .if line that has been parsed before is kept in
+ * condCache as a tree of CondNode.  Evaluating the condition again then
+ * only needs to evaluate the variable expressions in the operands, not to
+ * parse the whole condition again.
+ *
+ * The tree is recorded by the parser itself while it evaluates the
+ * condition for the first time, which ensures that it describes exactly
+ * what the parser would do.
+ */
+typedef enum {
+    CN_OR,			/* left || right */
+    CN_AND,			/* left && right */
+    CN_NOT,			/* ! left */
+    CN_COMPARE,			/* lhs op rhs */
+    CN_NOTEMPTY,		/* lhs, without an operator */
+    CN_FUNC,			/* func(lhs) */
+    CN_EMPTY,			/* empty(lhs) */
+    CN_DEFAULT			/* lhs, for the default function */
+} CondNodeKind;
+
+/* Part of an operand, either literal text or a variable expression. */
+typedef struct CondPart {
+    struct CondPart *next;
+    const char *text;		/* the literal text, or the start of the
+				 * variable expression in the condition */
+    size_t len;			/* the length of the literal text */
+    Boolean isExpr;
+} CondPart;
+
+typedef struct CondOperand {
+    CondPart *first;
+    CondPart **tail;
+    Boolean quoted;
+} CondOperand;
+
+typedef struct CondNode {
+    struct CondNode *allocNext;	/* all nodes of the condition, for freeing */
+    CondNodeKind kind;
+    struct CondNode *left;
+    struct CondNode *right;
+    CondOperand lhs;
+    CondOperand rhs;
+    const char *op;		/* the comparison operator, in the condition */
+    Boolean (*func)(size_t, const char *);
+} CondNode;
+
+/* A condition in condCache. */
+typedef struct CondCached {
+    char *text;			/* the condition, which the tree points into */
+    CondNode *tree;
+    CondNode *allocated;	/* all nodes of the tree */
+} CondCached;
+
 typedef struct CondParser {
     const struct If *if_info;	/* Info for current statement */
     const char *p;		/* The remaining condition to parse */
@@ -148,6 +202,13 @@ typedef struct CondParser {
      * therefore it makes sense to suppress the standard "Malformed
      * conditional" message. */
     Boolean printedError;
+
+    /* Whether to record the tree of the condition while parsing it. */
+    Boolean record;
+    CondNode *node;		/* the most recently parsed term */
+    CondNode *allocated;	/* all recorded nodes */
+    Boolean uncacheable;	/* the tree doesn't describe everything that
+				 * happened, such as error messages */
 } CondParser;
 
 static Token CondParser_Expr(CondParser *par, Boolean);
@@ -167,6 +228,81 @@ static unsigned int cond_min_depth = 0;	/* depth at makefile open */
  */
 static Boolean lhsStrict;
 
+static CondNode *
+CondParser_NewNode(CondParser *par, CondNodeKind kind,
+		   CondNode *left, CondNode *right)
+{
+    CondNode *node = bmake_malloc(sizeof *node);
+
+    node->allocNext = par->allocated;
+    par->allocated = node;
+    node->kind = kind;
+    node->left = left;
+    node->right = right;
+    node->lhs.first = NULL;
+    node->lhs.tail = &node->lhs.first;
+    node->lhs.quoted = FALSE;
+    node->rhs.first = NULL;
+    node->rhs.tail = &node->rhs.first;
+    node->rhs.quoted = FALSE;
+    node->op = NULL;
+    node->func = NULL;
+    return node;
+}
+
+static void
+CondOperand_Add(CondOperand *operand, const char *text, size_t len,
+		Boolean isExpr)
+{
+    CondPart *part = bmake_malloc(sizeof *part);
+
+    part->next = NULL;
+    part->text = isExpr ? text : bmake_strldup(text, len);
+    part->len = len;
+    part->isExpr = isExpr;
+    *operand->tail = part;
+    operand->tail = &part->next;
+}
+
+static void
+CondOperand_Done(CondOperand *operand)
+{
+    CondPart *part, *next;
+
+    for (part = operand->first; part != NULL; part = next) {
+	next = part->next;
+	if (!part->isExpr)
+	    free(UNCONST(part->text));
+	free(part);
+    }
+}
+
+static void
+CondNodes_Free(CondNode *node)
+{
+    CondNode *next;
+
+    for (; node != NULL; node = next) {
+	next = node->allocNext;
+	CondOperand_Done(&node->lhs);
+	CondOperand_Done(&node->rhs);
+	free(node);
+    }
+}
+
+/* Add the literal text that has been collected in the buffer since the
+ * last call to the operand that is being recorded. */
+static void
+CondOperand_AddLiteral(CondOperand *operand, Buffer *buf, size_t *inout_len)
+{
+    size_t len = Buf_Len(buf);
+
+    if (operand != NULL && len > *inout_len)
+	CondOperand_Add(operand, Buf_GetAll(buf, NULL) + *inout_len,
+			len - *inout_len, FALSE);
+    *inout_len = len;
+}
+
 static int
 is_token(const char *str, const char *tok, size_t len)
 {
@@ -202,12 +338,13 @@ CondParser_SkipWhitespace(CondParser *par)
  *
  * Return the length of the argument. */
 static size_t
-ParseFuncArg(const char **pp, Boolean doEval, const char *func,
-	     char **out_arg) {
+ParseFuncArg(CondParser *par, const char **pp, Boolean doEval,
+	     const char *func, char **out_arg, CondOperand *rec) {
     const char *p = *pp;
     Buffer argBuf;
     int paren_depth;
     size_t argLen;
+    size_t recorded = 0;
 
     if (func != NULL)
 	p++;			/* Skip opening '(' - verified by caller */
@@ -220,6 +357,7 @@ ParseFuncArg(const char **pp, Boolean doEval, const char *func,
 	 * the word 'make' or 'defined' at the beginning of a symbol...
 	 */
 	*out_arg = NULL;
+	par->uncacheable = TRUE;
 	return 0;
     }
 
@@ -246,10 +384,18 @@ ParseFuncArg(const char **pp, Boolean doEval, const char *func,
 	    void *nestedVal_freeIt;
 	    VarEvalFlags eflags = VARE_UNDEFERR | (doEval ? VARE_WANTRES : 0);
 	    const char *nestedVal;
-	    (void)Var_Parse(&p, VAR_CMD, eflags, &nestedVal, &nestedVal_freeIt);
+	    VarParseResult res;
+
+	    CondOperand_AddLiteral(rec, &argBuf, &recorded);
+	    if (rec != NULL)
+		CondOperand_Add(rec, p, 0, TRUE);
+	    res = Var_Parse(&p, VAR_CMD, eflags, &nestedVal, &nestedVal_freeIt);
 	    /* TODO: handle errors */
+	    if (nestedVal == var_Error && res != VPR_UNDEF_SILENT)
+		par->uncacheable = TRUE;
 	    Buf_AddStr(&argBuf, nestedVal);
 	    free(nestedVal_freeIt);
+	    recorded = Buf_Len(&argBuf);
 	    continue;
 	}
 	if (ch == '(')
@@ -260,6 +406,7 @@ ParseFuncArg(const char **pp, Boolean doEval, const char *func,
 	p++;
     }
 
+    CondOperand_AddLiteral(rec, &argBuf, &recorded);
     *out_arg = Buf_GetAll(&argBuf, &argLen);
     Buf_Destroy(&argBuf, FALSE);
 
@@ -270,6 +417,7 @@ ParseFuncArg(const char **pp, Boolean doEval, const char *func,
     if (func != NULL && *p++ != ')') {
 	Parse_Error(PARSE_WARNING, "Missing closing parenthesis for %s()",
 		    func);
+	par->uncacheable = TRUE;
 	/* The PARSE_FATAL is done as a follow-up by CondEvalExpression. */
 	return 0;
     }
@@ -302,22 +450,49 @@ FuncMake(size_t argLen MAKE_ATTR_UNUSED, const char *arg)
     return Lst_Find(create, CondFindStrMatch, arg) != NULL;
 }
 
+/* The result of exists(), for the state of the search path and the file
+ * system given by generation. */
+typedef struct ExistsResult {
+    unsigned int generation;
+    char *path;			/* where the file was found, or NULL */
+} ExistsResult;
+
 /* See if the given file exists. */
 static Boolean
 FuncExists(size_t argLen MAKE_ATTR_UNUSED, const char *arg)
 {
-    Boolean result;
-    char *path;
-
-    path = Dir_FindFile(arg, dirSearchPath);
-    DEBUG2(COND, "exists(%s) result is \"%s\"\n", arg, path ? path : "");
-    if (path != NULL) {
-	result = TRUE;
-	free(path);
-    } else {
-	result = FALSE;
+    static Hash_Table existsCache;
+    static Boolean existsCacheInit = FALSE;
+    Hash_Entry *he;
+    ExistsResult *er;
+    Boolean isNew;
+
+    /*
+     * Makefiles that probe for optional features call exists() on the
+     * same paths over and over, and for a path that does not exist, each
+     * of these calls costs at least one stat(2).
+     */
+    if (!existsCacheInit) {
+	Hash_InitTable(&existsCache);
+	existsCacheInit = TRUE;
     }
-    return result;
+    he = Hash_CreateEntry(&existsCache, arg, &isNew);
+    er = Hash_GetValue(he);
+    if (isNew) {
+	er = bmake_malloc(sizeof *er);
+	er->path = NULL;
+	Hash_SetValue(he, er);
+    }
+    if (isNew || er->generation != Dir_Generation()) {
+	free(er->path);
+	er->path = Dir_FindFile(arg, dirSearchPath);
+	er->generation = Dir_Generation();
+    }
+
+    DEBUG2(COND, "exists(%s) result is \"%s\"\n",
+	   arg, er->path ? er->path : "");
+    Snapshot_Search(arg, dirSearchPath);
+    return er->path != NULL;
 }
 
 /* See if the given node exists and is an actual target. */
@@ -392,7 +567,7 @@ is_separator(char ch)
 /* coverity:[+alloc : arg-*4] */
 static const char *
 CondParser_String(CondParser *par, Boolean doEval, Boolean strictLHS,
-		  Boolean *quoted, void **freeIt)
+		  Boolean *quoted, void **freeIt, CondOperand *rec)
 {
     Buffer buf;
     const char *str;
@@ -402,11 +577,14 @@ CondParser_String(CondParser *par, Boolean doEval, Boolean strictLHS,
     const char *start;
     VarEvalFlags eflags;
     VarParseResult parseResult;
+    size_t recorded = 0;
 
     Buf_Init(&buf, 0);
     str = NULL;
     *freeIt = NULL;
     *quoted = qt = par->p[0] == '"' ? 1 : 0;
+    if (rec != NULL)
+	rec->quoted = qt;
     if (qt)
 	par->p++;
     start = par->p;
@@ -445,11 +623,15 @@ CondParser_String(CondParser *par, Boolean doEval, Boolean strictLHS,
 		     (doEval ? VARE_WANTRES : 0);
 	    nested_p = par->p;
 	    atStart = nested_p == start;
+	    CondOperand_AddLiteral(rec, &buf, &recorded);
+	    if (rec != NULL)
+		CondOperand_Add(rec, nested_p, 0, TRUE);
 	    parseResult = Var_Parse(&nested_p, VAR_CMD, eflags, &str, freeIt);
 	    /* TODO: handle errors */
 	    if (str == var_Error) {
 	        if (parseResult & VPR_ANY_MSG)
 	            par->printedError = TRUE;
+		par->uncacheable = TRUE;
 		if (*freeIt) {
 		    free(*freeIt);
 		    *freeIt = NULL;
@@ -473,6 +655,7 @@ CondParser_String(CondParser *par, Boolean doEval, Boolean strictLHS,
 		goto cleanup;
 
 	    Buf_AddStr(&buf, str);
+	    recorded = Buf_Len(&buf);
 	    if (*freeIt) {
 		free(*freeIt);
 		*freeIt = NULL;
@@ -495,6 +678,7 @@ CondParser_String(CondParser *par, Boolean doEval, Boolean strictLHS,
 	}
     }
 got_str:
+    CondOperand_AddLiteral(rec, &buf, &recorded);
     *freeIt = Buf_GetAll(&buf, NULL);
     str = *freeIt;
 cleanup:
@@ -611,16 +795,21 @@ CondParser_Comparison(CondParser *par, Boolean doEval)
     const char *lhs, *op, *rhs;
     void *lhsFree, *rhsFree;
     Boolean lhsQuoted, rhsQuoted;
+    CondNode *node = NULL;
 
     rhs = NULL;
     lhsFree = rhsFree = NULL;
     lhsQuoted = rhsQuoted = FALSE;
 
+    if (par->record)
+	node = par->node = CondParser_NewNode(par, CN_NOTEMPTY, NULL, NULL);
+
     /*
      * Parse the variable spec and skip over it, saving its
      * value in lhs.
      */
-    lhs = CondParser_String(par, doEval, lhsStrict, &lhsQuoted, &lhsFree);
+    lhs = CondParser_String(par, doEval, lhsStrict, &lhsQuoted, &lhsFree,
+			    node != NULL ? &node->lhs : NULL);
     if (!lhs)
 	goto done;
 
@@ -647,6 +836,10 @@ CondParser_Comparison(CondParser *par, Boolean doEval)
 	t = doEval ? EvalNotEmpty(par, lhs, lhsQuoted) : TOK_FALSE;
 	goto done;
     }
+    if (node != NULL) {
+	node->kind = CN_COMPARE;
+	node->op = op;
+    }
 
     CondParser_SkipWhitespace(par);
 
@@ -656,7 +849,8 @@ CondParser_Comparison(CondParser *par, Boolean doEval)
 	goto done;
     }
 
-    rhs = CondParser_String(par, doEval, FALSE, &rhsQuoted, &rhsFree);
+    rhs = CondParser_String(par, doEval, FALSE, &rhsQuoted, &rhsFree,
+			    node != NULL ? &node->rhs : NULL);
     if (rhs == NULL)
 	goto done;
 
@@ -674,8 +868,9 @@ done:
 }
 
 static size_t
-ParseEmptyArg(const char **linePtr, Boolean doEval,
-	      const char *func MAKE_ATTR_UNUSED, char **argPtr)
+ParseEmptyArg(CondParser *par, const char **linePtr, Boolean doEval,
+	      const char *func MAKE_ATTR_UNUSED, char **argPtr,
+	      CondOperand *rec)
 {
     void *val_freeIt;
     const char *val;
@@ -685,6 +880,8 @@ ParseEmptyArg(const char **linePtr, Boolean doEval,
     *argPtr = NULL;
 
     (*linePtr)--;		/* Make (*linePtr)[1] point to the '('. */
+    if (rec != NULL)
+	CondOperand_Add(rec, *linePtr, 0, TRUE);
     (void)Var_Parse(linePtr, VAR_CMD, doEval ? VARE_WANTRES : 0,
 		    &val, &val_freeIt);
     /* TODO: handle errors */
@@ -692,6 +889,7 @@ ParseEmptyArg(const char **linePtr, Boolean doEval,
 
     if (val == var_Error) {
 	free(val_freeIt);
+	par->uncacheable = TRUE;
 	return (size_t)-1;
     }
 
@@ -720,7 +918,8 @@ CondParser_Func(CondParser *par, Boolean doEval)
     static const struct fn_def {
 	const char *fn_name;
 	size_t fn_name_len;
-	size_t (*fn_parse)(const char **, Boolean, const char *, char **);
+	size_t (*fn_parse)(CondParser *, const char **, Boolean, const char *,
+			   char **, CondOperand *);
 	Boolean (*fn_eval)(size_t, const char *);
     } fn_defs[] = {
 	{ "defined",  7, ParseFuncArg,  FuncDefined },
@@ -737,6 +936,7 @@ CondParser_Func(CondParser *par, Boolean doEval)
     size_t arglen;
     const char *cp = par->p;
     const char *cp1;
+    CondNode *node = NULL;
 
     for (fn_def = fn_defs; fn_def->fn_name != NULL; fn_def++) {
 	if (!is_token(cp, fn_def->fn_name, fn_def->fn_name_len))
@@ -747,7 +947,14 @@ CondParser_Func(CondParser *par, Boolean doEval)
 	if (*cp != '(')
 	    break;
 
-	arglen = fn_def->fn_parse(&cp, doEval, fn_def->fn_name, &arg);
+	if (par->record) {
+	    node = par->node = CondParser_NewNode(par,
+		fn_def->fn_parse == ParseEmptyArg ? CN_EMPTY : CN_FUNC,
+		NULL, NULL);
+	    node->func = fn_def->fn_eval;
+	}
+	arglen = fn_def->fn_parse(par, &cp, doEval, fn_def->fn_name, &arg,
+				  node != NULL ? &node->lhs : NULL);
 	if (arglen == 0 || arglen == (size_t)-1) {
 	    par->p = cp;
 	    return arglen == 0 ? TOK_FALSE : TOK_ERROR;
@@ -772,12 +979,17 @@ CondParser_Func(CondParser *par, Boolean doEval)
      * would be invalid if we did "defined(a)" - so instead treat as an
      * expression.
      */
-    arglen = ParseFuncArg(&cp, doEval, NULL, &arg);
+    if (par->record)
+	node = CondParser_NewNode(par, CN_DEFAULT, NULL, NULL);
+    arglen = ParseFuncArg(par, &cp, doEval, NULL, &arg,
+			  node != NULL ? &node->lhs : NULL);
     cp1 = cp;
     cpp_skip_whitespace(&cp1);
     if (*cp1 == '=' || *cp1 == '!')
 	return CondParser_Comparison(par, doEval);
     par->p = cp;
+    if (node != NULL)
+	par->node = node;
 
     /*
      * Evaluate the argument using the default function.
@@ -876,9 +1088,11 @@ CondParser_Term(CondParser *par, Boolean doEval)
 	 */
 	t = CondParser_Expr(par, doEval);
 	if (t != TOK_ERROR) {
+	    CondNode *node = par->node;
 	    if (CondParser_Token(par, doEval) != TOK_RPAREN) {
 		t = TOK_ERROR;
 	    }
+	    par->node = node;
 	}
     } else if (t == TOK_NOT) {
 	t = CondParser_Term(par, doEval);
@@ -887,7 +1101,15 @@ CondParser_Term(CondParser *par, Boolean doEval)
 	} else if (t == TOK_FALSE) {
 	    t = TOK_TRUE;
 	}
+	if (par->record)
+	    par->node = CondParser_NewNode(par, CN_NOT, par->node, NULL);
     }
+    /*
+     * An error in a part of the condition that is not evaluated is
+     * ignored, but evaluating that part later would fail.
+     */
+    if (t == TOK_ERROR)
+	par->uncacheable = TRUE;
     return t;
 }
 
@@ -905,6 +1127,7 @@ CondParser_Factor(CondParser *par, Boolean doEval)
 
     l = CondParser_Term(par, doEval);
     if (l != TOK_ERROR) {
+	CondNode *left = par->node;
 	o = CondParser_Token(par, doEval);
 
 	if (o == TOK_AND) {
@@ -921,11 +1144,14 @@ CondParser_Factor(CondParser *par, Boolean doEval)
 	    } else {
 		(void)CondParser_Factor(par, FALSE);
 	    }
+	    if (par->record)
+		par->node = CondParser_NewNode(par, CN_AND, left, par->node);
 	} else {
 	    /*
 	     * F -> T
 	     */
 	    CondParser_PushBack(par, o);
+	    par->node = left;
 	}
     }
     return l;
@@ -945,6 +1171,7 @@ CondParser_Expr(CondParser *par, Boolean doEval)
 
     l = CondParser_Factor(par, doEval);
     if (l != TOK_ERROR) {
+	CondNode *left = par->node;
 	o = CondParser_Token(par, doEval);
 
 	if (o == TOK_OR) {
@@ -961,11 +1188,14 @@ CondParser_Expr(CondParser *par, Boolean doEval)
 	    } else {
 		(void)CondParser_Expr(par, FALSE);
 	    }
+	    if (par->record)
+		par->node = CondParser_NewNode(par, CN_OR, left, par->node);
 	} else {
 	    /*
 	     * E -> F
 	     */
 	    CondParser_PushBack(par, o);
+	    par->node = left;
 	}
     }
     return l;
@@ -975,6 +1205,7 @@ static CondEvalResult
 CondParser_Eval(CondParser *par, Boolean *value)
 {
     Token res;
+    CondNode *root;
 
     DEBUG1(COND, "CondParser_Eval: %s\n", par->p);
 
@@ -982,8 +1213,10 @@ CondParser_Eval(CondParser *par, Boolean *value)
     if (res != TOK_FALSE && res != TOK_TRUE)
 	return COND_INVALID;
 
+    root = par->node;
     if (CondParser_Token(par, TRUE /* XXX: Why TRUE? */) != TOK_EOF)
 	return COND_INVALID;
+    par->node = root;
 
     *value = res == TOK_TRUE;
     return COND_PARSE;
@@ -1001,11 +1234,12 @@ CondParser_Eval(CondParser *par, Boolean *value)
  */
 static CondEvalResult
 CondEvalExpression(const struct If *info, const char *cond, Boolean *value,
-		    Boolean eprint, Boolean strictLHS)
+		    Boolean eprint, Boolean strictLHS, CondCached *out_cached)
 {
     static const struct If *dflt_info;
     CondParser par;
     int rval;
+    Boolean savedLhsStrict = lhsStrict;
 
     lhsStrict = strictLHS;
 
@@ -1025,19 +1259,257 @@ CondEvalExpression(const struct If *info, const char *cond, Boolean *value,
     par.p = cond;
     par.curr = TOK_NONE;
     par.printedError = FALSE;
+    par.record = out_cached != NULL;
+    par.node = NULL;
+    par.allocated = NULL;
+    par.uncacheable = FALSE;
 
     rval = CondParser_Eval(&par, value);
 
     if (rval == COND_INVALID && eprint && !par.printedError)
 	Parse_Error(PARSE_FATAL, "Malformed conditional (%s)", cond);
 
+    if (out_cached != NULL) {
+	if (rval == COND_PARSE && !par.uncacheable) {
+	    out_cached->tree = par.node;
+	    out_cached->allocated = par.allocated;
+	} else {
+	    CondNodes_Free(par.allocated);
+	    out_cached->tree = NULL;
+	}
+    }
+
+    lhsStrict = savedLhsStrict;
     return rval;
 }
 
+/* Evaluate an operand of a recorded condition, in the same way as
+ * CondParser_String or ParseFuncArg would.
+ *
+ * Return the value of the operand, or NULL on error. */
+static const char *
+CondOperand_Eval(CondParser *par, const CondOperand *operand,
+		 Boolean funcArg, void **freeIt)
+{
+    VarEvalFlags eflags = VARE_WANTRES;
+    const CondPart *part;
+    Buffer buf;
+
+    if (funcArg || !operand->quoted)
+	eflags |= VARE_UNDEFERR;
+
+    *freeIt = NULL;
+    Buf_Init(&buf, 0);
+    for (part = operand->first; part != NULL; part = part->next) {
+	const char *p = part->text;
+	const char *val;
+	void *val_freeIt;
+	VarParseResult res;
+
+	if (!part->isExpr) {
+	    Buf_AddBytes(&buf, part->text, part->len);
+	    continue;
+	}
+
+	res = Var_Parse(&p, VAR_CMD, eflags, &val, &val_freeIt);
+	/* TODO: handle errors */
+	if (val == var_Error && !funcArg) {
+	    if (res & VPR_ANY_MSG)
+		par->printedError = TRUE;
+	    free(val_freeIt);
+	    Buf_Destroy(&buf, TRUE);
+	    return NULL;
+	}
+	if (part == operand->first && part->next == NULL) {
+	    Buf_Destroy(&buf, TRUE);
+	    *freeIt = val_freeIt;
+	    return val;
+	}
+	Buf_AddStr(&buf, val);
+	free(val_freeIt);
+    }
+    *freeIt = Buf_Destroy(&buf, FALSE);
+    return *freeIt;
+}
+
+/* Evaluate a recorded condition, with the current values of the variables.
+ * This has the same effect as parsing the condition again, except that
+ * the parts of the condition that are not needed for the result are not
+ * looked at at all. */
+static Token
+CondNode_Eval(CondParser *par, const CondNode *node)
+{
+    const char *lhs, *rhs, *p;
+    void *lhsFree, *rhsFree;
+    char *arg;
+    size_t arglen;
+    Token t;
+
+    switch (node->kind) {
+    case CN_OR:
+	t = CondNode_Eval(par, node->left);
+	return t == TOK_FALSE ? CondNode_Eval(par, node->right) : t;
+    case CN_AND:
+	t = CondNode_Eval(par, node->left);
+	return t == TOK_TRUE ? CondNode_Eval(par, node->right) : t;
+    case CN_NOT:
+	t = CondNode_Eval(par, node->left);
+	if (t == TOK_TRUE || t == TOK_FALSE)
+	    t = !t;
+	return t;
+    case CN_EMPTY:
+	p = node->lhs.first->text + 1;
+	arglen = ParseEmptyArg(par, &p, TRUE, "empty", &arg, NULL);
+	if (arglen == (size_t)-1)
+	    return TOK_ERROR;
+	return FuncEmpty(arglen, arg);
+    default:
+	break;
+    }
+
+    lhs = CondOperand_Eval(par, &node->lhs,
+			   node->kind == CN_FUNC || node->kind == CN_DEFAULT,
+			   &lhsFree);
+    if (lhs == NULL)
+	return TOK_ERROR;
+
+    switch (node->kind) {
+    case CN_COMPARE:
+	rhs = CondOperand_Eval(par, &node->rhs, FALSE, &rhsFree);
+	if (rhs == NULL) {
+	    t = TOK_ERROR;
+	    break;
+	}
+	t = EvalCompare(lhs, node->lhs.quoted, node->op,
+			rhs, node->rhs.quoted);
+	free(rhsFree);
+	break;
+    case CN_NOTEMPTY:
+	t = EvalNotEmpty(par, lhs, node->lhs.quoted);
+	break;
+    case CN_FUNC:
+	arglen = strlen(lhs);
+	t = arglen != 0 && node->func(arglen, lhs);
+	break;
+    default:
+	t = par->if_info->defProc(strlen(lhs), lhs) == !par->if_info->doNot;
+	break;
+    }
+    free(lhsFree);
+    return t;
+}
+
+/* The number of conditions that are kept in condCache.  When there are more,
+ * the cache is emptied, since a makefile that has that many different
+ * conditions rarely evaluates the same one again. */
+#define COND_CACHE_MAX 4096
+
+static Hash_Table condCache[sizeof ifs / sizeof ifs[0]];
+static unsigned int condCacheSize;
+
+static void
+CondCache_Clear(void)
+{
+    Hash_Search search;
+    Hash_Entry *he;
+    size_t i;
+
+    for (i = 0; i < sizeof condCache / sizeof condCache[0]; i++) {
+	for (he = Hash_EnumFirst(&condCache[i], &search); he != NULL;
+	     he = Hash_EnumNext(&search)) {
+	    CondCached *cc = Hash_GetValue(he);
+	    CondNodes_Free(cc->allocated);
+	    free(cc->text);
+	    free(cc);
+	}
+	Hash_DeleteTable(&condCache[i]);
+	Hash_InitTable(&condCache[i]);
+    }
+    condCacheSize = 0;
+}
+
+/* Evaluate the condition from a .if line.  Conditions that are evaluated
+ * more than once, typically in makefiles that are included several times,
+ * are only parsed the first time.
+ *
+ * Conditions from the body of a .for loop are not cached if the value of an
+ * iteration variable is part of their text, since that text differs in
+ * each iteration. */
+static CondEvalResult
+CondEvalCached(const struct If *info, const char *cond, Boolean *value)
+{
+    static Boolean condCacheInit = FALSE;
+    Hash_Table *cache;
+    Hash_Key key;
+    Hash_Entry *he;
+    CondCached *cc;
+    CondParser par;
+    CondEvalResult rval;
+    Token t;
+    Boolean isNew;
+
+    if (Parse_LineHasForValue())
+	return CondEvalExpression(info, cond, value, TRUE, TRUE, NULL);
+
+    if (!condCacheInit) {
+	size_t i;
+
+	for (i = 0; i < sizeof condCache / sizeof condCache[0]; i++)
+	    Hash_InitTable(&condCache[i]);
+	condCacheInit = TRUE;
+    }
+    cache = &condCache[info - ifs];
+
+    while (*cond == ' ' || *cond == '\t')
+	cond++;
+
+    Hash_InitKey(&key, cond);
+    cc = Hash_FindValueKey(cache, &key);
+    if (cc == NULL) {
+	CondCached parsed;
+
+	parsed.text = bmake_strdup(cond);
+	rval = CondEvalExpression(info, parsed.text, value, TRUE, TRUE,
+				  &parsed);
+	if (parsed.tree == NULL) {
+	    free(parsed.text);
+	    return rval;
+	}
+	if (condCacheSize >= COND_CACHE_MAX)
+	    CondCache_Clear();
+	cc = bmake_malloc(sizeof *cc);
+	*cc = parsed;
+	he = Hash_CreateEntryKey(cache, &key, &isNew);
+	Hash_SetValue(he, cc);
+	condCacheSize++;
+	return rval;
+    }
+
+    DEBUG1(COND, "CondParser_Eval: %s (parsed before)\n", cond);
+
+    par.if_info = info;
+    par.p = cond;
+    par.curr = TOK_NONE;
+    par.printedError = FALSE;
+    par.record = FALSE;
+    par.node = NULL;
+    par.allocated = NULL;
+    par.uncacheable = FALSE;
+
+    t = CondNode_Eval(&par, cc->tree);
+    if (t != TOK_TRUE && t != TOK_FALSE) {
+	if (!par.printedError)
+	    Parse_Error(PARSE_FATAL, "Malformed conditional (%s)", cond);
+	return COND_INVALID;
+    }
+    *value = t == TOK_TRUE;
+    return COND_PARSE;
+}
+
 CondEvalResult
 Cond_EvalCondition(const char *cond, Boolean *out_value)
 {
-	return CondEvalExpression(NULL, cond, out_value, FALSE, FALSE);
+	return CondEvalExpression(NULL, cond, out_value, FALSE, FALSE, NULL);
 }
 
 /* Evaluate the conditional in the passed line. The line looks like this:
@@ -1195,7 +1667,7 @@ Cond_EvalLine(const char *line)
     }
 
     /* And evaluate the conditional expression */
-    if (CondEvalExpression(ifp, line, &value, TRUE, TRUE) == COND_INVALID) {
+    if (CondEvalCached(ifp, line, &value) == COND_INVALID) {
 	/* Syntax error in conditional, error message already output. */
 	/* Skip everything to matching .endif */
 	cond_state[cond_depth] = SKIP_TO_ELSE;
@@ -1224,6 +1696,13 @@ Cond_restore_depth(unsigned int saved_depth)
     cond_min_depth = saved_depth;
 }
 
+/* Return the current nesting level of .if directives. */
+unsigned int
+Cond_Depth(void)
+{
+    return cond_depth;
+}
+
 unsigned int
 Cond_save_depth(void)
 {
@@ -106,6 +106,9 @@
  *			is searched for along the default search path.
  *			The path and mtime fields of the node are filled in.
  *
+ *	Dir_Prefetch	Look up the modification times of many files at
+ *			once, in several processes.
+ *
  *	Dir_AddDir	Add a directory to a search path.
  *
  *	Dir_MakeFlags	Given a search path and a command flag, create
@@ -126,11 +129,21 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include "wait.h"
 
 #include <dirent.h>
 #include <errno.h>
 
 #include "make.h"
+
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+
+#if !defined(MAP_ANON) && defined(MAP_ANONYMOUS)
+#define MAP_ANON MAP_ANONYMOUS
+#endif
+#endif
+
 #include "dir.h"
 #include "job.h"
 
@@ -302,6 +315,11 @@ static Hash_Table mtimes;
 
 static Hash_Table lmtimes;	/* same as mtimes but for lstat */
 
+/* Incremented whenever a search path changes or a file may have been
+ * created or removed, to invalidate results derived from looking up
+ * files, such as those of the exists() function in conditions. */
+static unsigned int dirGeneration;
+
 /*
  * We use stat(2) a lot, cache the results.
  * mtime and mode are all we care about.
@@ -310,14 +328,42 @@ struct cache_st {
     time_t lmtime;		/* lstat */
     time_t mtime;		/* stat */
     mode_t mode;
+    Boolean prefetched;		/* mtime is from Dir_Prefetch and has not
+				 * been rechecked yet */
 };
 
 /* minimize changes below */
 typedef enum {
     CST_LSTAT = 0x01,		/* call lstat(2) instead of stat(2) */
-    CST_UPDATE = 0x02		/* ignore existing cached entry */
+    CST_UPDATE = 0x02,		/* ignore existing cached entry */
+    CST_PREFETCH = 0x04		/* the result comes from Dir_Prefetch */
 } CachedStatsFlags;
 
+/* Remember the result of a successful stat(2) or lstat(2). */
+static void
+cached_stats_store(Hash_Table *htp, Hash_Entry *entry, const char *pathname,
+		   const struct make_stat *mst, CachedStatsFlags flags)
+{
+    struct cache_st *cst;
+
+    if (entry == NULL)
+	entry = Hash_CreateEntry(htp, pathname, NULL);
+    if (Hash_GetValue(entry) == NULL) {
+	Hash_SetValue(entry, bmake_malloc(sizeof(*cst)));
+	memset(Hash_GetValue(entry), 0, sizeof(*cst));
+    }
+    cst = Hash_GetValue(entry);
+    if (flags & CST_LSTAT) {
+	cst->lmtime = mst->mst_mtime;
+    } else {
+	cst->mtime = mst->mst_mtime;
+	cst->prefetched = (flags & CST_PREFETCH) != 0;
+    }
+    cst->mode = mst->mst_mode;
+    DIR_DEBUG2("   Caching %s for %s\n",
+	       Targ_FmtTime(mst->mst_mtime), pathname);
+}
+
 /* Returns 0 and the result of stat(2) or lstat(2) in *mst, or -1 on error. */
 static int
 cached_stats(Hash_Table *htp, const char *pathname, struct make_stat *mst,
@@ -331,8 +377,27 @@ cached_stats(Hash_Table *htp, const char *pathname, struct make_stat *mst,
     if (!pathname || !pathname[0])
 	return -1;
 
+    if (flags & CST_UPDATE)
+	dirGeneration++;
+
     entry = Hash_FindEntry(htp, pathname);
 
+    /*
+     * The first recheck of a prefetched time still uses it, since nothing
+     * has been made from the file since then; see Dir_Prefetch.
+     */
+    if (entry && (flags & CST_UPDATE) && !(flags & CST_LSTAT)) {
+	cst = Hash_GetValue(entry);
+	if (cst->prefetched) {
+	    cst->prefetched = FALSE;
+	    mst->mst_mode = cst->mode;
+	    mst->mst_mtime = cst->mtime;
+	    DIR_DEBUG2("Using prefetched time %s for %s\n",
+		       Targ_FmtTime(mst->mst_mtime), pathname);
+	    return 0;
+	}
+    }
+
     if (entry && !(flags & CST_UPDATE)) {
 	cst = Hash_GetValue(entry);
 
@@ -357,22 +422,7 @@ cached_stats(Hash_Table *htp, const char *pathname, struct make_stat *mst,
     mst->mst_mode = sys_st.st_mode;
     mst->mst_mtime = sys_st.st_mtime;
 
-    if (entry == NULL)
-	entry = Hash_CreateEntry(htp, pathname, NULL);
-    if (Hash_GetValue(entry) == NULL) {
-	Hash_SetValue(entry, bmake_malloc(sizeof(*cst)));
-	memset(Hash_GetValue(entry), 0, sizeof(*cst));
-    }
-    cst = Hash_GetValue(entry);
-    if (flags & CST_LSTAT) {
-	cst->lmtime = sys_st.st_mtime;
-    } else {
-	cst->mtime = sys_st.st_mtime;
-    }
-    cst->mode = sys_st.st_mode;
-    DIR_DEBUG2("   Caching %s for %s\n",
-	       Targ_FmtTime(sys_st.st_mtime), pathname);
-
+    cached_stats_store(htp, entry, pathname, mst, flags);
     return 0;
 }
 
@@ -423,6 +473,7 @@ Dir_InitCur(const char *cdname)
 	 * Our build directory is not the same as our source directory.
 	 * Keep this one around too.
 	 */
+	dirGeneration++;
 	if ((dir = Dir_AddDir(NULL, cdname))) {
 	    dir->refCount++;
 	    if (cur && cur != dir) {
@@ -448,6 +499,7 @@ Dir_InitDot(void)
     }
 
     dot = Dir_AddDir(NULL, ".");
+    dirGeneration++;
 
     if (dot == NULL) {
 	Error("Cannot open `.' (%s)", strerror(errno));
@@ -933,17 +985,17 @@ Dir_Expand(const char *word, SearchPath *path, StringList *expansions)
  *-----------------------------------------------------------------------
  */
 static char *
-DirLookup(CachedDir *dir, const char *name MAKE_ATTR_UNUSED, const char *cp,
-	  Boolean hasSlash MAKE_ATTR_UNUSED)
+DirLookup(CachedDir *dir, const char *name MAKE_ATTR_UNUSED,
+	  const Hash_Key *base, Boolean hasSlash MAKE_ATTR_UNUSED)
 {
     char *file;			/* the current filename to check */
 
     DIR_DEBUG1("   %s ...\n", dir->name);
 
-    if (Hash_FindEntry(&dir->files, cp) == NULL)
+    if (Hash_FindEntryKey(&dir->files, base) == NULL)
 	return NULL;
 
-    file = str_concat3(dir->name, "/", cp);
+    file = str_concat3(dir->name, "/", base->str);
     DIR_DEBUG1("   returning %s\n", file);
     dir->hits++;
     hits++;
@@ -1006,8 +1058,9 @@ DirLookupSubdir(CachedDir *dir, const char *name)
  *-----------------------------------------------------------------------
  */
 static char *
-DirLookupAbs(CachedDir *dir, const char *name, const char *cp)
+DirLookupAbs(CachedDir *dir, const char *name, const Hash_Key *base)
 {
+    const char *cp = base->str;
     char *p1;			/* pointer into dir->name */
     const char *p2;		/* pointer into name */
 
@@ -1026,7 +1079,7 @@ DirLookupAbs(CachedDir *dir, const char *name, const char *cp)
 	return NULL;
     }
 
-    if (Hash_FindEntry(&dir->files, cp) == NULL) {
+    if (Hash_FindEntryKey(&dir->files, base) == NULL) {
 	DIR_DEBUG0("   must be here but isn't -- returning\n");
 	/* Return empty string: terminates search */
 	return bmake_strdup("");
@@ -1052,20 +1105,21 @@ DirLookupAbs(CachedDir *dir, const char *name, const char *cp)
  *-----------------------------------------------------------------------
  */
 static char *
-DirFindDot(Boolean hasSlash MAKE_ATTR_UNUSED, const char *name, const char *cp)
+DirFindDot(Boolean hasSlash MAKE_ATTR_UNUSED, const char *name,
+	   const Hash_Key *base)
 {
 
-    if (Hash_FindEntry(&dot->files, cp) != NULL) {
+    if (Hash_FindEntryKey(&dot->files, base) != NULL) {
 	DIR_DEBUG0("   in '.'\n");
 	hits++;
 	dot->hits++;
 	return bmake_strdup(name);
     }
-    if (cur && Hash_FindEntry(&cur->files, cp) != NULL) {
+    if (cur && Hash_FindEntryKey(&cur->files, base) != NULL) {
 	DIR_DEBUG1("   in ${.CURDIR} = %s\n", cur->name);
 	hits++;
 	cur->hits++;
-	return str_concat3(cur->name, "/", cp);
+	return str_concat3(cur->name, "/", base->str);
     }
 
     return NULL;
@@ -1073,11 +1127,12 @@ DirFindDot(Boolean hasSlash MAKE_ATTR_UNUSED, const char *name, const char *cp)
 
 /*-
  *-----------------------------------------------------------------------
- * Dir_FindFile  --
+ * DirFindFile  --
  *	Find the file with the given name along the given search path.
  *
  * Input:
  *	name		the file to find
+ *	nameKey		the hashed name, or NULL
  *	path		the Lst of directories to search
  *
  * Results:
@@ -1093,13 +1148,14 @@ DirFindDot(Boolean hasSlash MAKE_ATTR_UNUSED, const char *name, const char *cp)
  *	that directory later on. Sometimes this is true. Sometimes not.
  *-----------------------------------------------------------------------
  */
-char *
-Dir_FindFile(const char *name, SearchPath *path)
+static char *
+DirFindFile(const char *name, const Hash_Key *nameKey, SearchPath *path)
 {
     SearchPathNode *ln;
     char *file;			/* the current filename to check */
     CachedDir *dir;
     const char *base;		/* Terminal name of file */
+    Hash_Key baseKey;		/* The hashed terminal name */
     Boolean hasLastDot = FALSE;	/* true if we should search dot last */
     Boolean hasSlash;		/* true if 'name' contains a / */
     struct make_stat mst;	/* Buffer for stat, if necessary */
@@ -1118,6 +1174,12 @@ Dir_FindFile(const char *name, SearchPath *path)
 	base = name;
     }
 
+    /* The terminal name is hashed only once for all the directories. */
+    if (!hasSlash && nameKey != NULL)
+	baseKey = *nameKey;
+    else
+	Hash_InitKey(&baseKey, base);
+
     DIR_DEBUG1("Searching for %s ...", name);
 
     if (path == NULL) {
@@ -1156,7 +1218,7 @@ Dir_FindFile(const char *name, SearchPath *path)
 	 * This is so there are no conflicts between what the user
 	 * specifies (fish.c) and what pmake finds (./fish.c).
 	 */
-	if (!hasLastDot && (file = DirFindDot(hasSlash, name, base)) != NULL) {
+	if (!hasLastDot && (file = DirFindDot(hasSlash, name, &baseKey)) != NULL) {
 	    Lst_Close(path);
 	    return file;
 	}
@@ -1165,13 +1227,13 @@ Dir_FindFile(const char *name, SearchPath *path)
 	    dir = LstNode_Datum(ln);
 	    if (dir == dotLast)
 		continue;
-	    if ((file = DirLookup(dir, name, base, hasSlash)) != NULL) {
+	    if ((file = DirLookup(dir, name, &baseKey, hasSlash)) != NULL) {
 		Lst_Close(path);
 		return file;
 	    }
 	}
 
-	if (hasLastDot && (file = DirFindDot(hasSlash, name, base)) != NULL) {
+	if (hasLastDot && (file = DirFindDot(hasSlash, name, &baseKey)) != NULL) {
 	    Lst_Close(path);
 	    return file;
 	}
@@ -1201,6 +1263,7 @@ Dir_FindFile(const char *name, SearchPath *path)
     if (*base == '\0') {
 	/* we were given a trailing "/" */
 	base = trailing_dot;
+	Hash_InitKey(&baseKey, base);
     }
 
     if (name[0] != '/') {
@@ -1268,7 +1331,7 @@ Dir_FindFile(const char *name, SearchPath *path)
 	DIR_DEBUG0("   Trying exact path matches...\n");
 
 	if (!hasLastDot && cur &&
-	    ((file = DirLookupAbs(cur, name, base)) != NULL)) {
+	    ((file = DirLookupAbs(cur, name, &baseKey)) != NULL)) {
 	    if (file[0] == '\0') {
 		free(file);
 		return NULL;
@@ -1281,7 +1344,7 @@ Dir_FindFile(const char *name, SearchPath *path)
 	    dir = LstNode_Datum(ln);
 	    if (dir == dotLast)
 		continue;
-	    if ((file = DirLookupAbs(dir, name, base)) != NULL) {
+	    if ((file = DirLookupAbs(dir, name, &baseKey)) != NULL) {
 		Lst_Close(path);
 		if (file[0] == '\0') {
 		    free(file);
@@ -1293,7 +1356,7 @@ Dir_FindFile(const char *name, SearchPath *path)
 	Lst_Close(path);
 
 	if (hasLastDot && cur &&
-	    ((file = DirLookupAbs(cur, name, base)) != NULL)) {
+	    ((file = DirLookupAbs(cur, name, &baseKey)) != NULL)) {
 	    if (file[0] == '\0') {
 		free(file);
 		return NULL;
@@ -1354,6 +1417,38 @@ Dir_FindFile(const char *name, SearchPath *path)
 #endif /* notdef */
 }
 
+/* Tell that files may have been created or removed, for example by a
+ * shell command. */
+void
+Dir_Changed(void)
+{
+    dirGeneration++;
+}
+
+/* Return a number that changes whenever the result of Dir_FindFile may
+ * change. */
+unsigned int
+Dir_Generation(void)
+{
+    return dirGeneration;
+}
+
+/* Find the file with the given name along the given search path, see
+ * DirFindFile. */
+char *
+Dir_FindFile(const char *name, SearchPath *path)
+{
+    return DirFindFile(name, NULL, path);
+}
+
+/* Like Dir_FindFile, with the name already hashed, for callers that have
+ * already looked it up in another table. */
+char *
+Dir_FindFileKey(const Hash_Key *name, SearchPath *path)
+{
+    return DirFindFile(name->str, name, path);
+}
+
 
 /* Search for a path starting at a given directory and then working our way
  * up towards the root.
@@ -1439,7 +1534,8 @@ Dir_FindHereOrAbove(const char *here, const char *search_path)
 time_t
 Dir_MTime(GNode *gn, Boolean recheck)
 {
-    char *fullName;		/* the full pathname of name */
+    const char *fullName;	/* the full pathname of name */
+    char *found = NULL;		/* the path from Dir_FindFile */
     struct make_stat mst;	/* buffer for finding the mod time */
 
     if (gn->type & OP_ARCHV) {
@@ -1451,10 +1547,10 @@ Dir_MTime(GNode *gn, Boolean recheck)
 	if (gn->type & OP_NOPATH)
 	    fullName = NULL;
 	else {
-	    fullName = Dir_FindFile(gn->name, Suff_FindPath(gn));
+	    fullName = found = Dir_FindFile(gn->name, Suff_FindPath(gn));
 	    if (fullName == NULL && gn->flags & FROM_DEPEND &&
-		!Lst_IsEmpty(gn->implicitParents)) {
-		char *cp;
+		!GNodeVec_IsEmpty(&gn->implicitParents)) {
+		const char *cp;
 
 		cp = strrchr(gn->name, '/');
 		if (cp) {
@@ -1464,13 +1560,13 @@ Dir_MTime(GNode *gn, Boolean recheck)
 		     */
 		    cp++;
 
-		    fullName = Dir_FindFile(cp, Suff_FindPath(gn));
+		    fullName = found = Dir_FindFile(cp, Suff_FindPath(gn));
 		    if (fullName) {
 			/*
 			 * Put the found file in gn->path
 			 * so that we give that to the compiler.
 			 */
-			gn->path = bmake_strdup(fullName);
+			gn->path = Hash_Intern(fullName);
 			if (!Job_RunTarget(".STALE", gn->fname))
 			    fprintf(stdout,
 				    "%s: %s, %d: ignoring stale %s for %s, "
@@ -1488,27 +1584,127 @@ Dir_MTime(GNode *gn, Boolean recheck)
     }
 
     if (fullName == NULL) {
-	fullName = bmake_strdup(gn->name);
+	fullName = gn->name;
     }
 
     if (cached_stats(&mtimes, fullName, &mst, recheck ? CST_UPDATE : 0) < 0) {
 	if (gn->type & OP_MEMBER) {
-	    if (fullName != gn->path)
-		free(fullName);
+	    free(found);
 	    return Arch_MemMTime(gn);
 	} else {
 	    mst.mst_mtime = 0;
 	}
     }
 
-    if (fullName && gn->path == NULL) {
-	gn->path = fullName;
+    if (gn->path == NULL) {
+	gn->path = Hash_Intern(fullName);
     }
+    free(found);
 
     gn->mtime = mst.mst_mtime;
     return gn->mtime;
 }
 
+/* Look up the modification times of the given files in several processes
+ * at once and remember them, so that Dir_MTime finds them in the cache
+ * instead of calling stat(2) on one file after the other.  This matters
+ * when the files are on a slow file system such as NFS.
+ *
+ * The first recheck of each file, in Make_OODate, uses these times as
+ * well.  Only when the file is checked again after its node has been made
+ * is it looked up again.
+ *
+ * Files that do not exist are not remembered, as in cached_stat.
+ * Whatever goes wrong here, Dir_MTime still does its job, only slower. */
+void
+Dir_Prefetch(StringList *files, int nprocs)
+{
+#if defined(HAVE_MMAP) && defined(MAP_ANON)
+    struct prefetch_st {
+	time_t mtime;		/* 0 if the file could not be stat'ed */
+	mode_t mode;
+    } *results;
+    const char **names;
+    StringListNode *ln;
+    size_t n, i, len;
+    pid_t *pids;
+    int p;
+
+    if (nprocs < 2)
+	return;
+
+    for (n = 0, ln = files->first; ln != NULL; ln = ln->next)
+	n++;
+    names = bmake_malloc((n + 1) * sizeof *names);
+    for (n = 0, ln = files->first; ln != NULL; ln = ln->next)
+	if (Hash_FindEntry(&mtimes, ln->datum) == NULL)
+	    names[n++] = ln->datum;
+    if (n == 0) {
+	free(names);
+	return;
+    }
+    if ((size_t)nprocs > n)
+	nprocs = (int)n;
+
+    len = n * sizeof *results;
+    results = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_ANON | MAP_SHARED,
+		   -1, 0);
+    if (results == MAP_FAILED) {
+	free(names);
+	return;
+    }
+    memset(results, 0, len);
+
+    DIR_DEBUG2("Prefetching %zu files in %d processes\n", n, nprocs);
+    pids = bmake_malloc((size_t)nprocs * sizeof *pids);
+    for (p = 0; p < nprocs; p++) {
+	pids[p] = fork();
+	if (pids[p] == 0) {
+	    struct stat sys_st;
+
+	    for (i = (size_t)p; i < n; i += (size_t)nprocs) {
+		if (stat(names[i], &sys_st) == -1)
+		    continue;
+		results[i].mode = sys_st.st_mode;
+		results[i].mtime = sys_st.st_mtime != 0 ? sys_st.st_mtime : 1;
+	    }
+	    _exit(0);
+	}
+	if (pids[p] == -1)
+	    break;
+    }
+    nprocs = p;
+
+    for (p = 0; p < nprocs; p++) {
+	WAIT_T status;
+
+	while (waitpid(pids[p], &status, 0) == -1 && errno == EINTR)
+	    continue;
+    }
+
+    /*
+     * The processes that did not start have left their part of the
+     * results empty, these files are looked up by Dir_MTime as usual.
+     */
+    for (i = 0; i < n; i++) {
+	struct make_stat mst;
+
+	if (results[i].mtime == 0)
+	    continue;
+	mst.mst_mtime = results[i].mtime;
+	mst.mst_mode = results[i].mode;
+	cached_stats_store(&mtimes, NULL, names[i], &mst, CST_PREFETCH);
+    }
+
+    free(pids);
+    munmap(results, len);
+    free(names);
+#else
+    (void)files;
+    (void)nprocs;
+#endif
+}
+
 /* Read the list of filenames in the directory and store the result
  * in openDirectories.
  *
@@ -1528,6 +1724,8 @@ Dir_AddDir(SearchPath *path, const char *name)
     DIR *d;
     struct dirent *dp;
 
+    dirGeneration++;
+
     if (path != NULL && strcmp(name, ".DOTLAST") == 0) {
 	SearchPathNode *ln = Lst_Find(path, DirFindName, name);
 	if (ln != NULL)
@@ -1691,6 +1889,7 @@ Dir_Destroy(void *dirp)
 void
 Dir_ClearPath(SearchPath *path)
 {
+    dirGeneration++;
     while (!Lst_IsEmpty(path)) {
 	CachedDir *dir = Lst_Dequeue(path);
 	Dir_Destroy(dir);
@@ -1721,6 +1920,7 @@ Dir_Concat(SearchPath *path1, SearchPath *path2)
 {
     SearchPathNode *ln;
 
+    dirGeneration++;
     for (ln = path2->first; ln != NULL; ln = ln->next) {
 	CachedDir *dir = ln->datum;
 	if (Lst_FindDatum(path1, dir) == NULL) {
@@ -98,9 +98,13 @@ void Dir_End(void);
 void Dir_SetPATH(void);
 Boolean Dir_HasWildcards(const char *);
 void Dir_Expand(const char *, SearchPath *, StringList *);
+void Dir_Changed(void);
+unsigned int Dir_Generation(void);
 char *Dir_FindFile(const char *, SearchPath *);
+char *Dir_FindFileKey(const Hash_Key *, SearchPath *);
 char *Dir_FindHereOrAbove(const char *, const char *);
 time_t Dir_MTime(GNode *, Boolean);
+void Dir_Prefetch(StringList *, int);
 CachedDir *Dir_AddDir(SearchPath *, const char *);
 char *Dir_MakeFlags(const char *, SearchPath *);
 void Dir_ClearPath(SearchPath *);
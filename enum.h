@@ -170,6 +170,20 @@ const char *Enum_ValueToString(int, const EnumToStringSpec *);
 		ENUM__JOIN_STR_8(v1, v2, v3, v4, v5, v6, v7, v8), \
 		ENUM__JOIN_STR_2(v9, v10)))
 
+/* Declare the necessary data structures for calling Enum_FlagsToString
+ * for an enum with 11 flags. */
+#define ENUM_FLAGS_RTTI_11(typnam, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, \
+			   v11) \
+	ENUM__FLAGS_RTTI(typnam, \
+	    ENUM__SPECS_3( \
+		ENUM__SPEC_8(v1, v2, v3, v4, v5, v6, v7, v8), \
+		ENUM__SPEC_2(v9, v10), \
+		ENUM__SPEC_1(v11)), \
+	    ENUM__JOIN_3( \
+		ENUM__JOIN_STR_8(v1, v2, v3, v4, v5, v6, v7, v8), \
+		ENUM__JOIN_STR_2(v9, v10), \
+		ENUM__JOIN_STR_1(v11)))
+
 /* Declare the necessary data structures for calling Enum_FlagsToString
  * for an enum with 31 flags. */
 #define ENUM_FLAGS_RTTI_31(typnam, \
@@ -55,6 +55,9 @@
  *	For_Eval	Evaluate the loop in the passed line.
  *
  *	For_Run		Run accumulated loop
+ *
+ *	For_HasValue	Tell whether a line of the body contains a value
+ *			that was substituted in this iteration.
  */
 
 #include    "make.h"
@@ -63,27 +66,42 @@
 /*	"@(#)for.c	8.1 (Berkeley) 6/6/93"	*/
 MAKE_RCSID("$NetBSD: for.c,v 1.93 2020/10/05 20:21:30 rillig Exp $");
 
-typedef enum {
-    FOR_SUB_ESCAPE_CHAR = 0x0001,
-    FOR_SUB_ESCAPE_BRACE = 0x0002,
-    FOR_SUB_ESCAPE_PAREN = 0x0004
-} ForEscapes;
-
 static int forLevel = 0;	/* Nesting level */
 
+/*
+ * A reference to an iteration variable in the body of the loop, which is
+ * replaced with the current value of the variable in each iteration.
+ */
+typedef struct ForSub {
+    size_t offset;		/* Start of the variable name in the body */
+    size_t skip;		/* Length of the variable name */
+    unsigned int var;		/* Index of the iteration variable */
+    char ech;			/* The character that ends the expression */
+    Boolean brace;		/* Whether the braces must be added, for $V */
+    size_t value;		/* Start of the substituted expression in the
+				 * body of the current iteration */
+} ForSub;
+
 /*
  * State of a for loop.
  */
 typedef struct For {
     Buffer buf;			/* Body of loop */
     strlist_t vars;		/* Iteration variables */
-    strlist_t items;		/* Substitution items */
+    Words items;		/* Substitution items, as split from the
+				 * expanded list; they are escaped only when
+				 * they are substituted */
     char *parse_buf;
     /* Is any of the names 1 character long? If so, when the variable values
      * are substituted, the parser must handle $V expressions as well, not
      * only ${V} and $(V). */
     Boolean short_var;
     unsigned int sub_next;
+    ForSub *subs;		/* References to the iteration variables */
+    size_t nsubs;
+    /* Whether the body contains values from an enclosing .for loop, which
+     * differ in each iteration of that loop. */
+    Boolean outer_values;
 } For;
 
 static For *accumFor;		/* Loop being accumulated */
@@ -94,8 +112,9 @@ For_Free(For *arg)
 {
     Buf_Destroy(&arg->buf, TRUE);
     strlist_clean(&arg->vars);
-    strlist_clean(&arg->items);
+    Words_Free(arg->items);
     free(arg->parse_buf);
+    free(arg->subs);
 
     free(arg);
 }
@@ -116,7 +135,6 @@ For_Eval(const char *line)
 {
     For *new_for;
     const char *ptr;
-    Words words;
 
     /* Skip the '.' and any following whitespace */
     ptr = line + 1;
@@ -143,10 +161,15 @@ For_Eval(const char *line)
     new_for = bmake_malloc(sizeof *new_for);
     Buf_Init(&new_for->buf, 0);
     strlist_init(&new_for->vars);
-    strlist_init(&new_for->items);
+    new_for->items.words = NULL;
+    new_for->items.len = 0;
+    new_for->items.freeIt = NULL;
     new_for->parse_buf = NULL;
     new_for->short_var = FALSE;
     new_for->sub_next = 0;
+    new_for->subs = NULL;
+    new_for->nsubs = 0;
+    new_for->outer_values = FALSE;
 
     /* Grab the variables. Terminate on "in". */
     for (;;) {
@@ -188,57 +211,29 @@ For_Eval(const char *line)
      * Variables are fully expanded - so it is safe for escape $.
      * We can't do the escapes here - because we don't know whether
      * we will be substituting into ${...} or $(...).
+     *
+     * The words stay in the single buffer from Str_Words, instead of
+     * being copied one by one, since huge lists such as all source
+     * files of a tree are common.
      */
     {
 	char *items;
 	(void)Var_Subst(ptr, VAR_GLOBAL, VARE_WANTRES, &items);
 	/* TODO: handle errors */
-	words = Str_Words(items, FALSE);
+	new_for->items = Str_Words(items, FALSE);
 	free(items);
     }
 
     {
-	size_t n;
+	size_t len, n, i;
 
-	for (n = 0; n < words.len; n++) {
-	    ForEscapes escapes;
-	    char ch;
+	/* Empty words are not iterated over. */
+	for (i = len = 0; i < new_for->items.len; i++)
+	    if (new_for->items.words[i][0] != '\0')
+		new_for->items.words[len++] = new_for->items.words[i];
+	new_for->items.len = len;
 
-	    ptr = words.words[n];
-	    if (ptr[0] == '\0')
-		continue;
-	    escapes = 0;
-	    while ((ch = *ptr++)) {
-		switch (ch) {
-		case ':':
-		case '$':
-		case '\\':
-		    escapes |= FOR_SUB_ESCAPE_CHAR;
-		    break;
-		case ')':
-		    escapes |= FOR_SUB_ESCAPE_PAREN;
-		    break;
-		case '}':
-		    escapes |= FOR_SUB_ESCAPE_BRACE;
-		    break;
-		}
-	    }
-	    /*
-	     * We have to dup words[n] to maintain the semantics of
-	     * strlist.
-	     */
-	    strlist_add_str(&new_for->items, bmake_strdup(words.words[n]),
-			    escapes);
-	}
-    }
-
-    Words_Free(words);
-
-    {
-	size_t len, n;
-
-	if ((len = strlist_num(&new_for->items)) > 0 &&
-	    len % (n = strlist_num(&new_for->vars))) {
+	if (len > 0 && len % (n = strlist_num(&new_for->vars))) {
 	    Parse_Error(PARSE_FATAL,
 			"Wrong number of words (%zu) in .for substitution list"
 			" with %zu vars", len, n);
@@ -247,7 +242,7 @@ For_Eval(const char *line)
 	     * accumulated.
 	     * Remove all items so that the loop doesn't iterate.
 	     */
-	    strlist_clean(&new_for->items);
+	    new_for->items.len = 0;
 	}
     }
 
@@ -279,6 +274,8 @@ For_Accum(const char *line)
 	}
     }
 
+    if (Parse_LineHasForValue())
+	accumFor->outer_values = TRUE;
     Buf_AddStr(&accumFor->buf, line);
     Buf_AddByte(&accumFor->buf, '\n');
     return TRUE;
@@ -318,16 +315,13 @@ for_var_len(const char *var)
 }
 
 static void
-for_substitute(Buffer *cmds, strlist_t *items, unsigned int item_no, char ech)
+for_substitute(Buffer *cmds, const char *item, char ech)
 {
-    const char *item = strlist_str(items, item_no);
-    ForEscapes escapes = strlist_info(items, item_no);
     char ch;
 
-    /* If there were no escapes, or the only escape is the other variable
+    /* If there is nothing to escape, or only the other variable
      * terminator, then just substitute the full string */
-    if (!(escapes & (ech == ')' ? ~(unsigned)FOR_SUB_ESCAPE_BRACE
-				: ~(unsigned)FOR_SUB_ESCAPE_PAREN))) {
+    if (item[strcspn(item, ech == ')' ? ":$\\)" : ":$\\}")] == '\0') {
 	Buf_AddStr(cmds, item);
 	return;
     }
@@ -349,45 +343,43 @@ for_substitute(Buffer *cmds, strlist_t *items, unsigned int item_no, char ech)
     }
 }
 
-static char *
-ForIterate(void *v_arg, size_t *ret_len)
+static void
+ForAddSub(For *arg, size_t *cap, const char *pos, size_t skip,
+	  unsigned int var, char ech, Boolean brace)
 {
-    For *arg = v_arg;
-    unsigned int i;
-    char *var;
-    const char *cp;
-    const char *cmd_cp;
-    const char *body_end;
-    char ch;
-    Buffer cmds;
-    char *cmds_str;
-    size_t cmd_len;
+    ForSub *sub;
 
-    if (arg->sub_next + strlist_num(&arg->vars) > strlist_num(&arg->items)) {
-	/* No more iterations */
-	For_Free(arg);
-	return NULL;
+    if (arg->nsubs == *cap) {
+	*cap = *cap == 0 ? 16 : 2 * *cap;
+	arg->subs = bmake_realloc(arg->subs, *cap * sizeof *arg->subs);
     }
+    sub = arg->subs + arg->nsubs++;
+    sub->offset = (size_t)(pos - Buf_GetAll(&arg->buf, NULL));
+    sub->skip = skip;
+    sub->var = var;
+    sub->ech = ech;
+    sub->brace = brace;
+}
 
-    free(arg->parse_buf);
-    arg->parse_buf = NULL;
-
-    /*
-     * Scan the for loop body and replace references to the loop variables
-     * with variable references that expand to the required text.
-     * Using variable expansions ensures that the .for loop can't generate
-     * syntax, and that the later parsing will still see a variable.
-     * We assume that the null variable will never be defined.
-     *
-     * The detection of substitutions of the loop control variable is naive.
-     * Many of the modifiers use \ to escape $ (not $) so it is possible
-     * to contrive a makefile where an unwanted substitution happens.
-     */
+/*
+ * Scan the for loop body for references to the loop variables.  The body
+ * and the variables are the same in each iteration, therefore this is only
+ * done once, and each iteration only splices the values into the body.
+ *
+ * The detection of substitutions of the loop control variable is naive.
+ * Many of the modifiers use \ to escape $ (not $) so it is possible
+ * to contrive a makefile where an unwanted substitution happens.
+ */
+static void
+ForFindSubs(For *arg)
+{
+    const char *cp;
+    size_t cap = 0;
+    unsigned int i;
+    char *var;
+    char ch;
 
-    cmd_cp = Buf_GetAll(&arg->buf, &cmd_len);
-    body_end = cmd_cp + cmd_len;
-    Buf_Init(&cmds, cmd_len + 256);
-    for (cp = cmd_cp; (cp = strchr(cp, '$')) != NULL;) {
+    for (cp = Buf_GetAll(&arg->buf, NULL); (cp = strchr(cp, '$')) != NULL;) {
 	char ech;
 	ch = *++cp;
 	if ((ch == '(' && (ech = ')', 1)) || (ch == '{' && (ech = '}', 1))) {
@@ -400,11 +392,8 @@ ForIterate(void *v_arg, size_t *ret_len)
 		if (cp[vlen] != ':' && cp[vlen] != ech && cp[vlen] != '\\')
 		    continue;
 		/* Found a variable match. Replace with :U<value> */
-		Buf_AddBytesBetween(&cmds, cmd_cp, cp);
-		Buf_AddStr(&cmds, ":U");
+		ForAddSub(arg, &cap, cp, vlen, i, ech, FALSE);
 		cp += vlen;
-		cmd_cp = cp;
-		for_substitute(&cmds, &arg->items, arg->sub_next + i, ech);
 		break;
 	    }
 	    continue;
@@ -420,15 +409,55 @@ ForIterate(void *v_arg, size_t *ret_len)
 	    if (var[0] != ch || var[1] != 0)
 		continue;
 	    /* Found a variable match. Replace with ${:U<value>} */
-	    Buf_AddBytesBetween(&cmds, cmd_cp, cp);
-	    Buf_AddStr(&cmds, "{:U");
-	    cmd_cp = ++cp;
-	    for_substitute(&cmds, &arg->items, arg->sub_next + i, '}');
-	    Buf_AddByte(&cmds, '}');
+	    ForAddSub(arg, &cap, cp, 1, i, '}', TRUE);
+	    cp++;
 	    break;
 	}
     }
-    Buf_AddBytesBetween(&cmds, cmd_cp, body_end);
+}
+
+static char *
+ForIterate(void *v_arg, size_t *ret_len)
+{
+    For *arg = v_arg;
+    const char *body;
+    size_t body_len, done, n;
+    Buffer cmds;
+    char *cmds_str;
+
+    if (arg->sub_next + strlist_num(&arg->vars) > arg->items.len) {
+	/* No more iterations */
+	For_Free(arg);
+	return NULL;
+    }
+
+    free(arg->parse_buf);
+    arg->parse_buf = NULL;
+
+    /*
+     * Replace references to the loop variables with variable references
+     * that expand to the required text.
+     * Using variable expansions ensures that the .for loop can't generate
+     * syntax, and that the later parsing will still see a variable.
+     * We assume that the null variable will never be defined.
+     */
+
+    body = Buf_GetAll(&arg->buf, &body_len);
+    Buf_Init(&cmds, body_len + 256);
+    done = 0;
+    for (n = 0; n < arg->nsubs; n++) {
+	ForSub *sub = arg->subs + n;
+
+	Buf_AddBytes(&cmds, body + done, sub->offset - done);
+	sub->value = Buf_Len(&cmds);
+	Buf_AddStr(&cmds, sub->brace ? "{:U" : ":U");
+	for_substitute(&cmds, arg->items.words[arg->sub_next + sub->var],
+		       sub->ech);
+	if (sub->brace)
+	    Buf_AddByte(&cmds, '}');
+	done = sub->offset + sub->skip;
+    }
+    Buf_AddBytes(&cmds, body + done, body_len - done);
 
     *ret_len = Buf_Len(&cmds);
     cmds_str = Buf_Destroy(&cmds, FALSE);
@@ -440,6 +469,29 @@ ForIterate(void *v_arg, size_t *ret_len)
     return cmds_str;
 }
 
+/* Whether the text between start and end in the body of the current
+ * iteration contains a substituted value.  The conditions in the other
+ * lines are the same in each iteration. */
+Boolean
+For_HasValue(void *v_arg, size_t start, size_t end)
+{
+    For *arg = v_arg;
+    size_t lo = 0, hi = arg->nsubs;
+
+    if (arg->outer_values)
+	return TRUE;
+
+    /* Find the first value at or after start. */
+    while (lo < hi) {
+	size_t mid = lo + (hi - lo) / 2;
+	if (arg->subs[mid].value < start)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+    return lo < arg->nsubs && arg->subs[lo].value < end;
+}
+
 /* Run the for loop, imitating the actions of an include file. */
 void
 For_Run(int lineno)
@@ -449,11 +501,12 @@ For_Run(int lineno)
     arg = accumFor;
     accumFor = NULL;
 
-    if (strlist_num(&arg->items) == 0) {
+    if (arg->items.len == 0) {
 	/* Nothing to expand - possibly due to an earlier syntax error. */
 	For_Free(arg);
 	return;
     }
 
+    ForFindSubs(arg);
     Parse_SetInput(NULL, lineno, -1, ForIterate, arg);
 }
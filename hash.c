@@ -78,64 +78,377 @@
 
 #include "make.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 /*	"@(#)hash.c	8.1 (Berkeley) 6/6/93"	*/
 MAKE_RCSID("$NetBSD: hash.c,v 1.44 2020/10/05 20:21:30 rillig Exp $");
 
+/* The number of slots whose control bytes are scanned at once. */
+#define HASH_GROUP		16
+
+/* Control bytes for the slots that don't hold an entry. */
+#define HASH_CTRL_EMPTY		0x80
+#define HASH_CTRL_DELETED	0xFE
+
 /*
- * The ratio of # entries to # buckets at which we rebuild the table to
- * make it larger.
+ * The table is resized when more than 7/8 of its slots are used, either
+ * by entries or by deleted slots.
  */
-#define rebuildLimit 3
+#define HASH_MAXLOAD(size)	((size) - (size) / 8)
 
-/* This hash function matches Gosling's emacs. */
+/*
+ * The number of slots of the old table that are migrated on each insertion
+ * during an incremental resize.  The old table is always empty long before
+ * the new one becomes full.
+ */
+#define HASH_MIGRATE_STEP	8
+
+typedef unsigned int HashGroupMask;
+
+/*
+ * The names of targets and variables are interned, so that each distinct
+ * string is stored only once, no matter in how many tables it is used as a
+ * key.  The strings live in the arena from make_malloc.c and are never
+ * freed, so their addresses are stable and can be compared directly.
+ *
+ * The other tables, such as caches, own the copies of their keys and free
+ * them along with the entries, since their keys are often used only once.
+ */
+static Hash_Table interned;
+
+static unsigned int
+HashRotl(unsigned int x, int r)
+{
+	return (x << r) | (x >> (32 - r));
+}
+
+/* Read 4 bytes in little-endian order, so that the hash does not depend on
+ * the byte order of the machine. */
 static unsigned int
-hash(const char *key, size_t *out_keylen)
-{
-	unsigned h = 0;
-	const char *p = key;
-	while (*p != '\0')
-		h = (h << 5) - h + (unsigned char)*p++;
-	if (out_keylen != NULL)
-		*out_keylen = (size_t)(p - key);
+HashWord(const unsigned char *p)
+{
+	return (unsigned int)p[0] | (unsigned int)p[1] << 8 |
+	       (unsigned int)p[2] << 16 | (unsigned int)p[3] << 24;
+}
+
+static unsigned int
+HashMixWord(unsigned int k)
+{
+	k *= 0xCC9E2D51U;
+	k = HashRotl(k, 15);
+	return k * 0x1B873593U;
+}
+
+/*
+ * This hash function is MurmurHash3 (32 bit), which processes the key
+ * 4 bytes at a time instead of byte by byte.
+ */
+static unsigned int
+hash(const char *key, size_t len)
+{
+	const unsigned char *p = (const unsigned char *)key;
+	unsigned int h = 0;
+	unsigned int k;
+	size_t n;
+
+	for (n = len; n >= 4; n -= 4, p += 4) {
+		h ^= HashMixWord(HashWord(p));
+		h = HashRotl(h, 13) * 5 + 0xE6546B64U;
+	}
+
+	k = 0;
+	switch (n) {
+	case 3:
+		k ^= (unsigned int)p[2] << 16;
+		/* FALLTHROUGH */
+	case 2:
+		k ^= (unsigned int)p[1] << 8;
+		/* FALLTHROUGH */
+	case 1:
+		k ^= p[0];
+		h ^= HashMixWord(k);
+	}
+
+	h ^= (unsigned int)len;
+	h ^= h >> 16;
+	h *= 0x85EBCA6BU;
+	h ^= h >> 13;
+	h *= 0xC2B2AE35U;
+	h ^= h >> 16;
 	return h;
 }
 
-static Hash_Entry *
-HashTable_Find(Hash_Table *t, unsigned int h, const char *key)
+/* The tag for the control byte, taken from the bits that are not used for
+ * selecting the group. */
+static unsigned char
+HashTag(unsigned int h)
 {
-	Hash_Entry *e;
-	unsigned int chainlen = 0;
+	return (unsigned char)(h >> 25);
+}
 
-#ifdef DEBUG_HASH_LOOKUP
-	DEBUG4(HASH, "%s: %p h=%x key=%s\n", __func__, t, h, key);
+/* Return a bit mask of the slots in the group whose control byte equals
+ * the given byte. */
+static HashGroupMask
+HashGroup_Match(const unsigned char *ctrl, unsigned char b)
+{
+#if defined(__SSE2__)
+	__m128i group = _mm_loadu_si128((const __m128i *)(const void *)ctrl);
+	__m128i cmp = _mm_cmpeq_epi8(group, _mm_set1_epi8((char)b));
+	return (HashGroupMask)_mm_movemask_epi8(cmp);
+#else
+	HashGroupMask mask = 0;
+	unsigned int i;
+
+	for (i = 0; i < HASH_GROUP; i++)
+		if (ctrl[i] == b)
+			mask |= 1U << i;
+	return mask;
 #endif
+}
 
-	for (e = t->buckets[h & t->bucketsMask]; e != NULL; e = e->next) {
-		chainlen++;
-		if (e->namehash == h && strcmp(e->name, key) == 0)
+static unsigned int
+HashGroupMask_First(HashGroupMask mask)
+{
+#if MAKE_GNUC_PREREQ(3, 4)
+	return (unsigned int)__builtin_ctz(mask);
+#else
+	unsigned int i = 0;
+	while (!(mask & 1)) {
+		mask >>= 1;
+		i++;
+	}
+	return i;
+#endif
+}
+
+/* Return the first slot of the group that is probed in the given round. */
+static unsigned int
+HashProbe(unsigned int h, unsigned int round, unsigned int mask)
+{
+	/*
+	 * Triangular probing over whole groups; since the number of groups
+	 * is a power of 2, this visits each group exactly once.
+	 */
+	unsigned int groups = (mask + 1) / HASH_GROUP;
+	unsigned int g = h + round * (round + 1) / 2;
+	return (g & (groups - 1)) * HASH_GROUP;
+}
+
+/* Look up the key in a single array of slots.  Return the slot index, or
+ * -1 if the key is not there. */
+static int
+HashSlots_Find(Hash_Table *t, const unsigned char *ctrl,
+	       Hash_Entry *const *buckets, unsigned int size,
+	       const Hash_Key *key)
+{
+	unsigned int h = key->hash;
+	unsigned char tag = HashTag(h);
+	unsigned int groups = size / HASH_GROUP;
+	unsigned int round = 0;
+	int found = -1;
+
+	while (found < 0 && round < groups) {
+		unsigned int base = HashProbe(h, round, size - 1);
+		HashGroupMask m = HashGroup_Match(ctrl + base, tag);
+
+		round++;
+		for (; m != 0; m &= m - 1) {
+			unsigned int i = base + HashGroupMask_First(m);
+			Hash_Entry *e = buckets[i];
+			if (e->name == key->str || (e->namehash == h &&
+			    e->namelen == key->len &&
+			    memcmp(e->name, key->str, key->len) == 0)) {
+				found = (int)i;
+				break;
+			}
+		}
+		if (HashGroup_Match(ctrl + base, HASH_CTRL_EMPTY) != 0)
 			break;
 	}
 
-	if (chainlen > t->maxchain)
-		t->maxchain = chainlen;
+	t->probes += round;
+	if (round > t->maxchain)
+		t->maxchain = round;
+	return found;
+}
 
-	return e;
+/* Return the first free slot for the hash, which is either empty or
+ * deleted. */
+static unsigned int
+HashSlots_FindFree(const unsigned char *ctrl, unsigned int size,
+		   unsigned int h)
+{
+	unsigned int round;
+
+	for (round = 0;; round++) {
+		unsigned int base = HashProbe(h, round, size - 1);
+		HashGroupMask m = HashGroup_Match(ctrl + base,
+		    HASH_CTRL_EMPTY) | HashGroup_Match(ctrl + base,
+		    HASH_CTRL_DELETED);
+		if (m != 0)
+			return base + HashGroupMask_First(m);
+	}
+}
+
+static void
+HashSlots_Alloc(unsigned int size, unsigned char **out_ctrl,
+		Hash_Entry ***out_buckets)
+{
+	*out_ctrl = bmake_malloc(size);
+	memset(*out_ctrl, HASH_CTRL_EMPTY, size);
+	*out_buckets = bmake_malloc(sizeof(**out_buckets) * size);
+}
+
+/* Put an entry that is known not to be in the table into the new slots. */
+static void
+HashTable_Place(Hash_Table *t, Hash_Entry *e)
+{
+	unsigned int i = HashSlots_FindFree(t->ctrl, t->bucketsSize,
+	    e->namehash);
+	if (t->ctrl[i] == HASH_CTRL_DELETED)
+		t->numDeleted--;
+	t->ctrl[i] = HashTag(e->namehash);
+	t->buckets[i] = e;
+}
+
+/* Move some more entries from the old table to the new one. */
+static void
+HashTable_Migrate(Hash_Table *t, unsigned int n)
+{
+	while (n > 0 && t->oldNext < t->oldSize) {
+		unsigned int i = t->oldNext++;
+		if (t->oldCtrl[i] & 0x80)
+			continue;
+		t->oldCtrl[i] = HASH_CTRL_DELETED;
+		HashTable_Place(t, t->oldBuckets[i]);
+		n--;
+	}
+
+	if (t->oldNext == t->oldSize) {
+		free(t->oldCtrl);
+		free(t->oldBuckets);
+		t->oldCtrl = NULL;
+		t->oldBuckets = NULL;
+		t->oldSize = 0;
+		t->oldNext = 0;
+	}
+}
+
+/* Start moving the entries to a new table.  If most of the used slots are
+ * deleted ones, the new table has the same size, otherwise it is twice as
+ * large. */
+static void
+HashTable_Resize(Hash_Table *t)
+{
+	unsigned int newSize;
+
+	/* Never have more than one resize in progress. */
+	if (t->oldCtrl != NULL)
+		HashTable_Migrate(t, t->oldSize);
+
+	if (t->bucketsSize == 0)
+		newSize = HASH_GROUP;
+	else if (t->numDeleted > t->numEntries)
+		newSize = t->bucketsSize;
+	else
+		newSize = t->bucketsSize * 2;
+
+	t->oldCtrl = t->ctrl;
+	t->oldBuckets = t->buckets;
+	t->oldSize = t->bucketsSize;
+	t->oldNext = 0;
+
+	HashSlots_Alloc(newSize, &t->ctrl, &t->buckets);
+	t->bucketsSize = newSize;
+	t->bucketsMask = newSize - 1;
+	t->numDeleted = 0;
+
+	DEBUG5(HASH, "%s: %p size=%u entries=%u maxchain=%u\n",
+	       __func__, t, t->bucketsSize, t->numEntries, t->maxchain);
+	t->maxchain = 0;
+
+	if (t->oldSize == 0)
+		HashTable_Migrate(t, 0);
+}
+
+static Hash_Entry *
+HashTable_Find(Hash_Table *t, const Hash_Key *key)
+{
+	int i;
+
+#ifdef DEBUG_HASH_LOOKUP
+	DEBUG4(HASH, "%s: %p h=%x key=%s\n", __func__, t, key->hash, key->str);
+#endif
+
+	t->lookups++;
+	if (t->bucketsSize == 0)
+		return NULL;
+
+	i = HashSlots_Find(t, t->ctrl, t->buckets, t->bucketsSize, key);
+	if (i >= 0)
+		return t->buckets[i];
+
+	if (t->oldCtrl != NULL) {
+		i = HashSlots_Find(t, t->oldCtrl, t->oldBuckets, t->oldSize,
+		    key);
+		if (i >= 0)
+			return t->oldBuckets[i];
+	}
+	return NULL;
 }
 
-/* Sets up the hash table. */
+/* Sets up the hash table.  The slots are allocated on the first insertion,
+ * so that tables that stay empty don't need any memory. */
 void
 Hash_InitTable(Hash_Table *t)
 {
-	unsigned int n = 16, i;
-	struct Hash_Entry **hp;
-
+	t->ctrl = NULL;
+	t->buckets = NULL;
+	t->bucketsSize = 0;
+	t->bucketsMask = 0;
 	t->numEntries = 0;
+	t->numDeleted = 0;
+	t->oldCtrl = NULL;
+	t->oldBuckets = NULL;
+	t->oldSize = 0;
+	t->oldNext = 0;
 	t->maxchain = 0;
-	t->bucketsSize = n;
-	t->bucketsMask = n - 1;
-	t->buckets = hp = bmake_malloc(sizeof(*hp) * n);
-	for (i = 0; i < n; i++)
-		hp[i] = NULL;
+	t->lookups = 0;
+	t->probes = 0;
+	t->internKeys = FALSE;
+}
+
+/* Sets up the hash table, like Hash_InitTable, for keys that are shared
+ * among many tables, such as the names of targets and variables.  The keys
+ * are interned and stay allocated when their entries are deleted. */
+void
+Hash_InitTableInterned(Hash_Table *t)
+{
+	Hash_InitTable(t);
+	t->internKeys = TRUE;
+}
+
+static void
+HashEntry_Free(const Hash_Table *t, Hash_Entry *e)
+{
+	if (!t->internKeys && t != &interned)
+		free(UNCONST(e->name));
+	bmake_pool_free(e, sizeof(*e));
+}
+
+static void
+HashSlots_Free(const Hash_Table *t, unsigned char *ctrl, Hash_Entry **buckets,
+	       unsigned int size)
+{
+	unsigned int i;
+
+	for (i = 0; i < size; i++)
+		if (!(ctrl[i] & 0x80))
+			HashEntry_Free(t, buckets[i]);
+	free(ctrl);
+	free(buckets);
 }
 
 /* Removes everything from the hash table and frees up the memory space it
@@ -143,22 +456,37 @@ Hash_InitTable(Hash_Table *t)
 void
 Hash_DeleteTable(Hash_Table *t)
 {
-	struct Hash_Entry **hp, *h, *nexth = NULL;
-	int i;
-
-	for (hp = t->buckets, i = (int)t->bucketsSize; --i >= 0;) {
-		for (h = *hp++; h != NULL; h = nexth) {
-			nexth = h->next;
-			free(h);
-		}
-	}
-	free(t->buckets);
+	if (t->ctrl != NULL)
+		HashSlots_Free(t, t->ctrl, t->buckets, t->bucketsSize);
+	if (t->oldCtrl != NULL)
+		HashSlots_Free(t, t->oldCtrl, t->oldBuckets, t->oldSize);
 
 	/*
 	 * Set up the hash table to cause memory faults on any future access
 	 * attempts until re-initialization.
 	 */
+	t->ctrl = NULL;
 	t->buckets = NULL;
+	t->oldCtrl = NULL;
+	t->oldBuckets = NULL;
+}
+
+/* Prepare the key for looking it up in one or more tables. */
+void
+Hash_InitKey(Hash_Key *key, const char *str)
+{
+	Hash_InitKeyLen(key, str, strlen(str));
+}
+
+/* Prepare the key for looking it up in one or more tables, when the length
+ * of the string is already known.  The string need not be null-terminated;
+ * entries created from the key get a null-terminated copy. */
+void
+Hash_InitKeyLen(Hash_Key *key, const char *str, size_t len)
+{
+	key->str = str;
+	key->len = len;
+	key->hash = hash(str, len);
 }
 
 /* Searches the hash table for an entry corresponding to the key.
@@ -172,50 +500,32 @@ Hash_DeleteTable(Hash_Table *t)
  *	no entry for the key.
  */
 Hash_Entry *
-Hash_FindEntry(Hash_Table *t, const char *key)
+Hash_FindEntry(Hash_Table *t, const char *str)
 {
-	unsigned int h = hash(key, NULL);
-	return HashTable_Find(t, h, key);
+	Hash_Key key;
+	Hash_InitKey(&key, str);
+	return HashTable_Find(t, &key);
+}
+
+/* Like Hash_FindEntry, but with a precomputed key. */
+Hash_Entry *
+Hash_FindEntryKey(Hash_Table *t, const Hash_Key *key)
+{
+	return HashTable_Find(t, key);
 }
 
 void *
-Hash_FindValue(Hash_Table *t, const char *key)
+Hash_FindValue(Hash_Table *t, const char *str)
 {
-	Hash_Entry *he = Hash_FindEntry(t, key);
+	Hash_Entry *he = Hash_FindEntry(t, str);
 	return he != NULL ? he->value : NULL;
 }
 
-/* Makes a new hash table that is larger than the old one. The entire hash
- * table is moved, so any bucket numbers from the old table become invalid. */
-static void
-RebuildTable(Hash_Table *t)
+void *
+Hash_FindValueKey(Hash_Table *t, const Hash_Key *key)
 {
-	Hash_Entry *e, *next = NULL, **hp, **xp;
-	int i;
-	unsigned int mask, oldsize, newsize;
-	Hash_Entry **oldhp;
-
-	oldhp = t->buckets;
-	oldsize = t->bucketsSize;
-	newsize = oldsize << 1;
-	t->bucketsSize = (unsigned int)newsize;
-	t->bucketsMask = mask = newsize - 1;
-	t->buckets = hp = bmake_malloc(sizeof(*hp) * newsize);
-	i = (int)newsize;
-	while (--i >= 0)
-		*hp++ = NULL;
-	for (hp = oldhp, i = (int)oldsize; --i >= 0;) {
-		for (e = *hp++; e != NULL; e = next) {
-			next = e->next;
-			xp = &t->buckets[e->namehash & mask];
-			e->next = *xp;
-			*xp = e;
-		}
-	}
-	free(oldhp);
-	DEBUG5(HASH, "%s: %p size=%d entries=%d maxchain=%d\n",
-	       __func__, t, t->bucketsSize, t->numEntries, t->maxchain);
-	t->maxchain = 0;
+	Hash_Entry *he = HashTable_Find(t, key);
+	return he != NULL ? he->value : NULL;
 }
 
 /* Searches the hash table for an entry corresponding to the key.
@@ -228,15 +538,20 @@ RebuildTable(Hash_Table *t)
  *			FALSE otherwise.
  */
 Hash_Entry *
-Hash_CreateEntry(Hash_Table *t, const char *key, Boolean *newPtr)
+Hash_CreateEntry(Hash_Table *t, const char *str, Boolean *newPtr)
+{
+	Hash_Key key;
+	Hash_InitKey(&key, str);
+	return Hash_CreateEntryKey(t, &key, newPtr);
+}
+
+/* Like Hash_CreateEntry, but with a precomputed key. */
+Hash_Entry *
+Hash_CreateEntryKey(Hash_Table *t, const Hash_Key *key, Boolean *newPtr)
 {
 	Hash_Entry *e;
-	unsigned h;
-	size_t keylen;
-	struct Hash_Entry **hp;
 
-	h = hash(key, &keylen);
-	e = HashTable_Find(t, h, key);
+	e = HashTable_Find(t, key);
 	if (e) {
 		if (newPtr != NULL)
 			*newPtr = FALSE;
@@ -244,20 +559,26 @@ Hash_CreateEntry(Hash_Table *t, const char *key, Boolean *newPtr)
 	}
 
 	/*
-	 * The desired entry isn't there.  Before allocating a new entry,
-	 * expand the table if necessary (and this changes the resulting
-	 * bucket chain).
+	 * The desired entry isn't there.  Before adding a new entry,
+	 * start growing the table if necessary, or continue moving
+	 * the entries from the previous resize.
 	 */
-	if (t->numEntries >= rebuildLimit * t->bucketsSize)
-		RebuildTable(t);
+	if (t->numEntries + t->numDeleted >= HASH_MAXLOAD(t->bucketsSize))
+		HashTable_Resize(t);
+	else if (t->oldCtrl != NULL)
+		HashTable_Migrate(t, HASH_MIGRATE_STEP);
 
-	e = bmake_malloc(sizeof(*e) + keylen);
-	hp = &t->buckets[h & t->bucketsMask];
-	e->next = *hp;
-	*hp = e;
+	e = bmake_pool_alloc(sizeof(*e));
 	Hash_SetValue(e, NULL);
-	e->namehash = h;
-	memcpy(e->name, key, keylen + 1);
+	e->namehash = key->hash;
+	e->namelen = (unsigned int)key->len;
+	if (t == &interned)
+		e->name = bmake_arena_strldup(key->str, key->len);
+	else if (t->internKeys)
+		e->name = Hash_InternKey(key);
+	else
+		e->name = bmake_strldup(key->str, key->len);
+	HashTable_Place(t, e);
 	t->numEntries++;
 
 	if (newPtr != NULL)
@@ -265,22 +586,74 @@ Hash_CreateEntry(Hash_Table *t, const char *key, Boolean *newPtr)
 	return e;
 }
 
+/* Return the interned copy of the string.  The same string always yields
+ * the same pointer, and the pointer stays valid until the program exits. */
+const char *
+Hash_Intern(const char *str)
+{
+	Hash_Key key;
+	Hash_InitKey(&key, str);
+	return Hash_InternKey(&key);
+}
+
+const char *
+Hash_InternKey(const Hash_Key *key)
+{
+	return Hash_CreateEntryKey(&interned, key, NULL)->name;
+}
+
+void
+Hash_InternStats(void)
+{
+	Hash_DebugStats(&interned, "interned");
+}
+
+/* Mark the slot as unused.  If there is still an empty slot in its group,
+ * no probe sequence has ever continued past this group, so the slot can
+ * become empty again instead of deleted. */
+static void
+HashSlots_Remove(unsigned char *ctrl, unsigned int i, unsigned int *numDeleted)
+{
+	unsigned int base = i & ~(unsigned int)(HASH_GROUP - 1);
+
+	if (HashGroup_Match(ctrl + base, HASH_CTRL_EMPTY) != 0)
+		ctrl[i] = HASH_CTRL_EMPTY;
+	else {
+		ctrl[i] = HASH_CTRL_DELETED;
+		if (numDeleted != NULL)
+			(*numDeleted)++;
+	}
+}
+
 /* Delete the given hash table entry and free memory associated with it. */
 void
 Hash_DeleteEntry(Hash_Table *t, Hash_Entry *e)
 {
-	Hash_Entry **hp, *p;
+	Hash_Key key;
+	int i;
+
+	key.str = e->name;
+	key.len = e->namelen;
+	key.hash = e->namehash;
 
-	for (hp = &t->buckets[e->namehash & t->bucketsMask];
-	     (p = *hp) != NULL; hp = &p->next) {
-		if (p == e) {
-			*hp = p->next;
-			free(p);
-			t->numEntries--;
-			return;
+	i = HashSlots_Find(t, t->ctrl, t->buckets, t->bucketsSize, &key);
+	if (i >= 0 && t->buckets[i] == e) {
+		HashSlots_Remove(t->ctrl, (unsigned int)i, &t->numDeleted);
+		goto found;
+	}
+	if (t->oldCtrl != NULL) {
+		i = HashSlots_Find(t, t->oldCtrl, t->oldBuckets, t->oldSize,
+		    &key);
+		if (i >= 0 && t->oldBuckets[i] == e) {
+			HashSlots_Remove(t->oldCtrl, (unsigned int)i, NULL);
+			goto found;
 		}
 	}
 	abort();
+
+found:
+	HashEntry_Free(t, e);
+	t->numEntries--;
 }
 
 /* Sets things up for enumerating all entries in the hash table.
@@ -311,28 +684,25 @@ Hash_EnumFirst(Hash_Table *t, Hash_Search *searchPtr)
 Hash_Entry *
 Hash_EnumNext(Hash_Search *searchPtr)
 {
-	Hash_Entry *e;
 	Hash_Table *t = searchPtr->table;
 
-	/*
-	 * The entry field points to the most recently returned
-	 * entry, or is NULL if we are starting up.  If not NULL, we have
-	 * to start at the next one in the chain.
-	 */
-	e = searchPtr->entry;
-	if (e != NULL)
-		e = e->next;
-	/*
-	 * If the chain ran out, or if we are starting up, we need to
-	 * find the next nonempty chain.
-	 */
-	while (e == NULL) {
-		if (searchPtr->nextBucket >= t->bucketsSize)
-			return NULL;
-		e = t->buckets[searchPtr->nextBucket++];
+	while (searchPtr->nextBucket < t->oldSize + t->bucketsSize) {
+		unsigned int i = searchPtr->nextBucket++;
+		const unsigned char *ctrl = t->oldCtrl;
+		Hash_Entry **buckets = t->oldBuckets;
+
+		if (i >= t->oldSize) {
+			i -= t->oldSize;
+			ctrl = t->ctrl;
+			buckets = t->buckets;
+		}
+		if (!(ctrl[i] & 0x80)) {
+			searchPtr->entry = buckets[i];
+			return searchPtr->entry;
+		}
 	}
-	searchPtr->entry = e;
-	return e;
+	searchPtr->entry = NULL;
+	return NULL;
 }
 
 void
@@ -350,6 +720,21 @@ Hash_ForEach(Hash_Table *t, void (*action)(void *, void *), void *data)
 void
 Hash_DebugStats(Hash_Table *t, const char *name)
 {
-	DEBUG4(HASH, "Hash_Table %s: size=%u numEntries=%u maxchain=%u\n",
-	       name, t->bucketsSize, t->numEntries, t->maxchain);
+	unsigned int size;
+
+	if (!DEBUG(HASH))
+		return;
+
+	size = t->bucketsSize + t->oldSize;
+
+	DEBUG5(HASH, "Hash_Table %s: size=%u numEntries=%u load=%u%% "
+		     "deleted=%u\n",
+	       name, t->bucketsSize, t->numEntries,
+	       size != 0 ? (unsigned int)(100.0 * t->numEntries / size) : 0,
+	       t->numDeleted);
+	DEBUG5(HASH, "Hash_Table %s: lookups=%lu probes=%.2f maxprobe=%u "
+		     "migrating=%u\n",
+	       name, t->lookups,
+	       t->lookups != 0 ? (double)t->probes / (double)t->lookups : 0.0,
+	       t->maxchain, t->oldSize - t->oldNext);
 }
@@ -79,31 +79,70 @@
 
 /* A single key-value entry in the hash table. */
 typedef struct Hash_Entry {
-    struct Hash_Entry *next;	/* Used to link together all the entries
-				 * associated with the same bucket. */
     void	      *value;
     unsigned	      namehash;	/* hash value of key */
-    char	      name[1];	/* key string, variable length */
+    unsigned	      namelen;	/* strlen(name) */
+    const char	      *name;	/* key string, interned in the tables from
+				 * Hash_InitTableInterned, owned by the
+				 * entry otherwise */
 } Hash_Entry;
 
-/* The hash table containing the entries. */
+/* A key along with its length and hash, so that it can be looked up in
+ * several tables while being hashed only once. */
+typedef struct Hash_Key {
+    const char	      *str;	/* the null-terminated key string */
+    size_t	      len;	/* strlen(str) */
+    unsigned int      hash;
+} Hash_Key;
+
+/*
+ * The hash table containing the entries.
+ *
+ * The table uses open addressing.  Next to the array of entry pointers
+ * there is an array of control bytes, one per slot, that holds either
+ * HASH_CTRL_EMPTY, HASH_CTRL_DELETED or the top 7 bits of the hash of the
+ * entry in that slot.  A lookup scans the control bytes a group of
+ * HASH_GROUP slots at a time and only looks at the entries whose tag
+ * matches, so most probes never touch the entries themselves.
+ *
+ * When the table becomes too full, a larger table is allocated and the
+ * entries are moved over from the old table a few at a time, on each
+ * insertion, instead of all at once.  Until then, lookups consult both
+ * tables.
+ */
 typedef struct Hash_Table {
-    Hash_Entry **buckets;	/* Pointers to Hash_Entry, one
-				 * for each bucket in the table. */
-    unsigned int bucketsSize;
+    unsigned char *ctrl;	/* Control byte for each slot. */
+    Hash_Entry **buckets;	/* The entry for each slot. */
+    unsigned int bucketsSize;	/* Number of slots, a power of 2. */
     unsigned int numEntries;	/* Number of entries in the table. */
-    unsigned int bucketsMask;	/* Used to select the bucket for a hash. */
-    unsigned int maxchain;	/* max length of chain detected */
+    unsigned int bucketsMask;	/* Used to select the slot for a hash. */
+    unsigned int numDeleted;	/* Number of deleted slots in ctrl. */
+    Boolean internKeys;		/* The keys are interned, see Hash_Intern. */
+
+    /* The table being migrated during an incremental resize, or NULL. */
+    unsigned char *oldCtrl;
+    Hash_Entry **oldBuckets;
+    unsigned int oldSize;
+    unsigned int oldNext;	/* Next slot of the old table to migrate. */
+
+    /* Statistics, for Hash_DebugStats. */
+    unsigned int maxchain;	/* Max number of groups probed. */
+    unsigned long lookups;	/* Number of lookups. */
+    unsigned long probes;	/* Number of groups probed in total. */
 } Hash_Table;
 
 /*
  * The following structure is used by the searching routines
  * to record where we are in the search.
+ *
+ * The entry that has just been returned may be deleted during the search,
+ * but no entries may be added.
  */
 typedef struct Hash_Search {
     Hash_Table *table;		/* Table being searched. */
-    unsigned int nextBucket;	/* Next bucket to check (after current). */
-    Hash_Entry *entry;		/* Next entry to check in current bucket. */
+    unsigned int nextBucket;	/* Next slot to check, counting the slots
+				 * of the old table first. */
+    Hash_Entry *entry;		/* The entry returned most recently. */
 } Hash_Search;
 
 static inline MAKE_ATTR_UNUSED void *
@@ -119,14 +158,23 @@ Hash_SetValue(Hash_Entry *h, void *datum)
 }
 
 void Hash_InitTable(Hash_Table *);
+void Hash_InitTableInterned(Hash_Table *);
 void Hash_DeleteTable(Hash_Table *);
+void Hash_InitKey(Hash_Key *, const char *);
+void Hash_InitKeyLen(Hash_Key *, const char *, size_t);
 Hash_Entry *Hash_FindEntry(Hash_Table *, const char *);
+Hash_Entry *Hash_FindEntryKey(Hash_Table *, const Hash_Key *);
 void *Hash_FindValue(Hash_Table *, const char *);
+void *Hash_FindValueKey(Hash_Table *, const Hash_Key *);
 Hash_Entry *Hash_CreateEntry(Hash_Table *, const char *, Boolean *);
+Hash_Entry *Hash_CreateEntryKey(Hash_Table *, const Hash_Key *, Boolean *);
 void Hash_DeleteEntry(Hash_Table *, Hash_Entry *);
 Hash_Entry *Hash_EnumFirst(Hash_Table *, Hash_Search *);
 Hash_Entry *Hash_EnumNext(Hash_Search *);
 void Hash_ForEach(Hash_Table *, void (*)(void *, void *), void *);
 void Hash_DebugStats(Hash_Table *, const char *);
+const char *Hash_Intern(const char *);
+const char *Hash_InternKey(const Hash_Key *);
+void Hash_InternStats(void);
 
 #endif /* MAKE_HASH_H */
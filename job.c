@@ -361,7 +361,7 @@ static void
 JobDeleteTarget(GNode *gn)
 {
 	if ((gn->type & (OP_JOIN|OP_PHONY)) == 0 && !Targ_Precious(gn)) {
-	    char *file = (gn->path == NULL ? gn->name : gn->path);
+	    const char *file = (gn->path == NULL ? gn->name : gn->path);
 	    if (!noExecute && eunlink(file) != -1) {
 		Error("*** %s removed", file);
 	    }
@@ -1047,7 +1047,7 @@ Job_Touch(GNode *gn, Boolean silent)
     } else if (gn->type & OP_LIB) {
 	Arch_TouchLib(gn);
     } else {
-	char	*file = gn->path ? gn->path : gn->name;
+	const char *file = gn->path ? gn->path : gn->name;
 
 	times.actime = times.modtime = now;
 	if (utime(file, &times) < 0){
@@ -1092,7 +1092,7 @@ Boolean
 Job_CheckCommands(GNode *gn, void (*abortProc)(const char *, ...))
 {
     if (OP_NOP(gn->type) && Lst_IsEmpty(gn->commands) &&
-	((gn->type & OP_LIB) == 0 || Lst_IsEmpty(gn->children))) {
+	((gn->type & OP_LIB) == 0 || GNodeVec_IsEmpty(&gn->children))) {
 	/*
 	 * No commands. Look for .DEFAULT rule from which we might infer
 	 * commands
@@ -1158,6 +1158,7 @@ JobExec(Job *job, char **argv)
 {
     int cpid;			/* ID of new child */
     sigset_t	  mask;
+    char **env;
 
     job->flags &= ~JOB_TRACED;
 
@@ -1183,6 +1184,8 @@ JobExec(Job *job, char **argv)
 	lastNode = job->node;
     }
 
+    env = Var_ExportVars();
+
     /* No interruptions until this job is on the `jobs' list */
     JobSigLock(&mask);
 
@@ -1283,9 +1286,7 @@ JobExec(Job *job, char **argv)
 #endif
 #endif
 
-	Var_ExportVars();
-
-	(void)execv(shellPath, argv);
+	(void)execve(shellPath, argv, env);
 	execError("exec", shellPath);
 	_exit(1);
     }
@@ -2413,7 +2414,7 @@ int
 Job_Finish(void)
 {
     GNode *endNode = Targ_GetEndNode();
-    if (!Lst_IsEmpty(endNode->commands) || !Lst_IsEmpty(endNode->children)) {
+    if (!Lst_IsEmpty(endNode->commands) || !GNodeVec_IsEmpty(&endNode->children)) {
 	if (errors) {
 	    Error("Errors reported so .END ignored");
 	} else {
@@ -49,7 +49,7 @@ MAKE_RCSID("$NetBSD: lst.c,v 1.74 2020/09/30 06:27:02 rillig Exp $");
 static ListNode *
 LstNodeNew(void *datum)
 {
-    ListNode *node = bmake_malloc(sizeof *node);
+    ListNode *node = bmake_pool_alloc(sizeof *node);
     node->priv_useCount = 0;
     node->priv_deleted = FALSE;
     node->datum = datum;
@@ -66,7 +66,7 @@ LstIsEmpty(List *list)
 List *
 Lst_Init(void)
 {
-    List *list = bmake_malloc(sizeof *list);
+    List *list = bmake_pool_alloc(sizeof *list);
 
     list->first = NULL;
     list->last = NULL;
@@ -104,10 +104,10 @@ Lst_Free(List *list)
 
     for (node = list->first; node != NULL; node = next) {
 	next = node->next;
-	free(node);
+	bmake_pool_free(node, sizeof *node);
     }
 
-    free(list);
+    bmake_pool_free(list, sizeof *list);
 }
 
 /* Destroy a list and free all its resources. The freeProc is called with the
@@ -121,10 +121,10 @@ Lst_Destroy(List *list, LstFreeProc freeProc)
     for (node = list->first; node != NULL; node = next) {
 	next = node->next;
 	freeProc(node->datum);
-	free(node);
+	bmake_pool_free(node, sizeof *node);
     }
 
-    free(list);
+    bmake_pool_free(list, sizeof *list);
 }
 
 /*
@@ -241,7 +241,7 @@ Lst_Remove(List *list, ListNode *node)
      * necessary and as expected.
      */
     if (node->priv_useCount == 0) {
-	free(node);
+	bmake_pool_free(node, sizeof *node);
     } else {
 	node->priv_deleted = TRUE;
     }
@@ -361,7 +361,7 @@ Lst_ForEachUntil(List *list, LstActionUntilProc proc, void *procData)
 	}
 
 	if (tln->priv_deleted) {
-	    free((char *)tln);
+	    bmake_pool_free(tln, sizeof *tln);
 	}
 	tln = next;
 	if (result || LstIsEmpty(list) || done)
@@ -385,7 +385,7 @@ Lst_MoveAll(List *list1, List *list2)
 	}
 	list1->last = list2->last;
     }
-    free(list2);
+    bmake_pool_free(list2, sizeof *list2);
 }
 
 /* Copy the element data from src to the start of dst. */
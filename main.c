@@ -780,7 +780,7 @@ Main_SetObjdir(const char *fmt, ...)
 		} else {
 			snprintf(objdir, sizeof objdir, "%s", path);
 			Var_Set(".OBJDIR", objdir, VAR_GLOBAL);
-			setenv("PWD", objdir, 1);
+			Var_Setenv("PWD", objdir);
 			Dir_InitDot();
 			purge_cached_realpaths();
 			rc = TRUE;
@@ -1402,10 +1402,13 @@ main(int argc, char **argv)
 		if (Lst_IsEmpty(sysMkPath))
 			Fatal("%s: no system rules (%s).", progname,
 			    _PATH_DEFSYSMK);
-		ln = Lst_Find(sysMkPath, ReadMakefileSucceeded, NULL);
-		if (ln == NULL)
-			Fatal("%s: cannot open %s.", progname,
-			    (char *)LstNode_Datum(Lst_First(sysMkPath)));
+		if (!Snapshot_Load(sysMkPath)) {
+			ln = Lst_Find(sysMkPath, ReadMakefileSucceeded, NULL);
+			if (ln == NULL)
+				Fatal("%s: cannot open %s.", progname,
+				    (char *)LstNode_Datum(Lst_First(sysMkPath)));
+			Snapshot_Save();
+		}
 	}
 
 	if (!Lst_IsEmpty(makefiles)) {
@@ -1558,6 +1561,7 @@ main(int argc, char **argv)
 #ifdef USE_META
 	meta_finish();
 #endif
+	bmake_pool_stats();
 	Suff_End();
 	Targ_End();
 	Arch_End();
@@ -1566,6 +1570,9 @@ main(int argc, char **argv)
 	Dir_End();
 	Job_End();
 	Trace_End();
+#ifdef CLEANUP
+	bmake_arena_free();
+#endif
 
 	return outOfDate ? 1 : 0;
 }
@@ -1634,21 +1641,10 @@ found:
 
 
 
-/*-
- * Cmd_Exec --
- *	Execute the command in cmd, and return the output of that command
- *	in a string.  In the output, newlines are replaced with spaces.
- *
- * Results:
- *	A string containing the output of the command, or the empty string.
- *	*errfmt returns a format string describing the command failure,
- *	if any, using a single %s conversion specification.
- *
- * Side Effects:
- *	The string must be freed by the caller.
- */
-char *
-Cmd_Exec(const char *cmd, const char **errfmt)
+/* Execute the command in the environment and return its output, see
+ * Cmd_Exec. */
+static char *
+CmdExec(const char *cmd, char **env, const char **errfmt)
 {
     const char	*args[4];	/* Args for invoking the shell */
     int		fds[2];		/* Pipe streams */
@@ -1664,8 +1660,8 @@ Cmd_Exec(const char *cmd, const char **errfmt)
 
     *errfmt = NULL;
 
-    if (!shellName)
-	Shell_Init();
+    /* The command may create or remove files. */
+    Dir_Changed();
     /*
      * Set up arguments for shell
      */
@@ -1700,9 +1696,7 @@ Cmd_Exec(const char *cmd, const char **errfmt)
 	(void)dup2(fds[1], 1);
 	(void)close(fds[1]);
 
-	Var_ExportVars();
-
-	(void)execv(shellPath, UNCONST(args));
+	(void)execve(shellPath, UNCONST(args), env);
 	_exit(1);
 	/*NOTREACHED*/
 
@@ -1765,6 +1759,229 @@ bad:
     return bmake_strdup("");
 }
 
+/*
+ * The results of shell commands can be cached on disk, so that the same
+ * command doesn't have to be run again in every sub-make.  This is enabled
+ * by setting .MAKE.SHELL_CACHE to the directory of the cache.  The cache key
+ * consists of the command, the shell, the current working directory, the
+ * environment variables listed in .MAKE.SHELL_CACHE.ENV and the
+ * modification times of the files listed in .MAKE.SHELL_CACHE.FILES.
+ *
+ * Each cache file is named after the hash of its key.  It starts with a
+ * header line containing the length of the key, followed by the key itself,
+ * followed by the output of the command.
+ */
+#define SHELL_CACHE_MAGIC "bmake-shell-cache"
+
+/* Add the words of the variable, expanded, to the buffer, one per line,
+ * each preceded by the tag and followed by the info from addInfo. */
+static void
+ShellCache_AddDeps(Buffer *buf, const char *expr, const char *tag,
+		   void (*addInfo)(Buffer *, const char *, void *), void *data)
+{
+    char *val;
+    Words words;
+    size_t i;
+
+    (void)Var_Subst(expr, VAR_GLOBAL, VARE_WANTRES, &val);
+    /* TODO: handle errors */
+    words = Str_Words(val, FALSE);
+    for (i = 0; i < words.len; i++) {
+	if (words.words[i][0] == '\0')
+	    continue;
+	Buf_AddStr(buf, tag);
+	Buf_AddStr(buf, words.words[i]);
+	addInfo(buf, words.words[i], data);
+	Buf_AddByte(buf, '\n');
+    }
+    Words_Free(words);
+    free(val);
+}
+
+/* Add the value of the variable from the environment that the command
+ * gets, which also contains the variables that are only exported to the
+ * child processes.  That environment is taken after the names have been
+ * expanded, since expanding them may change it. */
+static void
+ShellCache_AddEnv(Buffer *buf, const char *name, void *data)
+{
+    char ***envp = data;
+    size_t namelen = strlen(name);
+    char **ep;
+
+    if (*envp == NULL)
+	*envp = Var_ExportVars();
+    for (ep = *envp; *ep != NULL; ep++) {
+	if (strncmp(*ep, name, namelen) == 0 && (*ep)[namelen] == '=') {
+	    Buf_AddStr(buf, *ep + namelen);
+	    return;
+	}
+    }
+}
+
+static void
+ShellCache_AddFile(Buffer *buf, const char *name, void *data MAKE_ATTR_UNUSED)
+{
+    struct stat st;
+    char info[64];
+
+    if (stat(name, &st) == 0)
+	snprintf(info, sizeof info, " %lld %lld",
+		 (long long)st.st_mtime, (long long)st.st_size);
+    else
+	snprintf(info, sizeof info, " missing");
+    Buf_AddStr(buf, info);
+}
+
+/* Return the path of the cache file for the key. */
+static char *
+ShellCache_Path(const char *dir, const char *key, size_t keylen)
+{
+    unsigned long long h = 14695981039346656037ULL;	/* FNV-1a */
+    char name[32];
+    size_t i;
+
+    for (i = 0; i < keylen; i++) {
+	h ^= (unsigned char)key[i];
+	h *= 1099511628211ULL;
+    }
+    snprintf(name, sizeof name, "/sh-%016llx", h);
+    return str_concat2(dir, name);
+}
+
+/* Return the cached output for the key, or NULL. */
+static char *
+ShellCache_Read(const char *path, const char *key, size_t keylen)
+{
+    FILE *fp;
+    char header[64];
+    unsigned long len;
+    Buffer buf;
+    char chunk[BUFSIZ];
+    size_t n;
+    char *data;
+
+    if ((fp = fopen(path, "r")) == NULL)
+	return NULL;
+    if (fgets(header, sizeof header, fp) == NULL ||
+	sscanf(header, SHELL_CACHE_MAGIC " %lu", &len) != 1 ||
+	len != keylen) {
+	(void)fclose(fp);
+	return NULL;
+    }
+
+    Buf_Init(&buf, 0);
+    while ((n = fread(chunk, 1, sizeof chunk, fp)) > 0)
+	Buf_AddBytes(&buf, chunk, n);
+    if (ferror(fp) ||
+	Buf_Len(&buf) < keylen ||
+	memcmp(Buf_GetAll(&buf, NULL), key, keylen) != 0) {
+	(void)fclose(fp);
+	Buf_Destroy(&buf, TRUE);
+	return NULL;
+    }
+    (void)fclose(fp);
+
+    data = Buf_Destroy(&buf, FALSE);
+    memmove(data, data + keylen, strlen(data + keylen) + 1);
+    return data;
+}
+
+/* Store the output of the command in the cache.  Errors are ignored, the
+ * command is then simply run again next time. */
+static void
+ShellCache_Write(const char *path, const char *key, size_t keylen,
+		 const char *res)
+{
+    char tmp[MAXPATHLEN];
+    FILE *fp;
+    Boolean ok;
+
+    snprintf(tmp, sizeof tmp, "%s.%ld", path, (long)getpid());
+    if ((fp = fopen(tmp, "w")) == NULL)
+	return;
+    ok = fprintf(fp, "%s %lu\n", SHELL_CACHE_MAGIC,
+		 (unsigned long)keylen) > 0 &&
+	 fwrite(key, 1, keylen, fp) == keylen &&
+	 fputs(res, fp) != EOF;
+    if (fclose(fp) != 0)
+	ok = FALSE;
+    if (!ok || rename(tmp, path) != 0)
+	(void)unlink(tmp);
+}
+
+/*-
+ * Cmd_Exec --
+ *	Execute the command in cmd, and return the output of that command
+ *	in a string.  In the output, newlines are replaced with spaces.
+ *
+ *	If .MAKE.SHELL_CACHE is set, the output is taken from the cache
+ *	if possible, and successful results are added to the cache.
+ *
+ * Results:
+ *	A string containing the output of the command, or the empty string.
+ *	*errfmt returns a format string describing the command failure,
+ *	if any, using a single %s conversion specification.
+ *
+ * Side Effects:
+ *	The string must be freed by the caller.
+ */
+char *
+Cmd_Exec(const char *cmd, const char **errfmt)
+{
+    char *dir;
+    Buffer key;
+    size_t keylen;
+    char *path, *res;
+    char **env = NULL;
+    char cwd[MAXPATHLEN];
+
+    if (!shellName)
+	Shell_Init();
+    if (!Var_Exists(MAKE_SHELL_CACHE, VAR_GLOBAL))
+	return CmdExec(cmd, Var_ExportVars(), errfmt);
+    (void)Var_Subst("${" MAKE_SHELL_CACHE "}", VAR_GLOBAL, VARE_WANTRES, &dir);
+    /* TODO: handle errors */
+    if (dir[0] == '\0' || getcwd(cwd, sizeof cwd) == NULL) {
+	free(dir);
+	return CmdExec(cmd, Var_ExportVars(), errfmt);
+    }
+
+    Buf_Init(&key, 0);
+    Buf_AddStr(&key, "shell ");
+    Buf_AddStr(&key, shellPath);
+    Buf_AddStr(&key, "\ncwd ");
+    Buf_AddStr(&key, cwd);
+    Buf_AddStr(&key, "\ncmd ");
+    Buf_AddStr(&key, cmd);
+    Buf_AddByte(&key, '\n');
+    ShellCache_AddDeps(&key, "${" MAKE_SHELL_CACHE_FILES ":U}", "file ",
+		       ShellCache_AddFile, NULL);
+    /* Last, so that nothing is expanded between taking the environment
+     * for the key and running the command in it. */
+    ShellCache_AddDeps(&key, "${" MAKE_SHELL_CACHE_ENV ":U}", "env ",
+		       ShellCache_AddEnv, &env);
+    if (env == NULL)
+	env = Var_ExportVars();
+    keylen = Buf_Len(&key);
+
+    path = ShellCache_Path(dir, Buf_GetAll(&key, NULL), keylen);
+    res = ShellCache_Read(path, Buf_GetAll(&key, NULL), keylen);
+    if (res != NULL) {
+	DEBUG2(VAR, "Cmd_Exec: cached \"%s\" in %s\n", cmd, path);
+	*errfmt = NULL;
+    } else {
+	res = CmdExec(cmd, env, errfmt);
+	if (*errfmt == NULL)
+	    ShellCache_Write(path, Buf_GetAll(&key, NULL), keylen, res);
+    }
+
+    free(path);
+    Buf_Destroy(&key, TRUE);
+    free(dir);
+    return res;
+}
+
 /* Print a printf-style error message.
  *
  * This error message has no consequences, in particular it does not affect
@@ -1971,6 +2188,9 @@ get_cached_realpaths(void)
 
     if (!cached_realpaths) {
 	cached_realpaths = Targ_NewGN("Realpath");
+	/* The paths are not shared with other tables, so the cache
+	 * keeps its own copies of them instead of interning them. */
+	Hash_InitTable(&cached_realpaths->context);
 #ifndef DEBUG_REALPATH_CACHE
 	cached_realpaths->flags = INTERNAL;
 #endif
@@ -2063,6 +2283,7 @@ PrintOnError(GNode *gn, const char *s)
     if (DEBUG(HASH)) {
 	Targ_Stats();
 	Var_Stats();
+	bmake_pool_stats();
     }
 
     /* we generally want to keep quiet if a sub-make died */
@@ -2117,9 +2338,9 @@ Main_ExportMAKEFLAGS(Boolean first)
     /* TODO: handle errors */
     if (s[0] != '\0') {
 #ifdef POSIX
-	setenv("MAKEFLAGS", s, 1);
+	Var_Setenv("MAKEFLAGS", s);
 #else
-	setenv("MAKE", s, 1);
+	Var_Setenv("MAKE", s);
 #endif
     }
 }
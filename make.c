@@ -94,6 +94,10 @@
  *			sure that any variable that needs to exist
  *			at the very least has the empty value.
  *
+ *	Make_ForceAllVar
+ *			Compute the variables whose setup has been
+ *			deferred by Make_DoAllVar.
+ *
  *	Make_OODate	Determine if a target is out-of-date.
  *
  *	Make_HandleUse	See if a child is a .USE node for a parent
@@ -117,8 +121,8 @@ static unsigned int checked = 1;
  * It is added to by Make_Update and subtracted from by MakeStartJobs */
 static GNodeList *toBeMade;
 
-static int MakeCheckOrder(void *, void *);
-static int MakeBuildParent(void *, void *);
+static Boolean MakeCheckOrder(GNode *);
+static void MakeBuildParents(GNodeVec *, GNodeListNode *);
 
 void
 debug_printf(const char *fmt, ...)
@@ -155,10 +159,10 @@ ENUM_FLAGS_RTTI_31(GNodeType,
 		   OP_TRANSFORM, OP_MEMBER, OP_LIB, OP_ARCHV,
 		   OP_HAS_COMMANDS, OP_SAVE_CMDS, OP_DEPS_FOUND, OP_MARK);
 
-ENUM_FLAGS_RTTI_10(GNodeFlags,
+ENUM_FLAGS_RTTI_11(GNodeFlags,
 		   REMAKE, CHILDMADE, FORCE, DONE_WAIT,
-		   DONE_ORDER, FROM_DEPEND, DONE_ALLSRC, CYCLE,
-		   DONECYCLE, INTERNAL);
+		   DONE_ORDER, FROM_DEPEND, DONE_ALLSRC, LAZY_ALLSRC,
+		   CYCLE, DONECYCLE, INTERNAL);
 
 void
 GNode_FprintDetails(FILE *f, const char *prefix, const GNode *gn,
@@ -186,12 +190,6 @@ Make_TimeStamp(GNode *pgn, GNode *cgn)
     }
 }
 
-static void
-MakeTimeStamp(void *pgn, void *cgn)
-{
-    Make_TimeStamp(pgn, cgn);
-}
-
 /* See if the node is out of date with respect to its sources.
  *
  * Used by Make_Run when deciding which nodes to place on the
@@ -329,25 +327,23 @@ Make_OODate(GNode *gn)
      * thinking they're out-of-date.
      */
     if (!oodate) {
-	Lst_ForEach(gn->parents, MakeTimeStamp, gn);
+	unsigned int i;
+	for (i = 0; i < gn->parents.len; i++)
+	    Make_TimeStamp(GNodeVec_Get(&gn->parents, i), gn);
     }
 
     return oodate;
 }
 
 /* Add the node to the list if it needs to be examined. */
-static int
-MakeAddChild(void *gnp, void *lp)
+static void
+MakeAddChild(GNode *gn, GNodeList *l)
 {
-    GNode *gn = gnp;
-    GNodeList *l = lp;
-
     if ((gn->flags & REMAKE) == 0 && !(gn->type & (OP_USE|OP_USEBEFORE))) {
 	DEBUG2(MAKE, "MakeAddChild: need to examine %s%s\n",
 	       gn->name, gn->cohort_num);
 	Lst_Enqueue(l, gn);
     }
-    return 0;
 }
 
 /* Find the pathname of a child that was already made.
@@ -358,17 +354,22 @@ MakeAddChild(void *gnp, void *lp)
  * Input:
  *	gnp		the node to find
  */
-static int
-MakeFindChild(void *gnp, void *pgnp)
+static void
+MakeFindChild(GNode *gn, GNode *pgn)
 {
-    GNode          *gn = (GNode *)gnp;
-    GNode          *pgn = (GNode *)pgnp;
-
     (void)Dir_MTime(gn, 0);
     Make_TimeStamp(pgn, gn);
     pgn->unmade--;
+}
 
-    return 0;
+/* Add the nodes to the front of the list, keeping their order. */
+static void
+MakePrependAll(GNodeList *l, GNodeVec *gnodes)
+{
+    unsigned int i;
+
+    for (i = gnodes->len; i > 0; i--)
+	Lst_Prepend(l, GNodeVec_Get(gnodes, i - 1));
 }
 
 /* Called by Make_Run and SuffApplyTransform on the downward pass to handle
@@ -386,7 +387,7 @@ MakeFindChild(void *gnp, void *pgnp)
 void
 Make_HandleUse(GNode *cgn, GNode *pgn)
 {
-    GNodeListNode *ln;	/* An element in the children list */
+    unsigned int i;
 
 #ifdef DEBUG_SRC
     if ((cgn->type & (OP_USE|OP_USEBEFORE|OP_TRANSFORM)) == 0) {
@@ -405,9 +406,9 @@ Make_HandleUse(GNode *cgn, GNode *pgn)
 	    }
     }
 
-    Lst_Open(cgn->children);
-    while ((ln = Lst_Next(cgn->children)) != NULL) {
-	GNode *gn = LstNode_Datum(ln);
+    for (i = 0; i < cgn->children.len; i++) {
+	GNode *gn = GNodeVec_Get(&cgn->children, i);
+	char *name;
 
 	/*
 	 * Expand variables in the .USE node's name
@@ -415,13 +416,12 @@ Make_HandleUse(GNode *cgn, GNode *pgn)
 	 * We don't need to do this for commands.
 	 * They get expanded properly when we execute.
 	 */
-	if (gn->uname == NULL) {
+	if (gn->uname == NULL)
 	    gn->uname = gn->name;
-	} else {
-	    free(gn->name);
-	}
-	(void)Var_Subst(gn->uname, pgn, VARE_WANTRES, &gn->name);
+	(void)Var_Subst(gn->uname, pgn, VARE_WANTRES, &name);
 	/* TODO: handle errors */
+	gn->name = Hash_Intern(name);
+	free(name);
 	if (gn->uname && strcmp(gn->name, gn->uname) != 0) {
 	    /* See if we have a target for this node. */
 	    GNode *tgn = Targ_FindNode(gn->name);
@@ -429,11 +429,10 @@ Make_HandleUse(GNode *cgn, GNode *pgn)
 		gn = tgn;
 	}
 
-	Lst_Append(pgn->children, gn);
-	Lst_Append(gn->parents, pgn);
+	GNodeVec_Append(&pgn->children, gn);
+	GNodeVec_Append(&gn->parents, pgn);
 	pgn->unmade++;
     }
-    Lst_Close(cgn->children);
 
     pgn->type |= cgn->type & ~(OP_OPMASK|OP_USE|OP_USEBEFORE|OP_TRANSFORM);
 }
@@ -446,19 +445,23 @@ Make_HandleUse(GNode *cgn, GNode *pgn)
  * needed, that relation is removed.
  *
  * Input:
- *	cgn		the child, which may be a .USE node
  *	pgn		the current parent
+ *	i		the index of the child, which may be a .USE node
+ *
+ * Results:
+ *	TRUE if the child has been removed from the parent's children.
  */
-static void
-MakeHandleUse(GNode *cgn, GNode *pgn, GNodeListNode *ln)
+static Boolean
+MakeHandleUse(GNode *pgn, unsigned int i)
 {
+    GNode *cgn = GNodeVec_Get(&pgn->children, i);
     Boolean unmarked;
 
     unmarked = ((cgn->type & OP_MARK) == 0);
     cgn->type |= OP_MARK;
 
     if ((cgn->type & (OP_USE|OP_USEBEFORE)) == 0)
-	return;
+	return FALSE;
 
     if (unmarked)
 	Make_HandleUse(cgn, pgn);
@@ -470,17 +473,25 @@ MakeHandleUse(GNode *cgn, GNode *pgn, GNodeListNode *ln)
      * children the parent has. This is used by Make_Run to decide
      * whether to queue the parent or examine its children...
      */
-    Lst_Remove(pgn->children, ln);
+    GNodeVec_Remove(&pgn->children, i);
     pgn->unmade--;
+    return TRUE;
 }
 
+/* Handle the .USE children of the node.  The children that a .USE node
+ * adds are appended to the list and are examined as well, except when the
+ * .USE node was the last child to begin with. */
 static void
 HandleUseNodes(GNode *gn)
 {
-    GNodeListNode *ln, *nln;
-    for (ln = gn->children->first; ln != NULL; ln = nln) {
-	nln = ln->next;
-        MakeHandleUse(ln->datum, gn, ln);
+    unsigned int i = 0;
+
+    while (i < gn->children.len) {
+	Boolean wasLast = i + 1 == gn->children.len;
+	if (!MakeHandleUse(gn, i))
+	    i++;
+	if (wasLast)
+	    break;
     }
 }
 
@@ -517,7 +528,7 @@ Make_Recheck(GNode *gn)
      * To force things that depend on FRC to be made, so we have to
      * check for gn->children being empty as well...
      */
-    if (!Lst_IsEmpty(gn->commands) || Lst_IsEmpty(gn->children)) {
+    if (!Lst_IsEmpty(gn->commands) || GNodeVec_IsEmpty(&gn->children)) {
 	gn->mtime = now;
     }
 #else
@@ -582,10 +593,10 @@ Make_Update(GNode *cgn)
 {
     GNode *pgn;			/* the parent node */
     const char *cname;		/* the child's name */
-    GNodeListNode *ln;
+    unsigned int i;
     time_t	mtime = -1;
     char	*p1;
-    GNodeList *parents;
+    GNodeVec	*parents;
     GNode	*centurion;
 
     /* It is save to re-examine any nodes again */
@@ -610,7 +621,7 @@ Make_Update(GNode *cgn)
      * which is where all parents are linked.
      */
     if ((centurion = cgn->centurion) != NULL) {
-	if (!Lst_IsEmpty(cgn->parents))
+	if (!GNodeVec_IsEmpty(&cgn->parents))
 		Punt("%s%s: cohort has parents", cgn->name, cgn->cohort_num);
 	centurion->unmade_cohorts--;
 	if (centurion->unmade_cohorts < 0)
@@ -618,15 +629,14 @@ Make_Update(GNode *cgn)
     } else {
 	centurion = cgn;
     }
-    parents = centurion->parents;
+    parents = &centurion->parents;
 
     /* If this was a .ORDER node, schedule the RHS */
-    Lst_ForEachUntil(centurion->order_succ, MakeBuildParent, Lst_First(toBeMade));
+    MakeBuildParents(&centurion->order_succ, Lst_First(toBeMade));
 
     /* Now mark all the parents as having one less unmade child */
-    Lst_Open(parents);
-    while ((ln = Lst_Next(parents)) != NULL) {
-	pgn = LstNode_Datum(ln);
+    for (i = 0; i < parents->len; i++) {
+	pgn = GNodeVec_Get(parents, i);
 	if (DEBUG(MAKE))
 	    debug_printf("inspect parent %s%s: flags %x, "
 			 "type %x, made %d, unmade %d ",
@@ -696,8 +706,7 @@ Make_Update(GNode *cgn)
 	    DEBUG0(MAKE, "- not deferred\n");
 	    continue;
 	}
-	assert(pgn->order_pred != NULL);
-	if (Lst_ForEachUntil(pgn->order_pred, MakeCheckOrder, 0)) {
+	if (MakeCheckOrder(pgn)) {
 	    /* A .ORDER rule stops us building this */
 	    continue;
 	}
@@ -711,18 +720,16 @@ Make_Update(GNode *cgn)
 	pgn->made = REQUESTED;
 	Lst_Enqueue(toBeMade, pgn);
     }
-    Lst_Close(parents);
 
     /*
      * Set the .PREFIX and .IMPSRC variables for all the implied parents
      * of this node.
      */
-    Lst_Open(cgn->implicitParents);
     {
 	const char *cpref = Var_Value(PREFIX, cgn, &p1);
 
-	while ((ln = Lst_Next(cgn->implicitParents)) != NULL) {
-	    pgn = LstNode_Datum(ln);
+	for (i = 0; i < cgn->implicitParents.len; i++) {
+	    pgn = GNodeVec_Get(&cgn->implicitParents, i);
 	    if (pgn->flags & REMAKE) {
 		Var_Set(IMPSRC, cname, pgn);
 		if (cpref != NULL)
@@ -730,23 +737,22 @@ Make_Update(GNode *cgn)
 	    }
 	}
 	bmake_free(p1);
-	Lst_Close(cgn->implicitParents);
     }
 }
 
 static void
 UnmarkChildren(GNode *gn)
 {
-    GNodeListNode *ln;
+    unsigned int i;
 
-    for (ln = gn->children->first; ln != NULL; ln = ln->next) {
-	GNode *child = ln->datum;
+    for (i = 0; i < gn->children.len; i++) {
+	GNode *child = GNodeVec_Get(&gn->children, i);
 	child->type &= ~OP_MARK;
     }
 }
 
 /* Add a child's name to the ALLSRC and OODATE variables of the given
- * node. Called from Make_DoAllVar via Lst_ForEachUntil. A child is added only
+ * node. Called from Make_DoAllVar for each child. A child is added only
  * if it has not been given the .EXEC, .USE or .INVISIBLE attributes.
  * .EXEC and .USE children are very rarely going to be files, so...
  * If the child is a .JOIN node, its ALLSRC is propagated to the parent.
@@ -758,16 +764,13 @@ UnmarkChildren(GNode *gn)
  * modification times, the comparison is rather unfair...)..
  *
  * Input:
- *	cgnp		The child to add
- *	pgnp		The parent to whose ALLSRC variable it should
+ *	cgn		The child to add
+ *	pgn		The parent to whose ALLSRC variable it should
  *			be added
  */
 static void
-MakeAddAllSrc(void *cgnp, void *pgnp)
+MakeAddAllSrc(GNode *cgn, GNode *pgn)
 {
-    GNode	*cgn = (GNode *)cgnp;
-    GNode	*pgn = (GNode *)pgnp;
-
     if (cgn->type & OP_MARK)
 	return;
     cgn->type |= OP_MARK;
@@ -830,14 +833,14 @@ MakeAddAllSrc(void *cgnp, void *pgnp)
  * If the node is a .JOIN node, its TARGET variable will be set to
  * match its ALLSRC variable.
  */
-void
-Make_DoAllVar(GNode *gn)
+static void
+MakeDoAllVar(GNode *gn)
 {
-    if (gn->flags & DONE_ALLSRC)
-	return;
+    unsigned int i;
 
     UnmarkChildren(gn);
-    Lst_ForEach(gn->children, MakeAddAllSrc, gn);
+    for (i = 0; i < gn->children.len; i++)
+	MakeAddAllSrc(GNodeVec_Get(&gn->children, i), gn);
 
     if (!Var_Exists(OODATE, gn)) {
 	Var_Set(OODATE, "", gn);
@@ -851,34 +854,72 @@ Make_DoAllVar(GNode *gn)
 	Var_Set(TARGET, Var_Value(ALLSRC, gn, &p1), gn);
 	bmake_free(p1);
     }
+}
+
+/* Arrange for the ALLSRC and OODATE variables of the node to be set up.
+ *
+ * Most commands never refer to these variables, and for targets with many
+ * children, building them is expensive.  Therefore they are only computed
+ * when they are first looked up, see Make_ForceAllVar.  A .JOIN node needs
+ * its variables right away since its TARGET is derived from them.
+ */
+void
+Make_DoAllVar(GNode *gn)
+{
+    if (gn->flags & DONE_ALLSRC)
+	return;
+
     gn->flags |= DONE_ALLSRC;
+    if (gn->type & OP_JOIN)
+	MakeDoAllVar(gn);
+    else
+	gn->flags |= LAZY_ALLSRC;
 }
 
-static int
-MakeCheckOrder(void *v_bn, void *ignore MAKE_ATTR_UNUSED)
+/* Compute the ALLSRC and OODATE variables of the node if that has been
+ * deferred by Make_DoAllVar.  Called by the variable module before looking
+ * up one of these variables. */
+void
+Make_ForceAllVar(GNode *gn)
+{
+    if (!(gn->flags & LAZY_ALLSRC))
+	return;
+
+    gn->flags &= ~(unsigned)LAZY_ALLSRC;
+    MakeDoAllVar(gn);
+}
+
+/* Return TRUE if one of the .ORDER predecessors of the node still needs to
+ * be made. */
+static Boolean
+MakeCheckOrder(GNode *gn)
 {
-    GNode *bn = v_bn;
+    unsigned int i;
 
-    if (bn->made >= MADE || !(bn->flags & REMAKE))
-	return 0;
-    DEBUG2(MAKE, "MakeCheckOrder: Waiting for .ORDER node %s%s\n",
-	   bn->name, bn->cohort_num);
-    return 1;
+    for (i = 0; i < gn->order_pred.len; i++) {
+	GNode *bn = GNodeVec_Get(&gn->order_pred, i);
+
+	if (bn->made >= MADE || !(bn->flags & REMAKE))
+	    continue;
+	DEBUG2(MAKE, "MakeCheckOrder: Waiting for .ORDER node %s%s\n",
+	       bn->name, bn->cohort_num);
+	return TRUE;
+    }
+    return FALSE;
 }
 
+static void MakeBuildChildren(GNodeVec *, GNodeListNode *);
+
 static int
-MakeBuildChild(void *v_cn, void *toBeMade_next)
+MakeBuildChild(GNode *cn, GNodeListNode *toBeMade_next)
 {
-    GNode *cn = v_cn;
-
     DEBUG4(MAKE, "MakeBuildChild: inspect %s%s, made %d, type %x\n",
 	   cn->name, cn->cohort_num, cn->made, cn->type);
     if (cn->made > DEFERRED)
 	return 0;
 
     /* If this node is on the RHS of a .ORDER, check LHSs. */
-    assert(cn->order_pred);
-    if (Lst_ForEachUntil(cn->order_pred, MakeCheckOrder, 0)) {
+    if (MakeCheckOrder(cn)) {
 	/* Can't build this (or anything else in this child list) yet */
 	cn->made = DEFERRED;
 	return 0;			/* but keep looking */
@@ -893,7 +934,7 @@ MakeBuildChild(void *v_cn, void *toBeMade_next)
 	Lst_InsertBefore(toBeMade, toBeMade_next, cn);
 
     if (cn->unmade_cohorts != 0)
-	Lst_ForEachUntil(cn->cohorts, MakeBuildChild, toBeMade_next);
+	MakeBuildChildren(&cn->cohorts, toBeMade_next);
 
     /*
      * If this node is a .WAIT node with unmade children
@@ -902,21 +943,36 @@ MakeBuildChild(void *v_cn, void *toBeMade_next)
     return cn->type & OP_WAIT && cn->unmade > 0;
 }
 
+/* Schedule the nodes in order, stopping after a .WAIT node that still has
+ * unmade children. */
+static void
+MakeBuildChildren(GNodeVec *gnodes, GNodeListNode *toBeMade_next)
+{
+    unsigned int i;
+
+    for (i = 0; i < gnodes->len; i++)
+	if (MakeBuildChild(GNodeVec_Get(gnodes, i), toBeMade_next) != 0)
+	    break;
+}
+
 /* When a .ORDER LHS node completes we do this on each RHS */
-static int
-MakeBuildParent(void *v_pn, void *toBeMade_next)
+static void
+MakeBuildParents(GNodeVec *order_succ, GNodeListNode *toBeMade_next)
 {
-    GNode *pn = v_pn;
+    unsigned int i;
 
-    if (pn->made != DEFERRED)
-	return 0;
+    for (i = 0; i < order_succ->len; i++) {
+	GNode *pn = GNodeVec_Get(order_succ, i);
 
-    if (MakeBuildChild(pn, toBeMade_next) == 0) {
-	/* Mark so that when this node is built we reschedule its parents */
-	pn->flags |= DONE_ORDER;
-    }
+	if (pn->made != DEFERRED)
+	    continue;
 
-    return 0;
+	if (MakeBuildChild(pn, toBeMade_next) == 0) {
+	    /* Mark so that when this node is built we reschedule its
+	     * parents */
+	    pn->flags |= DONE_ORDER;
+	}
+    }
 }
 
 /* Start as many jobs as possible, taking them from the toBeMade queue.
@@ -960,7 +1016,7 @@ MakeStartJobs(void)
 	     * just before the current first element.
 	     */
 	    gn->made = DEFERRED;
-	    Lst_ForEachUntil(gn->children, MakeBuildChild, Lst_First(toBeMade));
+	    MakeBuildChildren(&gn->children, Lst_First(toBeMade));
 	    /* and drop this node on the floor */
 	    DEBUG2(MAKE, "dropped %s%s\n", gn->name, gn->cohort_num);
 	    continue;
@@ -997,15 +1053,12 @@ MakeStartJobs(void)
     return FALSE;
 }
 
-static int
-MakePrintStatusOrder(void *ognp, void *gnp)
+static void
+MakePrintStatusOrder(GNode *ogn, GNode *gn)
 {
-    GNode *ogn = ognp;
-    GNode *gn = gnp;
-
     if (!(ogn->flags & REMAKE) || ogn->made > REQUESTED)
 	/* not waiting for this one */
-	return 0;
+	return;
 
     printf("    `%s%s' has .ORDER dependency against %s%s ",
 	    gn->name, gn->cohort_num, ogn->name, ogn->cohort_num);
@@ -1016,7 +1069,18 @@ MakePrintStatusOrder(void *ognp, void *gnp)
 		     gn->name, gn->cohort_num, ogn->name, ogn->cohort_num);
 	GNode_FprintDetails(debug_file, "(", ogn, ")\n");
     }
-    return 0;
+}
+
+static int MakePrintStatus(void *, void *);
+
+static void
+MakePrintStatusList(GNodeVec *gnodes, int *errors)
+{
+    unsigned int i;
+
+    for (i = 0; i < gnodes->len; i++)
+	if (MakePrintStatus(GNodeVec_Get(gnodes, i), errors) != 0)
+	    break;
 }
 
 /* Print the status of a top-level node, viz. it being up-to-date already
@@ -1028,6 +1092,7 @@ MakePrintStatus(void *gnp, void *v_errors)
 {
     GNode *gn = (GNode *)gnp;
     int *errors = v_errors;
+    unsigned int i;
 
     if (gn->flags & DONECYCLE)
 	/* We've completely processed this node before, don't do it again. */
@@ -1053,7 +1118,8 @@ MakePrintStatus(void *gnp, void *v_errors)
 		GNode_FprintDetails(debug_file, " (", gn, ")!\n");
 	    }
 	    /* Most likely problem is actually caused by .ORDER */
-	    Lst_ForEachUntil(gn->order_pred, MakePrintStatusOrder, gn);
+	    for (i = 0; i < gn->order_pred.len; i++)
+		MakePrintStatusOrder(GNodeVec_Get(&gn->order_pred, i), gn);
 	    break;
 	default:
 	    /* Errors - already counted */
@@ -1076,7 +1142,7 @@ MakePrintStatus(void *gnp, void *v_errors)
     if (!(gn->flags & CYCLE)) {
 	/* Fist time we've seen this node, check all children */
 	gn->flags |= CYCLE;
-	Lst_ForEachUntil(gn->children, MakePrintStatus, errors);
+	MakePrintStatusList(&gn->children, errors);
 	/* Mark that this node needn't be processed again */
 	gn->flags |= DONECYCLE;
 	return 0;
@@ -1090,11 +1156,125 @@ MakePrintStatus(void *gnp, void *v_errors)
 	return 1;
 
     /* Reporting for our children will give the rest of the loop */
-    Lst_ForEachUntil(gn->children, MakePrintStatus, errors);
+    MakePrintStatusList(&gn->children, errors);
     return 0;
 }
 
 
+/* If .MAKE.DEPENDFILE.TARGET expands to the name of a file for this node,
+ * read the dependencies from that file, the same way as for .dinclude.
+ * Doing this when the node is first examined, rather than including all
+ * the files while parsing the makefile, means that only the files of the
+ * targets that are actually needed are read.
+ *
+ * Each file is read at most once, even if several nodes refer to it. */
+static void
+MakeReadTargetDependfile(GNode *gn, Hash_Table *seen)
+{
+    char *fname;
+    Boolean isNew;
+    int fd;
+
+    if (gn->centurion != NULL)
+	return;			/* the cohorts share the file of the node */
+
+    (void)Var_Subst("${" MAKE_DEPENDFILE_TARGET "}", gn, VARE_WANTRES,
+		    &fname);
+    /* TODO: handle errors */
+    if (fname[0] == '\0') {
+	free(fname);
+	return;
+    }
+
+    (void)Hash_CreateEntry(seen, fname, &isNew);
+    if (!isNew || (fd = open(fname, O_RDONLY)) == -1) {
+	free(fname);
+	return;
+    }
+
+    DEBUG2(MAKE, "Make_ExpandUse: reading %s for %s\n", fname, gn->name);
+    doing_depend = TRUE;
+    Parse_File(fname, fd);
+    doing_depend = FALSE;
+    free(fname);
+}
+
+/* Add the file whose modification time Dir_MTime will look up for the
+ * node, as far as it can be told without looking at the file system.
+ *
+ * The prefetched time is also used by the first recheck of the file.
+ * Make_OODate doesn't recheck the nodes of some types, for these the first
+ * recheck would only happen after they have been made. */
+static void
+MakeAddPrefetch(StringList *files, GNode *gn)
+{
+    char *file;
+
+    if (gn->type & (OP_ARCHV | OP_PHONY |
+		    OP_JOIN | OP_USE | OP_USEBEFORE | OP_EXEC))
+	return;
+    if (gn->path != NULL)
+	file = bmake_strdup(gn->path);
+    else if ((gn->type & OP_NOPATH) || strchr(gn->name, '/') != NULL)
+	file = bmake_strdup(gn->name);
+    else if ((file = Dir_FindFile(gn->name, Suff_FindPath(gn))) == NULL)
+	return;			/* not in any of the cached directories */
+    Lst_Append(files, file);
+}
+
+/* If .MAKE.STAT_PREFETCH is set to a number greater than 1, look up the
+ * modification times of the files of all nodes that can be reached from
+ * the given targets, using that many processes at once.  The following
+ * calls to Dir_MTime, up to and including the one from Make_OODate, then
+ * find them in the cache. */
+static void
+MakePrefetchMTimes(GNodeList *targs)
+{
+    GNodeList *examine;
+    StringList *files;
+    Hash_Table seen;
+    char *nprocs;
+    int n;
+
+    if (!Var_Exists(MAKE_STAT_PREFETCH, VAR_GLOBAL))
+	return;
+    (void)Var_Subst("${" MAKE_STAT_PREFETCH "}", VAR_GLOBAL, VARE_WANTRES,
+		    &nprocs);
+    /* TODO: handle errors */
+    n = atoi(nprocs);
+    free(nprocs);
+    if (n < 2)
+	return;
+
+    examine = Lst_Copy(targs, NULL);
+    files = Lst_Init();
+    Hash_InitTableInterned(&seen);	/* of target names */
+    while (!Lst_IsEmpty(examine)) {
+	GNode *gn = Lst_Dequeue(examine);
+	Boolean isNew;
+	unsigned int i, j;
+
+	/* The cohorts share the name, and thus the file, of the node. */
+	(void)Hash_CreateEntry(&seen, gn->name, &isNew);
+	if (!isNew)
+	    continue;
+
+	MakeAddPrefetch(files, gn);
+	for (i = 0; i < gn->children.len; i++)
+	    Lst_Append(examine, GNodeVec_Get(&gn->children, i));
+	for (j = 0; j < gn->cohorts.len; j++) {
+	    GNode *cohort = GNodeVec_Get(&gn->cohorts, j);
+	    for (i = 0; i < cohort->children.len; i++)
+		Lst_Append(examine, GNodeVec_Get(&cohort->children, i));
+	}
+    }
+    Hash_DeleteTable(&seen);
+    Lst_Free(examine);
+
+    Dir_Prefetch(files, n);
+    Lst_Destroy(files, free);
+}
+
 /* Expand .USE nodes and create a new targets list.
  *
  * Input:
@@ -1104,8 +1284,17 @@ void
 Make_ExpandUse(GNodeList *targs)
 {
     GNodeList *examine;		/* List of targets to examine */
+    Boolean targetDependfile;	/* whether there are per-target
+				 * dependency files to read */
+    Hash_Table dependfiles;	/* the per-target dependency files
+				 * that have been read */
+
+    MakePrefetchMTimes(targs);
 
     examine = Lst_Copy(targs, NULL);
+    targetDependfile = Var_Exists(MAKE_DEPENDFILE_TARGET, VAR_GLOBAL);
+    if (targetDependfile)
+	Hash_InitTable(&dependfiles);
 
     /*
      * Make an initial downward pass over the graph, marking nodes to be made
@@ -1117,6 +1306,7 @@ Make_ExpandUse(GNodeList *targs)
      */
     while (!Lst_IsEmpty(examine)) {
 	GNode *gn = Lst_Dequeue(examine);
+	unsigned int i;
 
 	if (gn->flags & REMAKE)
 	    /* We've looked at this one already */
@@ -1126,7 +1316,7 @@ Make_ExpandUse(GNodeList *targs)
 	       gn->name, gn->cohort_num);
 
 	if (gn->type & OP_DOUBLEDEP)
-	    Lst_PrependAll(examine, gn->cohorts);
+	    MakePrependAll(examine, &gn->cohorts);
 
 	/*
 	 * Apply any .USE rules before looking for implicit dependencies
@@ -1150,6 +1340,8 @@ Make_ExpandUse(GNodeList *targs)
 
 	(void)Dir_MTime(gn, 0);
 	Var_Set(TARGET, gn->path ? gn->path : gn->name, gn);
+	if (targetDependfile)
+	    MakeReadTargetDependfile(gn, &dependfiles);
 	UnmarkChildren(gn);
 	HandleUseNodes(gn);
 
@@ -1157,16 +1349,20 @@ Make_ExpandUse(GNodeList *targs)
 	    Suff_FindDeps(gn);
 	else {
 	    /* Pretend we made all this node's children */
-	    Lst_ForEachUntil(gn->children, MakeFindChild, gn);
+	    for (i = 0; i < gn->children.len; i++)
+		MakeFindChild(GNodeVec_Get(&gn->children, i), gn);
 	    if (gn->unmade != 0)
 		    printf("Warning: %s%s still has %d unmade children\n",
 			    gn->name, gn->cohort_num, gn->unmade);
 	}
 
 	if (gn->unmade != 0)
-	    Lst_ForEachUntil(gn->children, MakeAddChild, examine);
+	    for (i = 0; i < gn->children.len; i++)
+		MakeAddChild(GNodeVec_Get(&gn->children, i), examine);
     }
 
+    if (targetDependfile)
+	Hash_DeleteTable(&dependfiles);
     Lst_Free(examine);
 }
 
@@ -1176,26 +1372,27 @@ link_parent(void *cnp, void *pnp)
     GNode *cn = cnp;
     GNode *pn = pnp;
 
-    Lst_Append(pn->children, cn);
-    Lst_Append(cn->parents, pn);
+    GNodeVec_Append(&pn->children, cn);
+    GNodeVec_Append(&cn->parents, pn);
     pn->unmade++;
 }
 
-/* Make the .WAIT node depend on the previous children */
+/* Make the .WAIT node depend on the previous children, starting at the
+ * given index */
 static void
-add_wait_dependency(GNodeListNode *owln, GNode *wn)
+add_wait_dependency(GNodeVec *children, unsigned int owi, GNode *wn)
 {
-    GNodeListNode *cln;
+    unsigned int i;
     GNode *cn;
 
-    for (cln = owln; (cn = cln->datum) != wn; cln = cln->next) {
+    for (i = owi; (cn = GNodeVec_Get(children, i)) != wn; i++) {
 	DEBUG3(MAKE, ".WAIT: add dependency %s%s -> %s\n",
 	       cn->name, cn->cohort_num, wn->name);
 
 	/* XXX: This pattern should be factored out, it repeats often */
-	Lst_Append(wn->children, cn);
+	GNodeVec_Append(&wn->children, cn);
 	wn->unmade++;
-	Lst_Append(cn->parents, wn);
+	GNodeVec_Append(&cn->parents, wn);
     }
 }
 
@@ -1205,9 +1402,9 @@ Make_ProcessWait(GNodeList *targs)
 {
     GNode  *pgn;		/* 'parent' node we are examining */
     GNode  *cgn;		/* Each child in turn */
-    GNodeListNode *owln;	/* Previous .WAIT node */
+    unsigned int owi;		/* Index of the previous .WAIT node */
     GNodeList *examine;		/* List of targets to examine */
-    GNodeListNode *ln;
+    unsigned int i;
 
     /*
      * We need all the nodes to have a common parent in order for the
@@ -1239,20 +1436,18 @@ Make_ProcessWait(GNodeList *targs)
 	DEBUG1(MAKE, "Make_ProcessWait: examine %s\n", pgn->name);
 
 	if (pgn->type & OP_DOUBLEDEP)
-	    Lst_PrependAll(examine, pgn->cohorts);
+	    MakePrependAll(examine, &pgn->cohorts);
 
-	owln = Lst_First(pgn->children);
-	Lst_Open(pgn->children);
-	for (; (ln = Lst_Next(pgn->children)) != NULL; ) {
-	    cgn = LstNode_Datum(ln);
+	owi = 0;
+	for (i = 0; i < pgn->children.len; i++) {
+	    cgn = GNodeVec_Get(&pgn->children, i);
 	    if (cgn->type & OP_WAIT) {
-		add_wait_dependency(owln, cgn);
-		owln = ln;
+		add_wait_dependency(&pgn->children, owi, cgn);
+		owi = i;
 	    } else {
 		Lst_Append(examine, cgn);
 	    }
 	}
-	Lst_Close(pgn->children);
     }
 
     Lst_Free(examine);
@@ -288,6 +288,7 @@ typedef enum {
     DONE_ORDER	= 0x0010,	/* Build requested by .ORDER processing */
     FROM_DEPEND	= 0x0020,	/* Node created from .depend */
     DONE_ALLSRC	= 0x0040,	/* We do it once only */
+    LAZY_ALLSRC	= 0x0080,	/* ALLSRC and OODATE are set on first use */
     CYCLE	= 0x1000,	/* Used by MakePrintStatus */
     DONECYCLE	= 0x2000,	/* Used by MakePrintStatus */
     INTERNAL	= 0x4000	/* Internal use only */
@@ -301,16 +302,35 @@ typedef struct ListNode GNodeListNode;
 
 typedef struct List /* of CachedDir */ SearchPath;
 
+/* The number of edges that a GNodeVec stores without allocating memory. */
+#define GNODEVEC_INLINE	4
+
+/* The number of local variables that have a fixed slot in each node. */
+#define GNODE_LOCALVARS	7
+
+/* An array of graph nodes, used for the edges between the nodes.
+ *
+ * Most nodes have only a few children and parents, therefore the first
+ * GNODEVEC_INLINE entries are stored in the structure itself.  Only nodes
+ * with more edges allocate a separate array.  The entries are kept in the
+ * order in which they were added. */
+typedef struct GNodeVec {
+    struct GNode **items;	/* Either inl or an allocated array */
+    unsigned int len;		/* Number of entries in items */
+    unsigned int cap;		/* Number of entries that fit in items */
+    struct GNode *inl[GNODEVEC_INLINE];
+} GNodeVec;
+
 /* A graph node represents a target that can possibly be made, including its
  * relation to other targets and a lot of other details. */
 typedef struct GNode {
-    /* The target's name, such as "clean" or "make.c" */
-    char *name;
-    /* The unexpanded name of a .USE node */
-    char *uname;
-    /* The full pathname of the file belonging to the target.
+    /* The target's name, such as "clean" or "make.c", interned */
+    const char *name;
+    /* The unexpanded name of a .USE node, interned */
+    const char *uname;
+    /* The full pathname of the file belonging to the target, interned.
      * XXX: What about .PHONY targets? These don't have an associated path. */
-    char *path;
+    const char *path;
 
     /* The type of operator used to define the sources (see the OP flags below).
      * XXX: This looks like a wild mixture of type and flags. */
@@ -328,25 +348,25 @@ typedef struct GNode {
     /* The GNodes for which this node is an implied source. May be empty.
      * For example, when there is an inference rule for .c.o, the node for
      * file.c has the node for file.o in this list. */
-    GNodeList *implicitParents;
+    GNodeVec implicitParents;
 
     /* Other nodes of the same name for the :: operator. */
-    GNodeList *cohorts;
+    GNodeVec cohorts;
 
     /* The nodes that depend on this one, or in other words, the nodes for
      * which this is a source. */
-    GNodeList *parents;
+    GNodeVec parents;
     /* The nodes on which this one depends. */
-    GNodeList *children;
+    GNodeVec children;
 
     /* .ORDER nodes we need made. The nodes that must be made (if they're
      * made) before this node can be made, but that do not enter into the
      * datedness of this node. */
-    GNodeList *order_pred;
+    GNodeVec order_pred;
     /* .ORDER nodes who need us. The nodes that must be made (if they're made
      * at all) after this node is made, but that do not depend on this node,
      * in the normal sense. */
-    GNodeList *order_succ;
+    GNodeVec order_succ;
 
     /* The "#n" suffix for this cohort, or "" for other nodes */
     char cohort_num[8];
@@ -360,7 +380,9 @@ typedef struct GNode {
     unsigned int checked;
 
     /* The "local" variables that are specific to this target and this target
-     * only, such as $@, $<, $?. */
+     * only, such as $@, $<, $?.  The seven variables from TARGET to MEMBER
+     * are kept in localVars, all others in context. */
+    struct Var *localVars[GNODE_LOCALVARS];
     Hash_Table context;
 
     /* The commands to be given to a shell to create this target. */
@@ -376,6 +398,18 @@ typedef struct GNode {
     int lineno;
 } GNode;
 
+static inline MAKE_ATTR_UNUSED Boolean
+GNodeVec_IsEmpty(const GNodeVec *v) { return v->len == 0; }
+/* Return the node at the given index. */
+static inline MAKE_ATTR_UNUSED GNode *
+GNodeVec_Get(const GNodeVec *v, unsigned int i) { return v->items[i]; }
+/* Return the last node, or NULL if the array is empty. */
+static inline MAKE_ATTR_UNUSED GNode *
+GNodeVec_Last(const GNodeVec *v)
+{
+    return v->len > 0 ? v->items[v->len - 1] : NULL;
+}
+
 /*
  * Error levels for parsing. PARSE_FATAL means the process cannot continue
  * once the makefile has been parsed. PARSE_WARNING means it can. Passed
@@ -493,7 +527,12 @@ extern pid_t	myPid;
 #define	MAKE_LEVEL	".MAKE.LEVEL"	   /* recursion level */
 #define MAKEFILE_PREFERENCE ".MAKE.MAKEFILE_PREFERENCE"
 #define MAKE_DEPENDFILE	".MAKE.DEPENDFILE" /* .depend */
+#define MAKE_DEPENDFILE_TARGET ".MAKE.DEPENDFILE.TARGET" /* ${.TARGET:R}.d */
 #define MAKE_MODE	".MAKE.MODE"
+#define MAKE_SHELL_CACHE ".MAKE.SHELL_CACHE" /* cache for != and :sh */
+#define MAKE_SHELL_CACHE_ENV ".MAKE.SHELL_CACHE.ENV"
+#define MAKE_SHELL_CACHE_FILES ".MAKE.SHELL_CACHE.FILES"
+#define MAKE_STAT_PREFETCH ".MAKE.STAT_PREFETCH" /* processes for stat(2) */
 #ifndef MAKE_LEVEL_ENV
 # define MAKE_LEVEL_ENV	"MAKELEVEL"
 #endif
@@ -568,6 +607,7 @@ time_t Make_Recheck(GNode *);
 void Make_HandleUse(GNode *, GNode *);
 void Make_Update(GNode *);
 void Make_DoAllVar(GNode *);
+void Make_ForceAllVar(GNode *);
 Boolean Make_Run(GNodeList *);
 int dieQuietly(GNode *, int);
 void PrintOnError(GNode *, const char *);
@@ -92,3 +92,230 @@ bmake_strsedup(const char *start, const char *end)
 {
 	return bmake_strldup(start, (size_t)(end - start));
 }
+
+/*
+ * Pools for small objects, such as list nodes and hash table entries.
+ *
+ * The objects are grouped into size classes of POOL_GRAIN bytes.  Each
+ * size class carves its objects from slabs of POOL_SLABSIZE bytes and
+ * keeps the freed objects in a free list for reuse, which avoids the
+ * overhead that malloc has for each of these tiny objects.  Slabs are
+ * never given back.
+ */
+#define POOL_GRAIN	8
+#define POOL_MAXSIZE	64
+#define POOL_SLABSIZE	(64 * 1024)
+
+typedef struct PoolFree {
+	struct PoolFree *next;
+} PoolFree;
+
+typedef struct PoolSlab {
+	struct PoolSlab *next;	/* Keeps the slabs reachable. */
+} PoolSlab;
+
+typedef struct Pool {
+	PoolFree *freeList;	/* Objects that have been freed */
+	char *slabNext;		/* Unused part of the current slab */
+	char *slabEnd;
+	PoolSlab *slabs;
+
+	/* Statistics, for bmake_pool_stats. */
+	unsigned int numSlabs;
+	unsigned long allocs;
+	size_t inUse;
+	size_t peak;
+} Pool;
+
+static Pool pools[POOL_MAXSIZE / POOL_GRAIN];
+
+static void *
+PoolAllocSlow(Pool *pool, size_t objSize)
+{
+	PoolSlab *slab;
+
+	/* The slab header takes up a whole object, for alignment. */
+	slab = bmake_malloc(POOL_SLABSIZE);
+	slab->next = pool->slabs;
+	pool->slabs = slab;
+	pool->numSlabs++;
+	pool->slabNext = (char *)slab + objSize;
+	pool->slabEnd = (char *)slab + POOL_SLABSIZE / objSize * objSize;
+
+	pool->slabNext += objSize;
+	return pool->slabNext - objSize;
+}
+
+/* Allocate a small object.  It must be freed with bmake_pool_free, passing
+ * the same size. */
+void *
+bmake_pool_alloc(size_t size)
+{
+	size_t objSize;
+	Pool *pool;
+	void *p;
+
+	if (size > POOL_MAXSIZE || size == 0)
+		return bmake_malloc(size);
+
+	objSize = (size + POOL_GRAIN - 1) & ~(size_t)(POOL_GRAIN - 1);
+	pool = &pools[objSize / POOL_GRAIN - 1];
+	if (pool->freeList != NULL) {
+		p = pool->freeList;
+		pool->freeList = pool->freeList->next;
+	} else if (pool->slabNext < pool->slabEnd) {
+		p = pool->slabNext;
+		pool->slabNext += objSize;
+	} else
+		p = PoolAllocSlow(pool, objSize);
+
+	pool->allocs++;
+	if (++pool->inUse > pool->peak)
+		pool->peak = pool->inUse;
+	return p;
+}
+
+/* Give an object from bmake_pool_alloc back to its pool. */
+void
+bmake_pool_free(void *p, size_t size)
+{
+	PoolFree *obj = p;
+	Pool *pool;
+
+	if (p == NULL)
+		return;
+	if (size > POOL_MAXSIZE || size == 0) {
+		free(p);
+		return;
+	}
+
+	pool = &pools[(size + POOL_GRAIN - 1) / POOL_GRAIN - 1];
+	obj->next = pool->freeList;
+	pool->freeList = obj;
+	pool->inUse--;
+}
+
+/*
+ * An arena for objects that live until make exits, such as the graph nodes,
+ * the commands from the makefiles, the archive members and the interned
+ * strings.  Allocating from the arena merely advances a pointer, and the
+ * objects are never freed individually.  When compiled with CLEANUP,
+ * bmake_arena_free releases the whole arena at the end, so that the leak
+ * checkers see a full teardown.
+ */
+#define ARENA_CHUNKSIZE	(64 * 1024)
+#define ARENA_ALIGN	8
+
+typedef struct ArenaChunk {
+	struct ArenaChunk *next;
+	size_t used;
+	size_t size;
+} ArenaChunk;
+
+#define ARENA_HEADERSIZE \
+	((sizeof(ArenaChunk) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+static ArenaChunk *arena;		/* The chunk to allocate from */
+static unsigned int arenaChunks;
+static unsigned long arenaBytes;	/* Bytes handed out */
+
+static char *
+ArenaAlloc(size_t size, size_t align)
+{
+	ArenaChunk *chunk = arena;
+	size_t start;
+
+	if (chunk != NULL) {
+		start = (chunk->used + align - 1) & ~(align - 1);
+		if (start + size <= chunk->size)
+			goto found;
+	}
+
+	if (size > ARENA_CHUNKSIZE / 4) {
+		/* Don't waste the rest of the current chunk. */
+		chunk = bmake_malloc(ARENA_HEADERSIZE + size);
+		chunk->size = chunk->used = ARENA_HEADERSIZE + size;
+		if (arena != NULL) {
+			chunk->next = arena->next;
+			arena->next = chunk;
+		} else {
+			chunk->next = NULL;
+			arena = chunk;
+		}
+		arenaChunks++;
+		arenaBytes += size;
+		return (char *)chunk + ARENA_HEADERSIZE;
+	}
+
+	chunk = bmake_malloc(ARENA_CHUNKSIZE);
+	chunk->next = arena;
+	chunk->size = ARENA_CHUNKSIZE;
+	arena = chunk;
+	arenaChunks++;
+	start = ARENA_HEADERSIZE;
+
+found:
+	chunk->used = start + size;
+	arenaBytes += size;
+	return (char *)chunk + start;
+}
+
+/* Allocate memory that is never freed. */
+void *
+bmake_arena_alloc(size_t size)
+{
+	return ArenaAlloc(size, ARENA_ALIGN);
+}
+
+/* Copy the first len characters of the string to the arena. */
+char *
+bmake_arena_strldup(const char *str, size_t len)
+{
+	char *p = ArenaAlloc(len + 1, 1);
+	memcpy(p, str, len);
+	p[len] = '\0';
+	return p;
+}
+
+char *
+bmake_arena_strdup(const char *str)
+{
+	return bmake_arena_strldup(str, strlen(str));
+}
+
+#ifdef CLEANUP
+/* Free all memory of the arena.  Must be the last thing before exit. */
+void
+bmake_arena_free(void)
+{
+	ArenaChunk *chunk, *next;
+
+	for (chunk = arena; chunk != NULL; chunk = next) {
+		next = chunk->next;
+		free(chunk);
+	}
+	arena = NULL;
+}
+#endif
+
+/* Print the usage of the pools and the arena. */
+void
+bmake_pool_stats(void)
+{
+	size_t i;
+
+	if (!DEBUG(HASH))
+		return;
+	debug_printf("arena: %lu bytes in %u chunks\n",
+	    arenaBytes, arenaChunks);
+	for (i = 0; i < sizeof pools / sizeof pools[0]; i++) {
+		const Pool *pool = &pools[i];
+		if (pool->allocs == 0)
+			continue;
+		debug_printf("pool %2u bytes: %lu allocs, %lu in use, "
+		    "%lu peak, %u slabs\n",
+		    (unsigned)((i + 1) * POOL_GRAIN), pool->allocs,
+		    (unsigned long)pool->inUse, (unsigned long)pool->peak,
+		    pool->numSlabs);
+	}
+}
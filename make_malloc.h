@@ -39,6 +39,15 @@ char *bmake_strldup(const char *, size_t);
 #define bmake_strldup(x,y)      estrndup(x,y)
 #endif
 char *bmake_strsedup(const char *, const char *);
+void *bmake_pool_alloc(size_t);
+void bmake_pool_free(void *, size_t);
+void bmake_pool_stats(void);
+void *bmake_arena_alloc(size_t);
+char *bmake_arena_strdup(const char *);
+char *bmake_arena_strldup(const char *, size_t);
+#ifdef CLEANUP
+void bmake_arena_free(void);
+#endif
 
 /* Thin wrapper around free(3) to avoid the extra function call in case
  * p is NULL, which on x86_64 costs about 12 machine instructions.
@@ -94,11 +94,13 @@ CondEvalResult Cond_EvalCondition(const char *, Boolean *);
 CondEvalResult Cond_EvalLine(const char *);
 void Cond_restore_depth(unsigned int);
 unsigned int Cond_save_depth(void);
+unsigned int Cond_Depth(void);
 
 /* for.c */
 int For_Eval(const char *);
 Boolean For_Accum(const char *);
 void For_Run(int);
+Boolean For_HasValue(void *, size_t, size_t);
 
 /* job.c */
 #ifdef WAIT_T
@@ -148,8 +150,24 @@ void Parse_File(const char *, int);
 void Parse_Init(void);
 void Parse_End(void);
 void Parse_SetInput(const char *, int, int, char *(*)(void *, size_t *), void *);
+void Parse_ReplayLine(const char *, int, const char *);
+void Parse_ReplayFinish(void);
+Boolean Parse_LineHasForValue(void);
 GNodeList *Parse_MainName(void);
 
+/* snapshot.c */
+Boolean Snapshot_Load(StringList *);
+void Snapshot_Save(void);
+Boolean Snapshot_Recording(void);
+void Snapshot_Abandon(void);
+void Snapshot_Var(GNode *, const char *, const char *);
+void Snapshot_Env(const char *, const char *);
+void Snapshot_File(const char *);
+void Snapshot_Search(const char *, SearchPath *);
+void Snapshot_BeginLine(const char *, int, const char *);
+void Snapshot_EndLine(void);
+void Snapshot_FinishGroup(void);
+
 /* str.c */
 typedef struct Words {
     char **words;
@@ -198,6 +216,8 @@ void Targ_Stats(void);
 GNodeList *Targ_List(void);
 GNode *Targ_NewGN(const char *);
 GNode *Targ_FindNode(const char *);
+GNode *Targ_FindNodeKey(const Hash_Key *);
+void Targ_SetPath(GNode *, char *);
 GNode *Targ_GetNode(const char *);
 GNode *Targ_NewInternalNode(const char *);
 GNode *Targ_GetEndNode(void);
@@ -213,6 +233,13 @@ char *Targ_FmtTime(time_t);
 void Targ_PrintType(int);
 void Targ_PrintGraph(int);
 void Targ_Propagate(void);
+void GNodeVec_Init(GNodeVec *);
+void GNodeVec_Done(GNodeVec *);
+void GNodeVec_Append(GNodeVec *, GNode *);
+void GNodeVec_Insert(GNodeVec *, unsigned int, GNode *);
+void GNodeVec_Remove(GNodeVec *, unsigned int);
+void GNodeVec_RemoveNode(GNodeVec *, const GNode *);
+int GNodeVec_IndexOf(const GNodeVec *, const GNode *);
 
 /* var.c */
 
@@ -302,7 +329,9 @@ void Var_Init(void);
 void Var_End(void);
 void Var_Stats(void);
 void Var_Dump(GNode *);
-void Var_ExportVars(void);
+void Var_AppendState(Buffer *, GNode *);
+char **Var_ExportVars(void);
+void Var_Setenv(const char *, const char *);
 void Var_Export(const char *, Boolean);
 void Var_UnExport(const char *);
 
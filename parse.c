@@ -125,9 +125,6 @@
 #ifdef HAVE_MMAP
 #include <sys/mman.h>
 
-#ifndef MAP_COPY
-#define MAP_COPY MAP_PRIVATE
-#endif
 #ifndef MAP_FILE
 #define MAP_FILE 0
 #endif
@@ -137,17 +134,36 @@
 #include "job.h"
 #include "pathnames.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 /*	"@(#)parse.c	8.3 (Berkeley) 3/19/94"	*/
 MAKE_RCSID("$NetBSD: parse.c,v 1.370 2020/10/05 22:15:45 rillig Exp $");
 
 /* types and constants */
 
+/*
+ * Whether a file protects itself against multiple inclusion, by wrapping
+ * its whole content in a single conditional such as ".ifndef GUARD" or
+ * ".if !target(__guard__)".
+ */
+typedef enum GuardState {
+    GUARD_START,		/* no line has been read yet */
+    GUARD_INSIDE,		/* the first line is a guard conditional */
+    GUARD_NONE			/* the file is not guarded */
+} GuardState;
+
 /*
  * Structure for a file being read ("included file")
  */
 typedef struct IFile {
     char *fname;		/* name of file */
     Boolean fromForLoop;	/* simulated .include by the .for loop */
+    Boolean forValue;		/* the current line contains a value from
+				 * the .for loop, see For_HasValue */
     int lineno;			/* current line number in file */
     int first_lineno;		/* line number of start of text */
     unsigned int cond_depth;	/* 'if' nesting when file opened */
@@ -158,6 +174,9 @@ typedef struct IFile {
     char *(*nextbuf)(void *, size_t *); /* Function to get more data */
     void *nextbuf_arg;		/* Opaque arg for nextbuf() */
     struct loadedfile *lf;	/* loadedfile object, if any */
+    GuardState guardState;	/* see ParseGuard_Line */
+    unsigned int guardDepth;	/* .if nesting outside the guard */
+    char *guardCond;		/* the condition of the guard, or NULL */
 } IFile;
 
 
@@ -230,11 +249,6 @@ static GNode *mainNode;
  * See unit-tests/deptgt.mk, keyword "parse.c:targets". */
 static GNodeList *targets;
 
-#ifdef CLEANUP
-/* command lines for targets */
-static StringList *targCmds;
-#endif
-
 /*
  * Predecessor node for handling .ORDER. Initialized to NULL when .ORDER
  * seen, then set to each successive source on the line.
@@ -295,6 +309,17 @@ static IFile *curFile;
  */
 static Stack /* of *IFile */ includes;
 
+/* The files that are protected against multiple inclusion, mapping the
+ * full path to the condition of the guard.  When the condition evaluates
+ * to false, including the file again has no effect, therefore the file is
+ * not even opened. */
+static Hash_Table guardedFiles;
+
+/* The current line, as returned by ParseGetLine.  The input buffers are
+ * never modified, since they may be read-only mappings of the files;
+ * instead each line is copied here, where the parser may scribble on it. */
+static Buffer curLine;
+
 /* include paths (lists of directories) */
 SearchPath *parseIncPath;	/* dirs for "..." includes */
 SearchPath *sysIncPath;		/* dirs for <...> includes */
@@ -508,13 +533,21 @@ loadfile(const char *path, int fd)
 		}
 
 		/*
-		 * FUTURE: remove PROT_WRITE when the parser no longer
-		 * needs to scribble on the input.
+		 * The parser copies each line before modifying it, so
+		 * the file can be mapped read-only and shared.  The
+		 * pages then stay in the page cache for all the makes
+		 * that read the same file, without private copies.
 		 */
-		lf->buf = mmap(NULL, lf->maplen, PROT_READ|PROT_WRITE,
-			       MAP_FILE|MAP_COPY, fd, 0);
+		lf->buf = mmap(NULL, lf->maplen, PROT_READ,
+			       MAP_FILE|MAP_SHARED, fd, 0);
 		if (lf->buf != MAP_FAILED) {
 			/* succeeded */
+#ifdef MADV_SEQUENTIAL
+			(void)madvise(lf->buf, lf->maplen, MADV_SEQUENTIAL);
+#endif
+#ifdef MADV_WILLNEED
+			(void)madvise(lf->buf, lf->maplen, MADV_WILLNEED);
+#endif
 			if (lf->len == lf->maplen && lf->buf[lf->len - 1] != '\n') {
 				char *b = bmake_malloc(lf->len + 1);
 				b[lf->len] = '\n';
@@ -683,6 +716,7 @@ ParseVErrorInternal(FILE *f, const char *cfname, size_t clineno, int type,
 
 	if (type == PARSE_INFO)
 		return;
+	Snapshot_Abandon();
 	if (type == PARSE_FATAL || parseWarnFatal)
 		fatals++;
 	if (parseWarnFatal && !fatal_warning_error_printed) {
@@ -806,14 +840,14 @@ ParseLinkSrc(void *pgnp, void *data)
     GNode *pgn = pgnp;
     GNode *cgn = args->cgn;
 
-    if ((pgn->type & OP_DOUBLEDEP) && !Lst_IsEmpty(pgn->cohorts))
-	pgn = LstNode_Datum(Lst_Last(pgn->cohorts));
+    if ((pgn->type & OP_DOUBLEDEP) && !GNodeVec_IsEmpty(&pgn->cohorts))
+	pgn = GNodeVec_Last(&pgn->cohorts);
 
-    Lst_Append(pgn->children, cgn);
+    GNodeVec_Append(&pgn->children, cgn);
     pgn->unmade++;
 
     if (args->specType == Not)
-	Lst_Append(cgn->parents, pgn);
+	GNodeVec_Append(&cgn->parents, pgn);
 
     if (DEBUG(PARSE)) {
 	debug_printf("# %s: added child %s - %s\n",
@@ -866,7 +900,7 @@ TryApplyDependencyOperator(GNode *gn, GNodeType op)
 	 * traversals will no longer see this node anyway. -mycroft)
 	 */
 	cohort->type = op | OP_INVISIBLE;
-	Lst_Append(gn->cohorts, cohort);
+	GNodeVec_Append(&gn->cohorts, cohort);
 	cohort->centurion = gn;
 	gn->unmade_cohorts++;
 	snprintf(cohort->cohort_num, sizeof cohort->cohort_num, "#%d",
@@ -963,8 +997,8 @@ ParseDoSrcOrder(const char *src)
     if (doing_depend)
 	ParseMark(gn);
     if (predecessor != NULL) {
-	Lst_Append(predecessor->order_succ, gn);
-	Lst_Append(gn->order_pred, predecessor);
+	GNodeVec_Append(&predecessor->order_succ, gn);
+	GNodeVec_Append(&gn->order_pred, predecessor);
 	if (DEBUG(PARSE)) {
 	    debug_printf("# %s: added Order dependency %s - %s\n",
 			 __func__, predecessor->name, gn->name);
@@ -2108,8 +2142,8 @@ static void
 ParseAddCmd(GNode *gn, char *cmd)
 {
     /* Add to last (ie current) cohort for :: targets */
-    if ((gn->type & OP_DOUBLEDEP) && gn->cohorts->last != NULL)
-	gn = gn->cohorts->last->datum;
+    if ((gn->type & OP_DOUBLEDEP) && !GNodeVec_IsEmpty(&gn->cohorts))
+	gn = GNodeVec_Last(&gn->cohorts);
 
     /* if target already supplied, ignore commands */
     if (!(gn->type & OP_HAS_COMMANDS)) {
@@ -2156,6 +2190,141 @@ Parse_AddIncludeDir(const char *dir)
     (void)Dir_AddDir(parseIncPath, dir);
 }
 
+/* Skip the name of a guard.  The only variables that may appear in the
+ * name are those that only depend on the file, such as in the typical
+ * ".if !target(__${.PARSEFILE}__)". */
+static Boolean
+ParseGuard_SkipName(const char **pp)
+{
+    const char *p = *pp;
+
+    while (*p != '\0' && !ch_isspace(*p) && *p != '(' && *p != ')') {
+	if (*p != '$')
+	    p++;
+	else if (strncmp(p, "${.PARSEFILE}", 13) == 0)
+	    p += 13;
+	else if (strncmp(p, "${.PARSEDIR}", 12) == 0)
+	    p += 12;
+	else
+	    return FALSE;
+    }
+    *pp = p;
+    return TRUE;
+}
+
+/* If the line is a conditional of the form ".ifndef NAME",
+ * ".if !defined(NAME)" or ".if !target(NAME)", return the condition that
+ * is equivalent to it, with the variables in NAME expanded, otherwise
+ * NULL. */
+static char *
+ParseGuard_Cond(const char *line)
+{
+    const char *p = line + 1;
+    const char *func, *name, *nameEnd;	/* func includes "!" and "(" */
+
+    cpp_skip_whitespace(&p);
+    if (strncmp(p, "ifndef", 6) == 0 && ch_isspace(p[6])) {
+	p += 6;
+	func = "!defined(";
+	cpp_skip_whitespace(&p);
+	name = p;
+	if (!ParseGuard_SkipName(&p))
+	    return NULL;
+	nameEnd = p;
+    } else if (strncmp(p, "if", 2) == 0 && ch_isspace(p[2])) {
+	p += 2;
+	cpp_skip_whitespace(&p);
+	if (*p++ != '!')
+	    return NULL;
+	cpp_skip_whitespace(&p);
+	if (strncmp(p, "defined(", 8) == 0) {
+	    func = "!defined(";
+	    p += 8;
+	} else if (strncmp(p, "target(", 7) == 0) {
+	    func = "!target(";
+	    p += 7;
+	} else
+	    return NULL;
+	name = p;
+	if (!ParseGuard_SkipName(&p))
+	    return NULL;
+	nameEnd = p;
+	if (*p++ != ')')
+	    return NULL;
+    } else
+	return NULL;
+
+    cpp_skip_whitespace(&p);
+    if (*p != '\0' || nameEnd == name)
+	return NULL;
+    {
+	char *nameStr = bmake_strsedup(name, nameEnd);
+	char *cond = str_concat3(func, nameStr, ")");
+	free(nameStr);
+	if (strchr(cond, '$') != NULL) {
+	    char *expanded;
+	    (void)Var_Subst(cond, VAR_CMD, VARE_WANTRES, &expanded);
+	    /* TODO: handle errors */
+	    free(cond);
+	    cond = expanded;
+	}
+	return cond;
+    }
+}
+
+/* Track whether the current file protects itself against multiple
+ * inclusion, which requires that the guard conditional is the first line
+ * of the file, that it has no .else or .elif branch, and that nothing but
+ * comments follows the closing .endif. */
+static void
+ParseGuard_Line(const char *line)
+{
+    IFile *cf = curFile;
+    unsigned int depth = Cond_Depth();
+
+    if (cf->guardState == GUARD_START) {
+	cf->guardCond = line[0] == '.' ? ParseGuard_Cond(line) : NULL;
+	cf->guardState = cf->guardCond != NULL ? GUARD_INSIDE : GUARD_NONE;
+	cf->guardDepth = depth;
+	return;
+    }
+
+    if (depth == cf->guardDepth) {
+	/* There is content after the guard. */
+	cf->guardState = GUARD_NONE;
+    } else if (depth == cf->guardDepth + 1 && line[0] == '.') {
+	const char *p = line + 1;
+	cpp_skip_whitespace(&p);
+	if (p[0] == 'e' && p[1] == 'l')
+	    cf->guardState = GUARD_NONE;	/* .else or .elif */
+    }
+    if (cf->guardState == GUARD_NONE) {
+	free(cf->guardCond);
+	cf->guardCond = NULL;
+    }
+}
+
+/* See if the file has been read before and is protected against multiple
+ * inclusion by a guard that prevents it from having any effect now. */
+static Boolean
+ParseGuard_Holds(const char *fullname)
+{
+    const char *cond = Hash_FindValue(&guardedFiles, fullname);
+    Boolean value;
+
+    return cond != NULL &&
+	   Cond_EvalCondition(cond, &value) == COND_PARSE && !value;
+}
+
+/* Like Dir_FindFile, telling the snapshot of the system makefile where the
+ * file may be, so that it is not replayed when the file appears there. */
+static char *
+ParseFindFile(const char *file, SearchPath *path)
+{
+    Snapshot_Search(file, path);
+    return Dir_FindFile(file, path);
+}
+
 /* Push to another file.
  *
  * The input is the line minus the '.'. A file spec is a string enclosed in
@@ -2178,7 +2347,11 @@ Parse_include_file(char *file, Boolean isSystem, Boolean depinc, int silent)
      * find the durn thing. A return of NULL indicates the file don't
      * exist.
      */
-    fullname = file[0] == '/' ? bmake_strdup(file) : NULL;
+    fullname = NULL;
+    if (file[0] == '/') {
+	Snapshot_Search(file, NULL);
+	fullname = bmake_strdup(file);
+    }
 
     if (fullname == NULL && !isSystem) {
 	/*
@@ -2201,9 +2374,9 @@ Parse_include_file(char *file, Boolean isSystem, Boolean depinc, int silent)
 		*prefEnd = '\0';
 	    }
 	    newName = str_concat3(incdir, "/", file + i);
-	    fullname = Dir_FindFile(newName, parseIncPath);
+	    fullname = ParseFindFile(newName, parseIncPath);
 	    if (fullname == NULL)
-		fullname = Dir_FindFile(newName, dirSearchPath);
+		fullname = ParseFindFile(newName, dirSearchPath);
 	    free(newName);
 	}
 	free(incdir);
@@ -2221,13 +2394,13 @@ Parse_include_file(char *file, Boolean isSystem, Boolean depinc, int silent)
 	    if ((suff = strrchr(file, '.'))) {
 		suffPath = Suff_GetPath(suff);
 		if (suffPath != NULL) {
-		    fullname = Dir_FindFile(file, suffPath);
+		    fullname = ParseFindFile(file, suffPath);
 		}
 	    }
 	    if (fullname == NULL) {
-		fullname = Dir_FindFile(file, parseIncPath);
+		fullname = ParseFindFile(file, parseIncPath);
 		if (fullname == NULL) {
-		    fullname = Dir_FindFile(file, dirSearchPath);
+		    fullname = ParseFindFile(file, dirSearchPath);
 		}
 	    }
 	}
@@ -2238,7 +2411,7 @@ Parse_include_file(char *file, Boolean isSystem, Boolean depinc, int silent)
 	/*
 	 * Look for it on the system path
 	 */
-	fullname = Dir_FindFile(file,
+	fullname = ParseFindFile(file,
 		    Lst_IsEmpty(sysIncPath) ? defIncPath : sysIncPath);
     }
 
@@ -2248,6 +2421,12 @@ Parse_include_file(char *file, Boolean isSystem, Boolean depinc, int silent)
 	return;
     }
 
+    if (ParseGuard_Holds(fullname)) {
+	DEBUG1(PARSE, "Skipping guarded file %s\n", fullname);
+	free(fullname);
+	return;
+    }
+
     /* Actually open the file... */
     fd = open(fullname, O_RDONLY);
     if (fd == -1) {
@@ -2364,6 +2543,14 @@ GetActuallyIncludingFile(void)
     return NULL;
 }
 
+/* Whether the current line contains a value that was substituted by the
+ * .for loop whose body is being read. */
+Boolean
+Parse_LineHasForValue(void)
+{
+    return curFile != NULL && curFile->forValue;
+}
+
 /* Set .PARSEDIR, .PARSEFILE, .INCLUDEDFROMDIR and .INCLUDEDFROMFILE. */
 static void
 ParseSetParseFile(const char *filename)
@@ -2405,6 +2592,7 @@ ParseTrackInput(const char *name)
 	}
     }
     Var_Append (MAKE_MAKEFILES, name, VAR_GLOBAL);
+    Snapshot_File(name);
  cleanup:
     bmake_free(fp);
 }
@@ -2451,12 +2639,15 @@ Parse_SetInput(const char *name, int line, int fd,
      */
     curFile->fname = bmake_strdup(name);
     curFile->fromForLoop = fromForLoop;
+    curFile->forValue = FALSE;
     curFile->lineno = line;
     curFile->first_lineno = line;
     curFile->nextbuf = nextbuf;
     curFile->nextbuf_arg = arg;
     curFile->lf = NULL;
     curFile->depending = doing_depend;	/* restore this on EOF */
+    curFile->guardState = fromForLoop ? GUARD_NONE : GUARD_START;
+    curFile->guardCond = NULL;
 
     assert(nextbuf != NULL);
 
@@ -2588,7 +2779,7 @@ ParseGmakeExport(char *line)
     (void)Var_Subst(value, VAR_CMD, VARE_WANTRES, &value);
     /* TODO: handle errors */
 
-    setenv(variable, value, 1);
+    Var_Setenv(variable, value);
     free(value);
 }
 #endif
@@ -2620,6 +2811,16 @@ ParseEOF(void)
 	return CONTINUE;
     }
 
+    if (curFile->guardState == GUARD_INSIDE &&
+	Cond_Depth() == curFile->guardDepth) {
+	Hash_Entry *he = Hash_CreateEntry(&guardedFiles, curFile->fname, NULL);
+	DEBUG2(PARSE, "ParseEOF: %s is guarded by %s\n",
+	       curFile->fname, curFile->guardCond);
+	free(Hash_GetValue(he));
+	Hash_SetValue(he, curFile->guardCond);
+    } else
+	free(curFile->guardCond);
+
     /* Ensure the makefile (or loop) didn't have mismatched conditionals */
     Cond_restore_depth(curFile->cond_depth);
 
@@ -2654,6 +2855,72 @@ ParseEOF(void)
 #define PARSE_RAW 1
 #define PARSE_SKIP 2
 
+#define ParseLine_IsSpecial(ch) \
+	((ch) == '\n' || (ch) == '\\' || (ch) == '#' || (ch) == '\0')
+
+/*
+ * Skip the run of ordinary characters starting at p, returning a pointer
+ * to the first newline, backslash, '#' or zero byte, or to end if there
+ * is none.  A NULL end means the data is terminated by a zero byte.
+ *
+ * Most of a makefile is ordinary characters, so look at a whole block of
+ * them at a time where the machine allows it.  The vector loop only reads
+ * complete blocks below end, never past the buffer.
+ */
+static char *
+ParseLine_SkipPlain(char *p, const char *end)
+{
+    if (end == NULL)
+	return p + strcspn(p, "\n\\#");
+
+#if defined(__SSE2__)
+    {
+	const __m128i nl = _mm_set1_epi8('\n');
+	const __m128i bs = _mm_set1_epi8('\\');
+	const __m128i hash = _mm_set1_epi8('#');
+	const __m128i zero = _mm_setzero_si128();
+
+	while (end - p >= 16) {
+	    __m128i v = _mm_loadu_si128((const __m128i *)(const void *)p);
+	    __m128i m = _mm_or_si128(
+		_mm_or_si128(_mm_cmpeq_epi8(v, nl), _mm_cmpeq_epi8(v, bs)),
+		_mm_or_si128(_mm_cmpeq_epi8(v, hash), _mm_cmpeq_epi8(v, zero)));
+	    unsigned int mask = (unsigned int)_mm_movemask_epi8(m);
+
+	    if (mask != 0) {
+#if MAKE_GNUC_PREREQ(3, 4)
+		return p + __builtin_ctz(mask);
+#else
+		break;
+#endif
+	    }
+	    p += 16;
+	}
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    {
+	const uint8x16_t nl = vdupq_n_u8('\n');
+	const uint8x16_t bs = vdupq_n_u8('\\');
+	const uint8x16_t hash = vdupq_n_u8('#');
+
+	while (end - p >= 16) {
+	    uint8x16_t v = vld1q_u8((const uint8_t *)p);
+	    uint8x16_t m = vorrq_u8(
+		vorrq_u8(vceqq_u8(v, nl), vceqq_u8(v, bs)),
+		vorrq_u8(vceqq_u8(v, hash), vceqzq_u8(v)));
+
+	    if (vmaxvq_u8(m) != 0)
+		break;		/* the scalar loop finds it in this block */
+	    p += 16;
+	}
+    }
+#endif
+
+    while (p < end && !ParseLine_IsSpecial(*p))
+	p++;
+    return p;
+}
+
 static char *
 ParseGetLine(int flags)
 {
@@ -2675,6 +2942,16 @@ ParseGetLine(int flags)
 	escaped = NULL;
 	comment = NULL;
 	for (;;) {
+	    tp = ParseLine_SkipPlain(ptr, cf->P_end);
+	    if (tp != ptr) {
+		/* We are not interested in trailing whitespace */
+		char *nonspace = tp;
+		while (nonspace > ptr && ch_isspace(nonspace[-1]))
+		    nonspace--;
+		if (nonspace > ptr)
+		    line_end = nonspace;
+		ptr = tp;
+	    }
 	    if (cf->P_end != NULL && ptr == cf->P_end) {
 		/* end of buffer */
 		ch = 0;
@@ -2742,20 +3019,32 @@ ParseGetLine(int flags)
 	    continue;
 	}
 
-	/* We now have a line of data */
-	*line_end = 0;
-
-	if (flags & PARSE_RAW) {
-	    /* Leave '\' (etc) in line buffer (eg 'for' lines) */
-	    return line;
-	}
-
-	if (flags & PARSE_SKIP) {
+	if ((flags & (PARSE_RAW | PARSE_SKIP)) == PARSE_SKIP) {
 	    /* Completely ignore non-directives */
 	    if (line[0] != '.')
 		continue;
 	    /* We could do more of the .else/.elif/.endif checks here */
 	}
+
+	if (cf->fromForLoop)
+	    cf->forValue = For_HasValue(cf->nextbuf_arg,
+					(size_t)(line - cf->P_str),
+					(size_t)(ptr - cf->P_str));
+
+	/* We now have a line of data; copy it so that it can be modified */
+	Buf_Empty(&curLine);
+	Buf_AddBytesBetween(&curLine, line, line_end);
+	tp = Buf_GetAll(&curLine, NULL);
+	if (comment != NULL)
+	    comment = tp + (comment - line);
+	if (escaped != NULL)
+	    escaped = tp + (escaped - line);
+	line = tp;
+
+	if (flags & PARSE_RAW) {
+	    /* Leave '\' (etc) in line buffer (eg 'for' lines) */
+	    return line;
+	}
 	break;
     }
 
@@ -2773,12 +3062,14 @@ ParseGetLine(int flags)
     tp = ptr = escaped;
     escaped = line;
     for (; ; *tp++ = ch) {
-	ch = *ptr++;
-	if (ch != '\\') {
-	    if (ch == 0)
-		break;
-	    continue;
-	}
+	/* Move the run of characters up to the next '\\' in one go */
+	size_t len = strcspn(ptr, "\\");
+	if (tp != ptr)
+	    memmove(tp, ptr, len);
+	tp += len;
+	ptr += len;
+	if (*ptr++ == 0)
+	    break;
 
 	ch = *ptr++;
 	if (ch == 0) {
@@ -2833,6 +3124,9 @@ ParseReadLine(void)
 	if (line == NULL)
 	    return NULL;
 
+	if (curFile->guardState != GUARD_NONE)
+	    ParseGuard_Line(line);
+
 	if (line[0] != '.')
 	    return line;
 
@@ -2845,6 +3139,8 @@ ParseReadLine(void)
 	    /* Skip to next conditional that evaluates to COND_PARSE.  */
 	    do {
 		line = ParseGetLine(PARSE_SKIP);
+		if (line != NULL && curFile->guardState != GUARD_NONE)
+		    ParseGuard_Line(line);
 	    } while (line && Cond_EvalLine(line) != COND_PARSE);
 	    if (line == NULL)
 		break;
@@ -2890,6 +3186,7 @@ static void
 FinishDependencyGroup(void)
 {
     if (targets != NULL) {
+	Snapshot_FinishGroup();
 	Lst_ForEach(targets, SuffEndTransform, NULL);
 	Lst_Destroy(targets, ParseHasCommands);
 	targets = NULL;
@@ -2910,19 +3207,391 @@ ParseLine_ShellCommand(char *cp)
     }
 
     {
-	char *cmd = bmake_strdup(cp);
+	/* The commands live until make exits. */
+	char *cmd = bmake_arena_strdup(cp);
 	GNodeListNode *ln;
 
 	for (ln = targets->first; ln != NULL; ln = ln->next) {
 	    GNode *gn = ln->datum;
 	    ParseAddCmd(gn, cmd);
 	}
-#ifdef CLEANUP
-	Lst_Append(targCmds, cmd);
+    }
+}
+
+/* See if a line from a .depend file is a plain dependency line, as written
+ * by compilers: ordinary file names, a single ':' and more file names.
+ * Such a line needs neither variable expansion nor any of the special
+ * cases in ParseDoDependency, and the file names cannot be mistaken for
+ * special targets, archive members or wildcards. */
+static Boolean
+ParseDepend_IsPlain(const char *line)
+{
+    const char *cp;
+    Boolean wordStart = TRUE;
+    Boolean seenOp = FALSE;
+
+    if (ch_isspace(line[0]))
+	return FALSE;
+
+    for (cp = line; *cp != '\0'; cp++) {
+	switch (*cp) {
+	case '$': case '\\': case '(': case ')': case '!': case ';':
+	case '=': case '*': case '?': case '[': case '{': case '"':
+	case '\'':
+	    return FALSE;
+	case '.':
+	    /* might be a special target or a transformation rule */
+	    if (!seenOp && wordStart)
+		return FALSE;
+	    break;
+	case ':':
+	    if (seenOp)
+		break;
+	    if (cp == line || cp[1] == ':')
+		return FALSE;
+	    seenOp = TRUE;
+	    break;
+	default:
+	    break;
+	}
+	wordStart = ch_isspace(*cp);
+    }
+    return seenOp;
+}
+
+/* Handle a line for which ParseDepend_IsPlain returned TRUE, creating the
+ * nodes and their links directly.  This has the same effect as passing
+ * the line to ParseDoDependency. */
+static void
+ParseDependPlain(char *line)
+{
+    char *cp = line;
+    char *word;
+
+    DEBUG1(PARSE, "ParseDependPlain(%s)\n", line);
+
+    FinishDependencyGroup();
+    if (targets != NULL)
+	Lst_Free(targets);
+    targets = Lst_Init();
+
+    do {
+	GNode *gn;
+	char savec;
+
+	word = cp;
+	while (*cp != ':' && !ch_isspace(*cp))
+	    cp++;
+	savec = *cp;
+	*cp = '\0';
+	gn = Suff_IsTransform(word)
+	     ? Suff_AddTransform(word)
+	     : Targ_GetNode(word);
+	ParseMark(gn);
+	Lst_Append(targets, gn);
+	*cp = savec;
+	pp_skip_whitespace(&cp);
+    } while (*cp != ':');
+
+    ApplyDependencyOperator(OP_DEPENDS);
+    cp++;
+    pp_skip_whitespace(&cp);
+
+    while (*cp != '\0') {
+	word = cp;
+	while (*cp != '\0' && !ch_isspace(*cp))
+	    cp++;
+	if (*cp != '\0')
+	    *cp++ = '\0';
+	ParseDoSrc(0, word, Not);
+	pp_skip_whitespace(&cp);
+    }
+
+    FindMainTarget();
+}
+
+/* Parse a single logical line of a makefile, after the conditionals and
+ * .for loops have been handled by ParseReadLine. */
+static void
+ParseLine(char *line)
+{
+    char *cp;			/* pointer into the line */
+
+    if (*line == '.') {
+	/*
+	 * Lines that begin with the special character may be
+	 * include or undef directives.
+	 * On the other hand they can be suffix rules (.c.o: ...)
+	 * or just dependencies for filenames that start '.'.
+	 */
+	cp = line + 1;
+	pp_skip_whitespace(&cp);
+	if (IsInclude(cp, FALSE)) {
+	    ParseDoInclude(cp);
+	    return;
+	}
+	if (strncmp(cp, "undef", 5) == 0) {
+	    const char *varname;
+	    cp += 5;
+	    pp_skip_whitespace(&cp);
+	    varname = cp;
+	    for (; !ch_isspace(*cp) && *cp != '\0'; cp++)
+		continue;
+	    *cp = '\0';
+	    Var_Delete(varname, VAR_GLOBAL);
+	    /* TODO: undefine all variables, not only the first */
+	    /* TODO: use Str_Words, like everywhere else */
+	    return;
+	} else if (strncmp(cp, "export", 6) == 0) {
+	    cp += 6;
+	    pp_skip_whitespace(&cp);
+	    Var_Export(cp, TRUE);
+	    return;
+	} else if (strncmp(cp, "unexport", 8) == 0) {
+	    Var_UnExport(cp);
+	    return;
+	} else if (strncmp(cp, "info", 4) == 0 ||
+		   strncmp(cp, "error", 5) == 0 ||
+		   strncmp(cp, "warning", 7) == 0) {
+	    if (ParseMessage(cp))
+		return;
+	}
+    }
+
+    if (*line == '\t') {
+	/*
+	 * If a line starts with a tab, it can only hope to be
+	 * a creation command.
+	 */
+	cp = line + 1;
+      shellCommand:
+	ParseLine_ShellCommand(cp);
+	return;
+    }
+
+#ifdef SYSVINCLUDE
+    if (IsSysVInclude(line)) {
+	/*
+	 * It's an S3/S5-style "include".
+	 */
+	ParseTraditionalInclude(line);
+	return;
+    }
+#endif
+#ifdef GMAKEEXPORT
+    if (strncmp(line, "export", 6) == 0 && ch_isspace(line[6]) &&
+	strchr(line, ':') == NULL) {
+	/*
+	 * It's a Gmake "export".
+	 */
+	ParseGmakeExport(line);
+	return;
+    }
 #endif
+    if (doing_depend && ParseDepend_IsPlain(line)) {
+	ParseDependPlain(line);
+	return;
+    }
+    {
+	VarAssign var;
+	if (Parse_IsVar(line, &var)) {
+	    FinishDependencyGroup();
+	    Parse_DoVar(&var, VAR_GLOBAL);
+	    return;
+	}
+    }
+
+#ifndef POSIX
+    /*
+     * To make life easier on novices, if the line is indented we
+     * first make sure the line has a dependency operator in it.
+     * If it doesn't have an operator and we're in a dependency
+     * line's script, we assume it's actually a shell command
+     * and add it to the current list of targets.
+     */
+    cp = line;
+    if (ch_isspace(line[0])) {
+	pp_skip_whitespace(&cp);
+	while (*cp && (ParseIsEscaped(line, cp) ||
+		*cp != ':' && *cp != '!')) {
+	    cp++;
+	}
+	if (*cp == '\0') {
+	    if (targets == NULL) {
+		Parse_Error(PARSE_WARNING,
+			     "Shell command needs a leading tab");
+		goto shellCommand;
+	    }
+	}
+    }
+#endif
+    FinishDependencyGroup();
+
+    /*
+     * For some reason - probably to make the parser impossible -
+     * a ';' can be used to separate commands from dependencies.
+     * Attempt to avoid ';' inside substitution patterns.
+     */
+    {
+	int level = 0;
+
+	for (cp = line; *cp != 0; cp++) {
+	    if (*cp == '\\' && cp[1] != 0) {
+		cp++;
+		continue;
+	    }
+	    if (*cp == '$' &&
+		(cp[1] == '(' || cp[1] == '{')) {
+		level++;
+		continue;
+	    }
+	    if (level > 0) {
+		if (*cp == ')' || *cp == '}') {
+		    level--;
+		    continue;
+		}
+	    } else if (*cp == ';') {
+		break;
+	    }
+	}
+    }
+    if (*cp != 0)
+	/* Terminate the dependency list at the ';' */
+	*cp++ = 0;
+    else
+	cp = NULL;
+
+    /*
+     * We now know it's a dependency line so it needs to have all
+     * variables expanded before being parsed.
+     *
+     * XXX: Ideally the dependency line would first be split into
+     * its left-hand side, dependency operator and right-hand side,
+     * and then each side would be expanded on its own.  This would
+     * allow for the left-hand side to allow only defined variables
+     * and to allow variables on the right-hand side to be undefined
+     * as well.
+     *
+     * Parsing the line first would also prevent that targets
+     * generated from variable expressions are interpreted as the
+     * dependency operator, such as in "target${:U:} middle: source",
+     * in which the middle is interpreted as a source, not a target.
+     */
+    {
+	/* In lint mode, allow undefined variables to appear in
+	 * dependency lines.
+	 *
+	 * Ideally, only the right-hand side would allow undefined
+	 * variables since it is common to have no dependencies.
+	 * Having undefined variables on the left-hand side is more
+	 * unusual though.  Since both sides are expanded in a single
+	 * pass, there is not much choice what to do here.
+	 *
+	 * In normal mode, it does not matter whether undefined
+	 * variables are allowed or not since as of 2020-09-14,
+	 * Var_Parse does not print any parse errors in such a case.
+	 * It simply returns the special empty string var_Error,
+	 * which cannot be detected in the result of Var_Subst. */
+	VarEvalFlags eflags = DEBUG(LINT)
+			      ? VARE_WANTRES
+			      : VARE_UNDEFERR|VARE_WANTRES;
+	(void)Var_Subst(line, VAR_CMD, eflags, &line);
+	/* TODO: handle errors */
+    }
+
+    /* Need a fresh list for the target nodes */
+    if (targets != NULL)
+	Lst_Free(targets);
+    targets = Lst_Init();
+
+    ParseDoDependency(line);
+    free(line);
+
+    /* If there were commands after a ';', add them now */
+    if (cp != NULL) {
+	goto shellCommand;
     }
 }
 
+/* See if the assignment may do more than setting the variable, see
+ * VarAssignSpecial. */
+static Boolean
+VarAssign_HasSideEffects(const VarAssign *var)
+{
+    static const char *const names[] = {
+	MAKEOVERRIDES, ".CURDIR", MAKE_JOB_PREFIX, MAKE_EXPORTED
+    };
+    size_t i;
+
+    for (i = 0; i < sizeof names / sizeof names[0]; i++)
+	if (strncmp(var->nameStart, names[i], strlen(names[i])) == 0)
+	    return TRUE;
+    return memchr(var->nameStart, '$',
+		  (size_t)(var->nameEndDraft - var->nameStart)) != NULL;
+}
+
+/* See if the effects of the line are completely described by the variables
+ * it sets, so that it need not be recorded in the snapshot of the system
+ * makefile.  Any line for which this returns FALSE is parsed again when
+ * the snapshot is replayed, which is always correct. */
+static Boolean
+ParseLine_OnlySetsVars(const char *line)
+{
+    const char *cp;
+    VarAssign var;
+
+    if (*line == '.') {
+	cp = line + 1;
+	cpp_skip_whitespace(&cp);
+	if (IsInclude(cp, FALSE) || strncmp(cp, "undef", 5) == 0)
+	    return TRUE;
+	if (strncmp(cp, "export", 6) == 0 ||
+	    strncmp(cp, "unexport", 8) == 0 ||
+	    strncmp(cp, "info", 4) == 0 ||
+	    strncmp(cp, "error", 5) == 0 ||
+	    strncmp(cp, "warning", 7) == 0)
+	    return FALSE;
+    }
+    if (*line == '\t')
+	return FALSE;
+#ifdef SYSVINCLUDE
+    if (IsSysVInclude(line))
+	return TRUE;
+#endif
+#ifdef GMAKEEXPORT
+    if (strncmp(line, "export", 6) == 0 && ch_isspace(line[6]) &&
+	strchr(line, ':') == NULL)
+	return FALSE;
+#endif
+    return Parse_IsVar(line, &var) && !VarAssign_HasSideEffects(&var);
+}
+
+/* Parse a line again that has been recorded in the snapshot of the system
+ * makefile, see Snapshot_BeginLine. */
+void
+Parse_ReplayLine(const char *fname, int lineno, const char *line)
+{
+    IFile replay;
+    char *copy = bmake_strdup(line);
+
+    memset(&replay, 0, sizeof replay);
+    replay.fname = UNCONST(fname);	/* interned, lives until make exits */
+    replay.lineno = lineno;
+    replay.first_lineno = lineno;
+    curFile = &replay;
+    ParseLine(copy);
+    curFile = NULL;
+    free(copy);
+}
+
+/* Finish the dependency group at the end of a replayed snapshot, or where
+ * an assignment line ended it while recording. */
+void
+Parse_ReplayFinish(void)
+{
+    FinishDependencyGroup();
+}
+
 /* Parse a top-level makefile into its component parts, incorporating them
  * into the global dependency graph.
  *
@@ -2933,7 +3602,6 @@ ParseLine_ShellCommand(char *cp)
 void
 Parse_File(const char *name, int fd)
 {
-    char	  *cp;		/* pointer into the line */
     char          *line;	/* the line we're working on */
     struct loadedfile *lf;
 
@@ -2951,196 +3619,12 @@ Parse_File(const char *name, int fd)
     do {
 	for (; (line = ParseReadLine()) != NULL; ) {
 	    DEBUG2(PARSE, "ParseReadLine (%d): '%s'\n", curFile->lineno, line);
-	    if (*line == '.') {
-		/*
-		 * Lines that begin with the special character may be
-		 * include or undef directives.
-		 * On the other hand they can be suffix rules (.c.o: ...)
-		 * or just dependencies for filenames that start '.'.
-		 */
-		cp = line + 1;
-		pp_skip_whitespace(&cp);
-		if (IsInclude(cp, FALSE)) {
-		    ParseDoInclude(cp);
-		    continue;
-		}
-		if (strncmp(cp, "undef", 5) == 0) {
-		    const char *varname;
-		    cp += 5;
-		    pp_skip_whitespace(&cp);
-		    varname = cp;
-		    for (; !ch_isspace(*cp) && *cp != '\0'; cp++)
-			continue;
-		    *cp = '\0';
-		    Var_Delete(varname, VAR_GLOBAL);
-		    /* TODO: undefine all variables, not only the first */
-		    /* TODO: use Str_Words, like everywhere else */
-		    continue;
-		} else if (strncmp(cp, "export", 6) == 0) {
-		    cp += 6;
-		    pp_skip_whitespace(&cp);
-		    Var_Export(cp, TRUE);
-		    continue;
-		} else if (strncmp(cp, "unexport", 8) == 0) {
-		    Var_UnExport(cp);
-		    continue;
-		} else if (strncmp(cp, "info", 4) == 0 ||
-			   strncmp(cp, "error", 5) == 0 ||
-			   strncmp(cp, "warning", 7) == 0) {
-		    if (ParseMessage(cp))
-			continue;
-		}
-	    }
-
-	    if (*line == '\t') {
-		/*
-		 * If a line starts with a tab, it can only hope to be
-		 * a creation command.
-		 */
-		cp = line + 1;
-	      shellCommand:
-	        ParseLine_ShellCommand(cp);
-		continue;
-	    }
-
-#ifdef SYSVINCLUDE
-	    if (IsSysVInclude(line)) {
-		/*
-		 * It's an S3/S5-style "include".
-		 */
-		ParseTraditionalInclude(line);
-		continue;
-	    }
-#endif
-#ifdef GMAKEEXPORT
-	    if (strncmp(line, "export", 6) == 0 && ch_isspace(line[6]) &&
-		strchr(line, ':') == NULL) {
-		/*
-		 * It's a Gmake "export".
-		 */
-		ParseGmakeExport(line);
-		continue;
-	    }
-#endif
-	    {
-	        VarAssign var;
-		if (Parse_IsVar(line, &var)) {
-		    FinishDependencyGroup();
-		    Parse_DoVar(&var, VAR_GLOBAL);
-		    continue;
-		}
-	    }
-
-#ifndef POSIX
-	    /*
-	     * To make life easier on novices, if the line is indented we
-	     * first make sure the line has a dependency operator in it.
-	     * If it doesn't have an operator and we're in a dependency
-	     * line's script, we assume it's actually a shell command
-	     * and add it to the current list of targets.
-	     */
-	    cp = line;
-	    if (ch_isspace(line[0])) {
-		pp_skip_whitespace(&cp);
-		while (*cp && (ParseIsEscaped(line, cp) ||
-			*cp != ':' && *cp != '!')) {
-		    cp++;
-		}
-		if (*cp == '\0') {
-		    if (targets == NULL) {
-			Parse_Error(PARSE_WARNING,
-				     "Shell command needs a leading tab");
-			goto shellCommand;
-		    }
-		}
-	    }
-#endif
-	    FinishDependencyGroup();
-
-	    /*
-	     * For some reason - probably to make the parser impossible -
-	     * a ';' can be used to separate commands from dependencies.
-	     * Attempt to avoid ';' inside substitution patterns.
-	     */
-	    {
-		int level = 0;
-
-		for (cp = line; *cp != 0; cp++) {
-		    if (*cp == '\\' && cp[1] != 0) {
-			cp++;
-			continue;
-		    }
-		    if (*cp == '$' &&
-			(cp[1] == '(' || cp[1] == '{')) {
-			level++;
-			continue;
-		    }
-		    if (level > 0) {
-			if (*cp == ')' || *cp == '}') {
-			    level--;
-			    continue;
-			}
-		    } else if (*cp == ';') {
-			break;
-		    }
-		}
-	    }
-	    if (*cp != 0)
-		/* Terminate the dependency list at the ';' */
-		*cp++ = 0;
-	    else
-		cp = NULL;
-
-	    /*
-	     * We now know it's a dependency line so it needs to have all
-	     * variables expanded before being parsed.
-	     *
-	     * XXX: Ideally the dependency line would first be split into
-	     * its left-hand side, dependency operator and right-hand side,
-	     * and then each side would be expanded on its own.  This would
-	     * allow for the left-hand side to allow only defined variables
-	     * and to allow variables on the right-hand side to be undefined
-	     * as well.
-	     *
-	     * Parsing the line first would also prevent that targets
-	     * generated from variable expressions are interpreted as the
-	     * dependency operator, such as in "target${:U:} middle: source",
-	     * in which the middle is interpreted as a source, not a target.
-	     */
-	    {
-	        /* In lint mode, allow undefined variables to appear in
-	         * dependency lines.
-	         *
-	         * Ideally, only the right-hand side would allow undefined
-	         * variables since it is common to have no dependencies.
-	         * Having undefined variables on the left-hand side is more
-	         * unusual though.  Since both sides are expanded in a single
-	         * pass, there is not much choice what to do here.
-	         *
-	         * In normal mode, it does not matter whether undefined
-	         * variables are allowed or not since as of 2020-09-14,
-	         * Var_Parse does not print any parse errors in such a case.
-	         * It simply returns the special empty string var_Error,
-	         * which cannot be detected in the result of Var_Subst. */
-		VarEvalFlags eflags = DEBUG(LINT)
-				      ? VARE_WANTRES
-				      : VARE_UNDEFERR|VARE_WANTRES;
-		(void)Var_Subst(line, VAR_CMD, eflags, &line);
-		/* TODO: handle errors */
-	    }
-
-	    /* Need a fresh list for the target nodes */
-	    if (targets != NULL)
-		Lst_Free(targets);
-	    targets = Lst_Init();
-
-	    ParseDoDependency(line);
-	    free(line);
-
-	    /* If there were commands after a ';', add them now */
-	    if (cp != NULL) {
-		goto shellCommand;
-	    }
+	    if (Snapshot_Recording() && !ParseLine_OnlySetsVars(line)) {
+		Snapshot_BeginLine(curFile->fname, curFile->lineno, line);
+		ParseLine(line);
+		Snapshot_EndLine();
+	    } else
+		ParseLine(line);
 	}
 	/*
 	 * Reached EOF, but it may be just EOF of an include file...
@@ -3175,20 +3659,26 @@ void
 Parse_Init(void)
 {
     mainNode = NULL;
+    Hash_InitTable(&guardedFiles);
+    Buf_Init(&curLine, 0);
     parseIncPath = Lst_Init();
     sysIncPath = Lst_Init();
     defIncPath = Lst_Init();
     Stack_Init(&includes);
-#ifdef CLEANUP
-    targCmds = Lst_Init();
-#endif
 }
 
 void
 Parse_End(void)
 {
 #ifdef CLEANUP
-    Lst_Destroy(targCmds, free);
+    Hash_Search search;
+    Hash_Entry *he;
+
+    for (he = Hash_EnumFirst(&guardedFiles, &search); he != NULL;
+	 he = Hash_EnumNext(&search))
+	free(Hash_GetValue(he));
+    Hash_DeleteTable(&guardedFiles);
+    Buf_Destroy(&curLine, TRUE);
     assert(targets == NULL);
     Lst_Destroy(defIncPath, Dir_Destroy);
     Lst_Destroy(sysIncPath, Dir_Destroy);
@@ -3224,8 +3714,10 @@ Parse_MainName(void)
 	Punt("no target to make.");
 	/*NOTREACHED*/
     } else if (mainNode->type & OP_DOUBLEDEP) {
+	unsigned int i;
 	Lst_Append(mainList, mainNode);
-	Lst_AppendAll(mainList, mainNode->cohorts);
+	for (i = 0; i < mainNode->cohorts.len; i++)
+	    Lst_Append(mainList, GNodeVec_Get(&mainNode->cohorts, i));
     }
     else
 	Lst_Append(mainList, mainNode);
@@ -0,0 +1,579 @@
+/*	$NetBSD$	*/
+
+/*-
+ * Copyright (c) 2020 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*-
+ * snapshot.c --
+ *	Save the state that results from reading the system makefile and
+ *	restore it in later runs of make, instead of reading sys.mk and
+ *	everything it includes again.  This is only done if the environment
+ *	variable MAKESYSCACHE names a directory for the snapshots.
+ *
+ *	While sys.mk is read, the effect of each line is recorded.  Lines
+ *	that only set variables, such as assignments, conditionals, .for
+ *	loops and .include directives, are recorded as the resulting
+ *	variable values.  All other lines, such as dependency lines, shell
+ *	commands and .export directives, are recorded as the line itself,
+ *	to be parsed again when the snapshot is replayed.
+ *
+ *	A snapshot is identified by everything that may influence the
+ *	reading of sys.mk: the variables that are defined before, the
+ *	command line targets and the include paths.  It is only used if
+ *	the files and directories that were read or searched, the places
+ *	where .include and exists() looked for files and the environment
+ *	variables that were looked up are still the same.
+ *
+ *	Commands from the != assignment operator and the :sh modifier are
+ *	not run again when the snapshot is replayed; their output is
+ *	assumed to be the same.
+ *
+ * Interface:
+ *	Snapshot_Load	Replay the snapshot for the system makefile, or
+ *			start recording a new one.
+ *
+ *	Snapshot_Save	Save the snapshot that has been recorded.
+ *
+ *	The other functions are called by the parser, the variable module
+ *	and the conditional module while a snapshot is recorded.
+ */
+
+#include <sys/stat.h>
+
+#include "make.h"
+#include "dir.h"
+#include "job.h"
+
+extern SearchPath *parseIncPath;
+
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif
+
+MAKE_RCSID("$NetBSD$");
+
+#define SNAPSHOT_MAGIC "bmake-sys-snapshot 1\n"
+
+/*
+ * The snapshot file starts with SNAPSHOT_MAGIC, followed by records.
+ * Each record starts with a type byte, followed by a fixed number of
+ * fields.  Each field is written as its decimal length, a ':', the bytes
+ * of the field and a '\0', so that the fields can be used as strings
+ * directly from the mapped file.
+ *
+ *	K key			The key of the snapshot.
+ *	f path state		A file or directory that was read or searched.
+ *	e path state		A place where a file was looked for, by exists()
+ *				or .include, whether it was found there or not.
+ *	v name state		An environment variable that was looked up.
+ *	V ctxt name value	Set a variable in VAR_GLOBAL or VAR_INTERNAL.
+ *	D ctxt name		Delete a variable.
+ *	L fname lineno line	Parse the line again.
+ *	F			Finish the current dependency group.
+ */
+static const struct {
+    char type;
+    int nfields;
+} snapRecordTypes[] = {
+    { 'K', 1 }, { 'f', 2 }, { 'e', 2 }, { 'v', 2 },
+    { 'V', 3 }, { 'D', 2 }, { 'L', 3 }, { 'F', 0 }
+};
+
+static char *snapPath;		/* the snapshot file for snapKey */
+static Buffer snapKey;
+static Buffer snapDeps;		/* the f, e and v records */
+static Buffer snapRecs;		/* the V, D, L and F records */
+static Hash_Table snapSeen;	/* the dependencies recorded so far */
+static Boolean recording;
+static Boolean abandoned;	/* don't save the recorded snapshot */
+static int suspended;		/* inside an 'L' line */
+
+static void
+SnapAddField(Buffer *buf, const char *str, size_t len)
+{
+    Buf_AddInt(buf, (int)len);
+    Buf_AddByte(buf, ':');
+    Buf_AddBytes(buf, str, len);
+    Buf_AddByte(buf, '\0');
+}
+
+static void
+SnapAddStr(Buffer *buf, const char *str)
+{
+    SnapAddField(buf, str, strlen(str));
+}
+
+/* Describe the current state of the file, directory or environment
+ * variable, for comparing it with the state at the time the snapshot was
+ * recorded.  The caller must free the result. */
+static char *
+SnapState(char type, const char *name)
+{
+    struct stat st;
+    char buf[80];
+
+    switch (type) {
+    case 'f':
+	if (stat(name, &st) == -1)
+	    return bmake_strdup("-");
+	snprintf(buf, sizeof buf, "%lld %lld %llu",
+		 (long long)st.st_mtime, (long long)st.st_size,
+		 (unsigned long long)st.st_ino);
+	return bmake_strdup(buf);
+    case 'e':
+	return bmake_strdup(stat(name, &st) == 0 ? "1" : "0");
+    default: {
+	const char *val = getenv(name);
+	return val != NULL ? str_concat2("=", val) : bmake_strdup("-");
+    }
+    }
+}
+
+/* Remember that the snapshot depends on the state of the file, directory
+ * or environment variable. */
+static void
+SnapAddDep(char type, const char *name, const char *state)
+{
+    char key[2] = { type, '\0' };
+    char *fullkey;
+    char *state_freeIt = NULL;
+    Boolean isNew;
+
+    if (!recording)
+	return;
+    fullkey = str_concat2(key, name);
+    (void)Hash_CreateEntry(&snapSeen, fullkey, &isNew);
+    free(fullkey);
+    if (!isNew)
+	return;
+
+    if (state == NULL)
+	state = state_freeIt = SnapState(type, name);
+    Buf_AddByte(&snapDeps, type);
+    SnapAddStr(&snapDeps, name);
+    SnapAddStr(&snapDeps, state);
+    free(state_freeIt);
+}
+
+static void
+SnapAddSearchPath(SearchPath *path)
+{
+    ListNode *ln;
+
+    for (ln = path->first; ln != NULL; ln = ln->next) {
+	CachedDir *dir = ln->datum;
+	SnapAddDep('f', dir->name, NULL);
+    }
+}
+
+static void
+SnapAddCandidate(const char *dir, const char *name)
+{
+    char *path = str_concat3(dir, "/", name);
+    SnapAddDep('e', path, NULL);
+    free(path);
+}
+
+static void
+SnapBuildKey(StringList *sysMkPath)
+{
+    StringListNode *ln;
+    char *flags;
+
+    Buf_Init(&snapKey, 0);
+    for (ln = sysMkPath->first; ln != NULL; ln = ln->next) {
+	Buf_AddStr(&snapKey, "sysmk ");
+	Buf_AddStr(&snapKey, ln->datum);
+	Buf_AddByte(&snapKey, '\n');
+    }
+    flags = Dir_MakeFlags("-I", parseIncPath);
+    Buf_AddStr(&snapKey, flags);
+    free(flags);
+    flags = Dir_MakeFlags("-m",
+			  Lst_IsEmpty(sysIncPath) ? defIncPath : sysIncPath);
+    Buf_AddStr(&snapKey, flags);
+    free(flags);
+    Buf_AddStr(&snapKey, "\n[cmd]\n");
+    Var_AppendState(&snapKey, VAR_CMD);
+    Buf_AddStr(&snapKey, "[global]\n");
+    Var_AppendState(&snapKey, VAR_GLOBAL);
+    Buf_AddStr(&snapKey, "[internal]\n");
+    Var_AppendState(&snapKey, VAR_INTERNAL);
+}
+
+static char *
+SnapPath(const char *dir, const char *key, size_t keylen)
+{
+    unsigned long long h = 14695981039346656037ULL;	/* FNV-1a */
+    char name[32];
+    size_t i;
+
+    for (i = 0; i < keylen; i++) {
+	h ^= (unsigned char)key[i];
+	h *= 1099511628211ULL;
+    }
+    snprintf(name, sizeof name, "/sys-%016llx", h);
+    return str_concat2(dir, name);
+}
+
+/* Read the next record from the snapshot data, storing its fields.
+ * Return the type of the record, or '\0' at the end or on malformed
+ * data. */
+static char
+SnapNextRecord(const char **pp, const char *end, const char **fields)
+{
+    const char *p = *pp;
+    char type;
+    size_t i;
+    int j, nfields = -1;
+
+    if (p >= end)
+	return '\0';
+    type = *p++;
+    for (i = 0; i < sizeof snapRecordTypes / sizeof snapRecordTypes[0]; i++)
+	if (snapRecordTypes[i].type == type)
+	    nfields = snapRecordTypes[i].nfields;
+    if (nfields < 0)
+	return '\0';
+
+    for (j = 0; j < nfields; j++) {
+	size_t len = 0;
+
+	if (p >= end || !ch_isdigit(*p))
+	    return '\0';
+	while (p < end && ch_isdigit(*p))
+	    len = len * 10 + (size_t)(*p++ - '0');
+	if (p >= end || *p != ':' || (size_t)(end - p) < len + 2 ||
+	    p[1 + len] != '\0')
+	    return '\0';
+	fields[j] = p + 1;
+	p += len + 2;
+    }
+    *pp = p;
+    return type;
+}
+
+/* See if the snapshot is well-formed, belongs to the key and whether its
+ * dependencies are still the same. */
+static Boolean
+SnapIsValid(const char *data, const char *end)
+{
+    const char *fields[3];
+    const char *p = data;
+    char type;
+
+    if (SnapNextRecord(&p, end, fields) != 'K' ||
+	strlen(fields[0]) != Buf_Len(&snapKey) ||
+	memcmp(fields[0], Buf_GetAll(&snapKey, NULL), Buf_Len(&snapKey)) != 0)
+	return FALSE;
+
+    while ((type = SnapNextRecord(&p, end, fields)) != '\0') {
+	if (type == 'f' || type == 'e' || type == 'v') {
+	    char *state = SnapState(type, fields[0]);
+	    Boolean same = strcmp(state, fields[1]) == 0;
+	    free(state);
+	    if (!same) {
+		DEBUG2(PARSE, "snapshot: %s has changed in %s\n",
+		       fields[0], snapPath);
+		return FALSE;
+	    }
+	}
+    }
+    return p == end;
+}
+
+static void
+SnapReplay(const char *data, const char *end)
+{
+    const char *fields[3];
+    const char *p = data;
+    char type;
+
+    while ((type = SnapNextRecord(&p, end, fields)) != '\0') {
+	switch (type) {
+	case 'V':
+	    Var_Set(fields[1], fields[2],
+		    fields[0][0] == 'I' ? VAR_INTERNAL : VAR_GLOBAL);
+	    break;
+	case 'D':
+	    Var_Delete(fields[1],
+		       fields[0][0] == 'I' ? VAR_INTERNAL : VAR_GLOBAL);
+	    break;
+	case 'L':
+	    Parse_ReplayLine(Hash_Intern(fields[0]), atoi(fields[1]),
+			     fields[2]);
+	    break;
+	case 'F':
+	    Parse_ReplayFinish();
+	    break;
+	}
+    }
+    Parse_ReplayFinish();
+}
+
+/* Replay the snapshot of the system makefile, if there is a valid one.
+ * Otherwise, start recording a new snapshot while sys.mk is read.
+ *
+ * Return TRUE if the snapshot has been replayed, so that sys.mk needs
+ * not be read. */
+Boolean
+Snapshot_Load(StringList *sysMkPath)
+{
+    const char *dir = getenv("MAKESYSCACHE");
+    int fd;
+    struct stat st;
+    char *data;
+    size_t size;
+    Boolean mapped = FALSE, ok = FALSE;
+
+    if (dir == NULL || dir[0] == '\0')
+	return FALSE;
+    /* Commands from sys.mk would initialize the shell, which sets .SHELL
+     * in VAR_CMD.  Do this in advance so that the snapshot need not. */
+    if (shellName == NULL)
+	Shell_Init();
+    SnapBuildKey(sysMkPath);
+    snapPath = SnapPath(dir, Buf_GetAll(&snapKey, NULL),
+			Buf_Len(&snapKey));
+
+    if ((fd = open(snapPath, O_RDONLY)) != -1 && fstat(fd, &st) == 0 &&
+	S_ISREG(st.st_mode) && st.st_size > (off_t)strlen(SNAPSHOT_MAGIC)) {
+	size = (size_t)st.st_size;
+	data = NULL;
+#ifdef HAVE_MMAP
+	data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (data == MAP_FAILED)
+	    data = NULL;
+	else
+	    mapped = TRUE;
+#endif
+	if (data == NULL) {
+	    data = bmake_malloc(size);
+	    if (read(fd, data, size) != (ssize_t)size) {
+		free(data);
+		data = NULL;
+	    }
+	}
+	if (data != NULL) {
+	    const char *start = data + strlen(SNAPSHOT_MAGIC);
+	    ok = memcmp(data, SNAPSHOT_MAGIC, strlen(SNAPSHOT_MAGIC)) == 0 &&
+		 SnapIsValid(start, data + size);
+	    if (ok) {
+		DEBUG1(PARSE, "snapshot: replaying %s\n", snapPath);
+		SnapReplay(start, data + size);
+	    }
+#ifdef HAVE_MMAP
+	    if (mapped)
+		munmap(data, size);
+	    else
+#endif
+		free(data);
+	}
+    }
+    if (fd != -1)
+	(void)close(fd);
+    if (ok)
+	return TRUE;
+
+    DEBUG1(PARSE, "snapshot: recording %s\n", snapPath);
+    Buf_Init(&snapDeps, 0);
+    Buf_Init(&snapRecs, 0);
+    Hash_InitTable(&snapSeen);
+    recording = TRUE;
+    abandoned = FALSE;
+    suspended = 0;
+    SnapAddSearchPath(parseIncPath);
+    SnapAddSearchPath(Lst_IsEmpty(sysIncPath) ? defIncPath : sysIncPath);
+    return FALSE;
+}
+
+/* Save the snapshot that has been recorded while reading sys.mk.  Errors
+ * are ignored, the system makefile is then simply read again next time. */
+void
+Snapshot_Save(void)
+{
+    char tmp[MAXPATHLEN];
+    FILE *fp;
+    Boolean ok;
+
+    if (!recording)
+	return;
+    recording = FALSE;
+
+    if (abandoned) {
+	DEBUG1(PARSE, "snapshot: not saving %s\n", snapPath);
+	return;
+    }
+    snprintf(tmp, sizeof tmp, "%s.%ld", snapPath, (long)getpid());
+    if ((fp = fopen(tmp, "w")) == NULL)
+	return;
+    ok = fputs(SNAPSHOT_MAGIC, fp) != EOF &&
+	 fputc('K', fp) != EOF &&
+	 fprintf(fp, "%lu:", (unsigned long)Buf_Len(&snapKey)) > 0 &&
+	 fwrite(Buf_GetAll(&snapKey, NULL), 1, Buf_Len(&snapKey) + 1, fp) ==
+	     Buf_Len(&snapKey) + 1 &&
+	 fwrite(Buf_GetAll(&snapDeps, NULL), 1, Buf_Len(&snapDeps), fp) ==
+	     Buf_Len(&snapDeps) &&
+	 fwrite(Buf_GetAll(&snapRecs, NULL), 1, Buf_Len(&snapRecs), fp) ==
+	     Buf_Len(&snapRecs);
+    if (fclose(fp) != 0)
+	ok = FALSE;
+    if (!ok || rename(tmp, snapPath) != 0)
+	(void)unlink(tmp);
+    else
+	DEBUG1(PARSE, "snapshot: saved %s\n", snapPath);
+
+    Buf_Destroy(&snapDeps, TRUE);
+    Buf_Destroy(&snapRecs, TRUE);
+    Hash_DeleteTable(&snapSeen);
+}
+
+Boolean
+Snapshot_Recording(void)
+{
+    return recording;
+}
+
+/* The snapshot cannot describe what happened, for example because of a
+ * parse error, so it must not be saved. */
+void
+Snapshot_Abandon(void)
+{
+    abandoned = TRUE;
+}
+
+/* A variable has been set (val != NULL) or deleted (val == NULL). */
+void
+Snapshot_Var(GNode *ctxt, const char *name, const char *val)
+{
+    if (!recording || suspended > 0)
+	return;
+    if (ctxt == VAR_CMD || strchr(name, '$') != NULL) {
+	Snapshot_Abandon();
+	return;
+    }
+    if (ctxt != VAR_GLOBAL && ctxt != VAR_INTERNAL)
+	return;
+
+    Buf_AddByte(&snapRecs, val != NULL ? 'V' : 'D');
+    SnapAddStr(&snapRecs, ctxt == VAR_INTERNAL ? "I" : "G");
+    SnapAddStr(&snapRecs, name);
+    if (val != NULL)
+	SnapAddStr(&snapRecs, val);
+}
+
+/* The environment variable has been looked up and has the given value,
+ * or is not defined if val is NULL. */
+void
+Snapshot_Env(const char *name, const char *val)
+{
+    char *state;
+
+    if (!recording)
+	return;
+    state = val != NULL ? str_concat2("=", val) : bmake_strdup("-");
+    SnapAddDep('v', name, state);
+    free(state);
+}
+
+/* The file has been read, which also depends on the directory it was
+ * found in. */
+void
+Snapshot_File(const char *fname)
+{
+    const char *slash;
+
+    if (!recording)
+	return;
+    SnapAddDep('f', fname, NULL);
+    if ((slash = strrchr(fname, '/')) != NULL) {
+	char *dir = bmake_strsedup(fname, slash > fname ? slash : slash + 1);
+	SnapAddDep('f', dir, NULL);
+	free(dir);
+    } else
+	SnapAddDep('f', ".", NULL);
+}
+
+/* The file is looked for along the path, by .include or by exists().
+ * Whether and where it is found depends on each of the places where it
+ * could be, so all of them are recorded, not only the one where it has
+ * been found.  The path may be NULL for absolute names. */
+void
+Snapshot_Search(const char *name, SearchPath *path)
+{
+    ListNode *ln;
+
+    if (!recording)
+	return;
+    SnapAddDep('e', name, NULL);
+    if (name[0] == '/')
+	return;
+    SnapAddCandidate(curdir, name);
+    if (path == NULL)
+	return;
+    for (ln = path->first; ln != NULL; ln = ln->next) {
+	CachedDir *dir = ln->datum;
+	if (strcmp(dir->name, ".DOTLAST") == 0)
+	    continue;
+	SnapAddDep('f', dir->name, NULL);
+	SnapAddCandidate(dir->name, name);
+    }
+}
+
+/* The line will be parsed again when the snapshot is replayed, therefore
+ * the variables it sets on the way are not recorded. */
+void
+Snapshot_BeginLine(const char *fname, int lineno, const char *line)
+{
+    char buf[16];
+
+    if (!recording)
+	return;
+    if (suspended++ > 0)
+	return;
+    snprintf(buf, sizeof buf, "%d", lineno);
+    Buf_AddByte(&snapRecs, 'L');
+    SnapAddStr(&snapRecs, fname);
+    SnapAddStr(&snapRecs, buf);
+    SnapAddStr(&snapRecs, line);
+}
+
+void
+Snapshot_EndLine(void)
+{
+    if (recording && suspended > 0)
+	suspended--;
+}
+
+/* The targets of the current dependency group are complete, see
+ * FinishDependencyGroup. */
+void
+Snapshot_FinishGroup(void)
+{
+    if (!recording || suspended > 0)
+	return;
+    Buf_AddByte(&snapRecs, 'F');
+}
@@ -217,7 +217,7 @@ static Suff *emptySuff;		/* The empty suffix required for POSIX
 
 
 static void SuffFindDeps(GNode *, SrcList *);
-static void SuffExpandWildcards(GNodeListNode *, GNode *);
+static unsigned int SuffExpandWildcards(unsigned int, GNode *);
 
 	/*************** Lst Predicates ****************/
 /*-
@@ -249,7 +249,7 @@ SuffStrIsPrefix(const char *pref, const char *str)
 
 struct SuffSuffGetSuffixArgs {
     size_t name_len;
-    char *name_end;
+    const char *name_end;
 };
 
 /* See if suff is a suffix of str. str->ename should point to THE END
@@ -263,11 +263,11 @@ struct SuffSuffGetSuffixArgs {
  *	NULL if it ain't, pointer to character in str before suffix if
  *	it is.
  */
-static char *
+static const char *
 SuffSuffGetSuffix(const Suff *s, const struct SuffSuffGetSuffixArgs *str)
 {
-    char *p1;			/* Pointer into suffix name */
-    char *p2;			/* Pointer into string being examined */
+    const char *p1;		/* Pointer into suffix name */
+    const char *p2;		/* Pointer into string being examined */
 
     if (str->name_len < s->nameLen)
 	return NULL;		/* this string is shorter than the suffix */
@@ -569,9 +569,8 @@ Suff_AddTransform(const char *line)
 	 */
 	gn = LstNode_Datum(ln);
 	Lst_Free(gn->commands);
-	Lst_Free(gn->children);
 	gn->commands = Lst_Init();
-	gn->children = Lst_Init();
+	GNodeVec_Done(&gn->children);
     }
 
     gn->type = OP_TRANSFORM;
@@ -603,10 +602,10 @@ Suff_AddTransform(const char *line)
 void
 Suff_EndTransform(GNode *gn)
 {
-    if ((gn->type & OP_DOUBLEDEP) && !Lst_IsEmpty(gn->cohorts))
-	gn = LstNode_Datum(Lst_Last(gn->cohorts));
+    if ((gn->type & OP_DOUBLEDEP) && !GNodeVec_IsEmpty(&gn->cohorts))
+	gn = GNodeVec_Last(&gn->cohorts);
     if ((gn->type & OP_TRANSFORM) && Lst_IsEmpty(gn->commands) &&
-	Lst_IsEmpty(gn->children))
+	GNodeVec_IsEmpty(&gn->children))
     {
 	Suff	*s, *t;
 
@@ -663,13 +662,13 @@ SuffRebuildGraph(void *transformp, void *sp)
 {
     GNode *transform = (GNode *)transformp;
     Suff *s = (Suff *)sp;
-    char *cp;
+    const char *cp;
     struct SuffSuffGetSuffixArgs sd;
 
     /*
      * First see if it is a transformation from this suffix.
      */
-    cp = UNCONST(SuffStrIsPrefix(s->name, transform->name));
+    cp = SuffStrIsPrefix(s->name, transform->name);
     if (cp != NULL) {
 	Suff *s2 = FindSuffByName(cp);
 	if (s2 != NULL) {
@@ -688,12 +687,13 @@ SuffRebuildGraph(void *transformp, void *sp)
     cp = SuffSuffGetSuffix(s, &sd);
     if (cp != NULL) {
 	Suff *s2;
+	char *srcName;
 
-	/* Null-terminate the source suffix in order to find it. */
-	/* XXX: don't modify strings, not even temporarily */
-	cp[1] = '\0';
-	s2 = FindSuffByName(transform->name);
-	cp[1] = s->name[0];		/* restore */
+	/* Copy the source suffix in order to find it.  The name of the
+	 * transformation is interned, so it must not be modified. */
+	srcName = bmake_strsedup(transform->name, cp + 1);
+	s2 = FindSuffByName(srcName);
+	free(srcName);
 
 	if (s2 != NULL) {
 	    /* establish the proper relationship */
@@ -741,8 +741,7 @@ SuffScanTargets(void *targetp, void *gsp)
 	    *gs->gnp = NULL;
 	    Targ_SetMain(NULL);
 	}
-	Lst_Free(target->children);
-	target->children = Lst_Init();
+	GNodeVec_Done(&target->children);
 	target->type = OP_TRANSFORM;
 	/*
 	 * link the two together in the proper relationship and order
@@ -1048,6 +1047,8 @@ SuffFindThem(SrcList *srcs, SrcList *slst)
     rs = NULL;
 
     while (!Lst_IsEmpty(srcs)) {
+	Hash_Key key;
+
 	s = Lst_Dequeue(srcs);
 
 	SUFF_DEBUG1("\ttrying %s...", s->file);
@@ -1056,7 +1057,8 @@ SuffFindThem(SrcList *srcs, SrcList *slst)
 	 * A file is considered to exist if either a node exists in the
 	 * graph for it or the file actually exists.
 	 */
-	if (Targ_FindNode(s->file) != NULL) {
+	Hash_InitKey(&key, s->file);
+	if (Targ_FindNodeKey(&key) != NULL) {
 #ifdef DEBUG_SRC
 	    debug_printf("remove %p from %p\n", s, srcs);
 #endif
@@ -1064,7 +1066,7 @@ SuffFindThem(SrcList *srcs, SrcList *slst)
 	    break;
 	}
 
-	if ((ptr = Dir_FindFile(s->file, s->suff->searchPath)) != NULL) {
+	if ((ptr = Dir_FindFileKey(&key, s->suff->searchPath)) != NULL) {
 	    rs = s;
 #ifdef DEBUG_SRC
 	    debug_printf("remove %p from %p\n", s, srcs);
@@ -1098,25 +1100,21 @@ SuffFindThem(SrcList *srcs, SrcList *slst)
 static Src *
 SuffFindCmds(Src *targ, SrcList *slst)
 {
-    GNodeListNode *gln;
+    unsigned int i;
     GNode *t;			/* Target GNode */
     GNode *s;			/* Source GNode */
     size_t prefLen;		/* The length of the defined prefix */
     Suff *suff;			/* Suffix on matching beastie */
     Src *ret;			/* Return value */
-    char *cp;
+    const char *cp;
 
     t = targ->node;
-    Lst_Open(t->children);
     prefLen = strlen(targ->pref);
 
-    for (;;) {
-	gln = Lst_Next(t->children);
-	if (gln == NULL) {
-	    Lst_Close(t->children);
+    for (i = 0;; i++) {
+	if (i >= t->children.len)
 	    return NULL;
-	}
-	s = LstNode_Datum(gln);
+	s = GNodeVec_Get(&t->children, i);
 
 	if (s->type & OP_OPTIONAL && Lst_IsEmpty(t->commands)) {
 	    /*
@@ -1180,7 +1178,6 @@ SuffFindCmds(Src *targ, SrcList *slst)
 #endif
     Lst_Append(slst, ret);
     SUFF_DEBUG1("\tusing existing source %s\n", s->name);
-    Lst_Close(t->children);
     return ret;
 }
 
@@ -1189,25 +1186,30 @@ SuffFindCmds(Src *targ, SrcList *slst)
  *
  * The expanded node is removed from the parent's list of children, and the
  * parent's unmade counter is decremented, but other nodes may be added.
+ * They are inserted in place of the expanded node.
  *
  * Input:
- *	cln		Child to examine
+ *	ci		Index of the child to examine
  *	pgn		Parent node being processed
+ *
+ * Results:
+ *	The index of the next child to examine.
  */
-static void
-SuffExpandChildren(GNodeListNode *cln, GNode *pgn)
+static unsigned int
+SuffExpandChildren(unsigned int ci, GNode *pgn)
 {
-    GNode *cgn = LstNode_Datum(cln);
+    GNode *cgn = GNodeVec_Get(&pgn->children, ci);
     GNode *gn;			/* New source 8) */
     char *cp;			/* Expanded value */
 
-    if (!Lst_IsEmpty(cgn->order_pred) || !Lst_IsEmpty(cgn->order_succ))
+    if (!GNodeVec_IsEmpty(&cgn->order_pred) ||
+	!GNodeVec_IsEmpty(&cgn->order_succ))
 	/* It is all too hard to process the result of .ORDER */
-	return;
+	return ci + 1;
 
     if (cgn->type & OP_WAIT)
 	/* Ignore these (& OP_PHONY ?) */
-	return;
+	return ci + 1;
 
     /*
      * First do variable expansion -- this takes precedence over
@@ -1215,10 +1217,8 @@ SuffExpandChildren(GNodeListNode *cln, GNode *pgn)
      * to later since the resulting words are tacked on to the end of
      * the children list.
      */
-    if (strchr(cgn->name, '$') == NULL) {
-	SuffExpandWildcards(cln, pgn);
-	return;
-    }
+    if (strchr(cgn->name, '$') == NULL)
+	return SuffExpandWildcards(ci, pgn);
 
     SUFF_DEBUG1("Expanding \"%s\"...", cgn->name);
     (void)Var_Subst(cgn->name, pgn, VARE_UNDEFERR|VARE_WANTRES, &cp);
@@ -1322,11 +1322,11 @@ SuffExpandChildren(GNodeListNode *cln, GNode *pgn)
 
 	    SUFF_DEBUG1("%s...", gn->name);
 	    /* Add gn to the parents child list before the original child */
-	    Lst_InsertBefore(pgn->children, cln, gn);
-	    Lst_Append(gn->parents, pgn);
+	    GNodeVec_Insert(&pgn->children, ci, gn);
+	    GNodeVec_Append(&gn->parents, pgn);
 	    pgn->unmade++;
 	    /* Expand wildcards on new node */
-	    SuffExpandWildcards(cln->prev, pgn);
+	    ci = SuffExpandWildcards(ci, pgn);
 	}
 	Lst_Free(members);
 
@@ -1343,18 +1343,21 @@ SuffExpandChildren(GNodeListNode *cln, GNode *pgn)
      * keep it from being processed.
      */
     pgn->unmade--;
-    Lst_Remove(pgn->children, cln);
-    Lst_Remove(cgn->parents, Lst_FindDatum(cgn->parents, pgn));
+    GNodeVec_Remove(&pgn->children, ci);
+    GNodeVec_RemoveNode(&cgn->parents, pgn);
+    return ci;
 }
 
-static void
-SuffExpandWildcards(GNodeListNode *cln, GNode *pgn)
+/* Expand the wildcards in the name of a child of the given node, like
+ * SuffExpandChildren. */
+static unsigned int
+SuffExpandWildcards(unsigned int ci, GNode *pgn)
 {
-    GNode *cgn = LstNode_Datum(cln);
+    GNode *cgn = GNodeVec_Get(&pgn->children, ci);
     StringList *explist;
 
     if (!Dir_HasWildcards(cgn->name))
-	return;
+	return ci + 1;
 
     /*
      * Expand the word along the chosen path
@@ -1373,9 +1376,10 @@ SuffExpandWildcards(GNodeListNode *cln, GNode *pgn)
 	gn = Targ_GetNode(cp);
 
 	/* Add gn to the parents child list before the original child */
-	Lst_InsertBefore(pgn->children, cln, gn);
-	Lst_Append(gn->parents, pgn);
+	GNodeVec_Insert(&pgn->children, ci, gn);
+	GNodeVec_Append(&gn->parents, pgn);
 	pgn->unmade++;
+	ci++;
     }
 
     Lst_Free(explist);
@@ -1387,8 +1391,17 @@ SuffExpandWildcards(GNodeListNode *cln, GNode *pgn)
      * keep it from being processed.
      */
     pgn->unmade--;
-    Lst_Remove(pgn->children, cln);
-    Lst_Remove(cgn->parents, Lst_FindDatum(cgn->parents, pgn));
+    GNodeVec_Remove(&pgn->children, ci);
+    GNodeVec_RemoveNode(&cgn->parents, pgn);
+    return ci;
+}
+
+/* Expand the children of the node, starting at the given index. */
+static void
+SuffExpandChildrenFrom(GNode *gn, unsigned int i)
+{
+    while (i < gn->children.len)
+	i = SuffExpandChildren(i, gn);
 }
 
 /* Find a path along which to expand the node.
@@ -1453,15 +1466,16 @@ Suff_FindPath(GNode* gn)
 static Boolean
 SuffApplyTransform(GNode *tGn, GNode *sGn, Suff *t, Suff *s)
 {
-    GNodeListNode *ln, *nln;    /* General node */
+    GNodeListNode *ln;		/* General node */
+    unsigned int numChildren;
     char *tname;		/* Name of transformation rule */
     GNode *gn;			/* Node for same */
 
     /*
      * Form the proper links between the target and source.
      */
-    Lst_Append(tGn->children, sGn);
-    Lst_Append(sGn->parents, tGn);
+    GNodeVec_Append(&tGn->children, sGn);
+    GNodeVec_Append(&sGn->parents, tGn);
     tGn->unmade++;
 
     /*
@@ -1487,7 +1501,7 @@ SuffApplyTransform(GNode *tGn, GNode *sGn, Suff *t, Suff *s)
     /*
      * Record last child for expansion purposes
      */
-    ln = Lst_Last(tGn->children);
+    numChildren = tGn->children.len;
 
     /*
      * Pass the buck to Make_HandleUse to apply the rule
@@ -1497,16 +1511,13 @@ SuffApplyTransform(GNode *tGn, GNode *sGn, Suff *t, Suff *s)
     /*
      * Deal with wildcards and variables in any acquired sources
      */
-    for (ln = ln != NULL ? ln->next : NULL; ln != NULL; ln = nln) {
-	nln = ln->next;
-	SuffExpandChildren(ln, tGn);
-    }
+    SuffExpandChildrenFrom(tGn, numChildren);
 
     /*
      * Keep track of another parent to which this beast is transformed so
      * the .IMPSRC variable can be set correctly for the parent.
      */
-    Lst_Append(sGn->implicitParents, tGn);
+    GNodeVec_Append(&sGn->implicitParents, tGn);
 
     return TRUE;
 }
@@ -1523,10 +1534,12 @@ SuffApplyTransform(GNode *tGn, GNode *sGn, Suff *t, Suff *s)
 static void
 SuffFindArchiveDeps(GNode *gn, SrcList *slst)
 {
-    char *eoarch;		/* End of archive portion */
-    char *eoname;		/* End of member portion */
+    const char *eoarch;		/* End of archive portion */
+    const char *eoname;		/* End of member portion */
+    const char *fullName;	/* The name of the archive(member) pair */
+    const char *archName;	/* The name of the archive, interned */
     GNode *mem;			/* Node for member */
-    SuffListNode *ln, *nln;	/* Next suffix node to check */
+    SuffListNode *ln;		/* Next suffix node to check */
     Suff *ms;			/* Suffix descriptor for member */
     char *name;			/* Start of member's name */
 
@@ -1544,10 +1557,17 @@ SuffFindArchiveDeps(GNode *gn, SrcList *slst)
     assert(eoarch != NULL);
     assert(eoname != NULL);
 
-    *eoname = '\0';	  /* Nuke parentheses during suffix search */
-    *eoarch = '\0';	  /* So a suffix can be found */
-
-    name = eoarch + 1;
+    /*
+     * Use only the archive name during the suffix search.  Since gn->name
+     * is interned and shared, it must not be modified in place, and the
+     * name that replaces it must be interned as well.
+     */
+    fullName = gn->name;
+    name = bmake_strsedup(fullName, eoarch);
+    archName = Hash_Intern(name);
+    free(name);
+    name = bmake_strsedup(eoarch + 1, eoname);
+    gn->name = archName;
 
     /*
      * To simplify things, call Suff_FindDeps recursively on the member now,
@@ -1562,8 +1582,8 @@ SuffFindArchiveDeps(GNode *gn, SrcList *slst)
     /*
      * Create the link between the two nodes right off
      */
-    Lst_Append(gn->children, mem);
-    Lst_Append(mem->parents, gn);
+    GNodeVec_Append(&gn->children, mem);
+    GNodeVec_Append(&mem->parents, gn);
     gn->unmade++;
 
     /*
@@ -1602,10 +1622,7 @@ SuffFindArchiveDeps(GNode *gn, SrcList *slst)
      * Now we've got the important local variables set, expand any sources
      * that still contain variables or wildcards in their names.
      */
-    for (ln = Lst_First(gn->children); ln != NULL; ln = nln) {
-	nln = ln->next;
-	SuffExpandChildren(ln, gn);
-    }
+    SuffExpandChildrenFrom(gn, 0);
 
     if (ms != NULL) {
 	/*
@@ -1619,8 +1636,8 @@ SuffFindArchiveDeps(GNode *gn, SrcList *slst)
 	/*
 	 * Use first matching suffix...
 	 */
-	sd.name_len = (size_t)(eoarch - gn->name);
-	sd.name_end = eoarch;
+	sd.name_len = (size_t)(eoarch - fullName);
+	sd.name_end = archName + sd.name_len;
 	ln = Lst_Find(ms->parents, SuffSuffIsSuffix, &sd);
 
 	if (ln != NULL) {
@@ -1636,10 +1653,10 @@ SuffFindArchiveDeps(GNode *gn, SrcList *slst)
     }
 
     /*
-     * Replace the opening and closing parens now we've no need of the separate
-     * pieces.
+     * Restore the full name now we've no need of the separate pieces.
      */
-    *eoarch = '('; *eoname = ')';
+    gn->name = fullName;
+    free(name);
 
     /*
      * Pretend gn appeared to the left of a dependency operator so
@@ -1669,16 +1686,16 @@ SuffFindArchiveDeps(GNode *gn, SrcList *slst)
 static void
 SuffFindNormalDeps(GNode *gn, SrcList *slst)
 {
-    char *eoname;		/* End of name */
-    char *sopref;		/* Start of prefix */
-    SuffListNode *ln, *nln;
+    const char *eoname;		/* End of name */
+    const char *sopref;		/* Start of prefix */
+    SuffListNode *ln;
     SrcList *srcs;		/* List of sources at which to look */
     SrcList *targs;		/* List of targets to which things can be
 				 * transformed. They all have the same file,
 				 * but different suff and pref fields */
     Src *bottom;		/* Start of found transformation path */
     Src *src;			/* General Src pointer */
-    char *pref;			/* Prefix to use */
+    const char *pref;		/* Prefix to use */
     Src *targ;			/* General Src target pointer */
     struct SuffSuffGetSuffixArgs sd; /* Search string data */
 
@@ -1832,10 +1849,7 @@ SuffFindNormalDeps(GNode *gn, SrcList *slst)
      * Now we've got the important local variables set, expand any sources
      * that still contain variables or wildcards in their names.
      */
-    for (ln = Lst_First(gn->children); ln != NULL; ln = nln) {
-	nln = ln->next;
-	SuffExpandChildren(ln, gn);
-    }
+    SuffExpandChildrenFrom(gn, 0);
 
     if (targ == NULL) {
 	SUFF_DEBUG1("\tNo valid suffix on %s\n", gn->name);
@@ -1848,12 +1862,11 @@ sfnd_abort:
 	 * children or commands) as the old pmake did.
 	 */
 	if ((gn->type & (OP_PHONY|OP_NOPATH)) == 0) {
-	    free(gn->path);
-	    gn->path = Dir_FindFile(gn->name,
-				    (targ == NULL ? dirSearchPath :
-				     targ->suff->searchPath));
+	    Targ_SetPath(gn, Dir_FindFile(gn->name,
+					  (targ == NULL ? dirSearchPath :
+					   targ->suff->searchPath)));
 	    if (gn->path != NULL) {
-		char *ptr;
+		const char *ptr;
 		Var_Set(TARGET, gn->path, gn);
 
 		if (targ != NULL) {
@@ -1862,24 +1875,21 @@ sfnd_abort:
 		     * the path to form the proper .PREFIX variable.
 		     */
 		    size_t savep = strlen(gn->path) - targ->suff->nameLen;
-		    char    savec;
+		    char *pref;
 
 		    if (gn->suffix)
 			gn->suffix->refCount--;
 		    gn->suffix = targ->suff;
 		    gn->suffix->refCount++;
 
-		    savec = gn->path[savep];
-		    gn->path[savep] = '\0';
-
-		    if ((ptr = strrchr(gn->path, '/')) != NULL)
+		    pref = bmake_strldup(gn->path, savep);
+		    if ((ptr = strrchr(pref, '/')) != NULL)
 			ptr++;
 		    else
-			ptr = gn->path;
+			ptr = pref;
 
 		    Var_Set(PREFIX, ptr, gn);
-
-		    gn->path[savep] = savec;
+		    free(pref);
 		} else {
 		    /*
 		     * The .PREFIX gets the full path if the target has
@@ -1913,7 +1923,7 @@ sfnd_abort:
     /*
      * Check for overriding transformation rule implied by sources
      */
-    if (!Lst_IsEmpty(gn->children)) {
+    if (!GNodeVec_IsEmpty(&gn->children)) {
 	src = SuffFindCmds(targ, slst);
 
 	if (src != NULL) {
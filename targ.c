@@ -108,6 +108,10 @@
  *			Should be called after the makefiles are parsed
  *			but before any action is taken.
  *
+ *	GNodeVec_Append, GNodeVec_Insert, GNodeVec_Remove,
+ *	GNodeVec_RemoveNode, GNodeVec_IndexOf
+ *			Maintain the arrays of edges between the nodes.
+ *
  * Debugging:
  *	Targ_PrintGraph
  *			Print out the entire graphm all variables and
@@ -137,7 +141,7 @@ void
 Targ_Init(void)
 {
     allTargets = Lst_Init();
-    Hash_InitTable(&targets);
+    Hash_InitTableInterned(&targets);
 }
 
 void
@@ -156,6 +160,8 @@ void
 Targ_Stats(void)
 {
     Hash_DebugStats(&targets, "targets");
+    /* Most of the interned strings are target names and paths. */
+    Hash_InternStats();
 }
 
 /* Return the list of all targets. */
@@ -176,8 +182,8 @@ Targ_NewGN(const char *name)
 {
     GNode *gn;
 
-    gn = bmake_malloc(sizeof(GNode));
-    gn->name = bmake_strdup(name);
+    gn = bmake_arena_alloc(sizeof(GNode));
+    gn->name = Hash_Intern(name);
     gn->uname = NULL;
     gn->path = NULL;
     gn->type = name[0] == '-' && name[1] == 'l' ? OP_LIB : 0;
@@ -190,13 +196,14 @@ Targ_NewGN(const char *name)
     gn->checked = 0;
     gn->mtime = 0;
     gn->cmgn = NULL;
-    gn->implicitParents = Lst_Init();
-    gn->cohorts = Lst_Init();
-    gn->parents = Lst_Init();
-    gn->children = Lst_Init();
-    gn->order_pred = Lst_Init();
-    gn->order_succ = Lst_Init();
-    Hash_InitTable(&gn->context);
+    GNodeVec_Init(&gn->implicitParents);
+    GNodeVec_Init(&gn->cohorts);
+    GNodeVec_Init(&gn->parents);
+    GNodeVec_Init(&gn->children);
+    GNodeVec_Init(&gn->order_pred);
+    GNodeVec_Init(&gn->order_succ);
+    memset(gn->localVars, 0, sizeof gn->localVars);
+    Hash_InitTableInterned(&gn->context);
     gn->commands = Lst_Init();
     gn->suffix = NULL;
     gn->fname = NULL;
@@ -217,25 +224,30 @@ TargFreeGN(void *gnp)
 {
     GNode *gn = (GNode *)gnp;
 
-    free(gn->name);
-    free(gn->uname);
-    free(gn->path);
-
-    Lst_Free(gn->implicitParents);
-    Lst_Free(gn->cohorts);
-    Lst_Free(gn->parents);
-    Lst_Free(gn->children);
-    Lst_Free(gn->order_succ);
-    Lst_Free(gn->order_pred);
+    GNodeVec_Done(&gn->implicitParents);
+    GNodeVec_Done(&gn->cohorts);
+    GNodeVec_Done(&gn->parents);
+    GNodeVec_Done(&gn->children);
+    GNodeVec_Done(&gn->order_succ);
+    GNodeVec_Done(&gn->order_pred);
     Hash_DeleteTable(&gn->context);
     Lst_Free(gn->commands);
 
     /* XXX: does gn->suffix need to be freed? It is reference-counted. */
 
-    free(gn);
+    /* The node itself is in the arena. */
 }
 #endif
 
+/* Set the path of the node to the interned copy of the given path, which
+ * is then freed.  A NULL path clears the path of the node. */
+void
+Targ_SetPath(GNode *gn, char *path)
+{
+    gn->path = path != NULL ? Hash_Intern(path) : NULL;
+    free(path);
+}
+
 /* Get the existing global node, or return NULL. */
 GNode *
 Targ_FindNode(const char *name)
@@ -243,6 +255,14 @@ Targ_FindNode(const char *name)
     return Hash_FindValue(&targets, name);
 }
 
+/* Get the existing global node for the already hashed name, or return
+ * NULL. */
+GNode *
+Targ_FindNodeKey(const Hash_Key *name)
+{
+    return Hash_FindValueKey(&targets, name);
+}
+
 /* Get the existing global node, or create it. */
 GNode *
 Targ_GetNode(const char *name)
@@ -335,20 +355,20 @@ Targ_SetMain(GNode *gn)
 }
 
 static void
-PrintNodeNames(GNodeList *gnodes)
+PrintNodeNames(GNodeVec *gnodes)
 {
-    GNodeListNode *node;
+    unsigned int i;
 
-    for (node = gnodes->first; node != NULL; node = node->next) {
-	GNode *gn = node->datum;
+    for (i = 0; i < gnodes->len; i++) {
+	GNode *gn = GNodeVec_Get(gnodes, i);
 	debug_printf(" %s%s", gn->name, gn->cohort_num);
     }
 }
 
 static void
-PrintNodeNamesLine(const char *label, GNodeList *gnodes)
+PrintNodeNamesLine(const char *label, GNodeVec *gnodes)
 {
-    if (Lst_IsEmpty(gnodes))
+    if (GNodeVec_IsEmpty(gnodes))
 	return;
     debug_printf("# %s:", label);
     PrintNodeNames(gnodes);
@@ -462,14 +482,14 @@ Targ_PrintNode(GNode *gn, int pass)
 		    debug_printf("# unmade\n");
 		}
 	    }
-	    PrintNodeNamesLine("implicit parents", gn->implicitParents);
+	    PrintNodeNamesLine("implicit parents", &gn->implicitParents);
 	} else {
 	    if (gn->unmade)
 		debug_printf("# %d unmade children\n", gn->unmade);
 	}
-	PrintNodeNamesLine("parents", gn->parents);
-	PrintNodeNamesLine("order_pred", gn->order_pred);
-	PrintNodeNamesLine("order_succ", gn->order_succ);
+	PrintNodeNamesLine("parents", &gn->parents);
+	PrintNodeNamesLine("order_pred", &gn->order_pred);
+	PrintNodeNamesLine("order_succ", &gn->order_succ);
 
 	debug_printf("%-16s", gn->name);
 	switch (gn->type & OP_OPMASK) {
@@ -481,12 +501,14 @@ Targ_PrintNode(GNode *gn, int pass)
 	    debug_printf("::"); break;
 	}
 	Targ_PrintType(gn->type);
-	PrintNodeNames(gn->children);
+	PrintNodeNames(&gn->children);
 	debug_printf("\n");
 	Targ_PrintCmds(gn);
 	debug_printf("\n\n");
 	if (gn->type & OP_DOUBLEDEP) {
-	    Targ_PrintNodes(gn->cohorts, pass);
+	    unsigned int i;
+	    for (i = 0; i < gn->cohorts.len; i++)
+		Targ_PrintNode(GNodeVec_Get(&gn->cohorts, i), pass);
 	}
     }
 }
@@ -548,7 +570,8 @@ Targ_PrintGraph(int pass)
 void
 Targ_Propagate(void)
 {
-    GNodeListNode *pn, *cn;
+    GNodeListNode *pn;
+    unsigned int i;
 
     for (pn = allTargets->first; pn != NULL; pn = pn->next) {
 	GNode *pgn = pn->datum;
@@ -556,10 +579,95 @@ Targ_Propagate(void)
 	if (!(pgn->type & OP_DOUBLEDEP))
 	    continue;
 
-	for (cn = pgn->cohorts->first; cn != NULL; cn = cn->next) {
-	    GNode *cgn = cn->datum;
+	for (i = 0; i < pgn->cohorts.len; i++) {
+	    GNode *cgn = GNodeVec_Get(&pgn->cohorts, i);
 
 	    cgn->type |= pgn->type & ~OP_OPMASK;
 	}
     }
 }
+
+void
+GNodeVec_Init(GNodeVec *v)
+{
+    v->items = v->inl;
+    v->len = 0;
+    v->cap = GNODEVEC_INLINE;
+}
+
+/* Free the memory of the array, leaving it empty.  The nodes themselves are
+ * not affected. */
+void
+GNodeVec_Done(GNodeVec *v)
+{
+    if (v->items != v->inl)
+	free(v->items);
+    GNodeVec_Init(v);
+}
+
+static void
+GNodeVecGrow(GNodeVec *v)
+{
+    unsigned int cap = v->cap * 2;
+
+    if (v->items == v->inl) {
+	v->items = bmake_malloc(cap * sizeof v->items[0]);
+	memcpy(v->items, v->inl, v->len * sizeof v->items[0]);
+    } else
+	v->items = bmake_realloc(v->items, cap * sizeof v->items[0]);
+    v->cap = cap;
+}
+
+/* Add the node to the end of the array. */
+void
+GNodeVec_Append(GNodeVec *v, GNode *gn)
+{
+    if (v->len == v->cap)
+	GNodeVecGrow(v);
+    v->items[v->len++] = gn;
+}
+
+/* Insert the node before the given index, moving the following nodes one
+ * place up. */
+void
+GNodeVec_Insert(GNodeVec *v, unsigned int i, GNode *gn)
+{
+    assert(i <= v->len);
+    if (v->len == v->cap)
+	GNodeVecGrow(v);
+    memmove(v->items + i + 1, v->items + i,
+	    (v->len - i) * sizeof v->items[0]);
+    v->items[i] = gn;
+    v->len++;
+}
+
+/* Remove the node at the given index, keeping the order of the others. */
+void
+GNodeVec_Remove(GNodeVec *v, unsigned int i)
+{
+    assert(i < v->len);
+    v->len--;
+    memmove(v->items + i, v->items + i + 1,
+	    (v->len - i) * sizeof v->items[0]);
+}
+
+/* Remove the first occurrence of the node, if any. */
+void
+GNodeVec_RemoveNode(GNodeVec *v, const GNode *gn)
+{
+    int i = GNodeVec_IndexOf(v, gn);
+    if (i >= 0)
+	GNodeVec_Remove(v, (unsigned int)i);
+}
+
+/* Return the index of the first occurrence of the node, or -1. */
+int
+GNodeVec_IndexOf(const GNodeVec *v, const GNode *gn)
+{
+    unsigned int i;
+
+    for (i = 0; i < v->len; i++)
+	if (v->items[i] == gn)
+	    return (int)i;
+    return -1;
+}
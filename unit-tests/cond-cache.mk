@@ -0,0 +1,90 @@
+# $NetBSD$
+#
+# Tests for conditions that are evaluated more than once, such as in files
+# that are included several times.  Such a condition is only parsed the
+# first time; after that, only its variable expressions are evaluated
+# again.  The result must be the same as if the condition were parsed each
+# time.
+#
+# Conditions that contain the value of a .for iteration variable are not
+# cached, since their text differs in each iteration.  Therefore this file
+# includes itself, once for each value.
+
+.if !defined(SECTION)
+
+SECTION=	values
+.  for v in 1 0 x "" yes 3 abc
+V=	${v}
+.    include "${.PARSEDIR}/${.PARSEFILE}"
+.  endfor
+
+SECTION=	short-circuit
+.  for v in 1 0 1
+V=	${v}
+.    include "${.PARSEDIR}/${.PARSEFILE}"
+.  endfor
+
+SECTION=	for
+.  include "${.PARSEDIR}/${.PARSEFILE}"
+
+SECTION=	error
+.  for v in 1 0
+V=	${v}
+.    include "${.PARSEDIR}/${.PARSEFILE}"
+.  endfor
+
+all:
+	@:;
+
+.elif ${SECTION} == values
+
+# The same condition text, with different values of the variables.
+.  if ${V} == 1 || ${V:U} == "x"
+.    info ${V}: or
+.  endif
+.  if !empty(V) && (${V:M[0-9]} && ${V:M[0-9]} > 2 || ${V} == abc)
+.    info ${V}: and
+.  endif
+.  if !defined(NOPE) && ${V:Mx}
+.    info ${V}: not-empty
+.  endif
+
+.elif ${SECTION} == short-circuit
+
+# The right-hand side of || and && is only evaluated when it is needed,
+# even if it was not needed when the condition was seen first.
+.  if ${V} || ${echo "rhs of or" 1>&2 :L:sh}
+.  endif
+.  if !${V} && ${echo "rhs of and" 1>&2 :L:sh}
+.  endif
+
+.elif ${SECTION} == error
+
+# An error in a part of the condition that was skipped the first time is
+# still reported when that part is evaluated later.
+.  if ${V} || ${UNDEF} == 3
+.    info ${V}: undef
+.  endif
+
+.elif ${SECTION} == for
+
+# In the body of a .for loop, the conditions that don't contain the value
+# of an iteration variable are the same in each iteration, so they are
+# cached.  In nested loops, the values of the outer loop make the text of
+# the inner loop differ as well.
+INVARIANT=	1
+.MAKEFLAGS: -dc
+.  for i in 1 2
+.    if ${INVARIANT} == 1
+.    endif
+.    if ${i} == 1
+.    endif
+.    for j in a b
+.      if ${i} == 1
+.      endif
+.    endfor
+.  endfor
+.MAKEFLAGS: -d0
+
+.endif
+
@@ -38,5 +38,17 @@
 .error
 .endif
 
+# The result of exists() is remembered, but a file that has been created
+# by a shell command since then is found.
+TMPFILE:=	${TMPDIR:U/tmp}/cond-func-exists.${.MAKE.PID}
+.if exists(${TMPFILE})
+.error
+.endif
+_!=	touch ${TMPFILE}; echo
+.if !exists(${TMPFILE})
+.error
+.endif
+_!=	rm ${TMPFILE}; echo
+
 all:
 	@:;
@@ -2,8 +2,56 @@
 #
 # Tests for the .dinclude directive, which includes another file,
 # typically named .depend.
+#
+# Plain dependency lines, as generated by compilers, are handled without
+# expanding variables or looking for special targets.  All other lines are
+# parsed as usual.  Either way, the resulting dependencies are the same.
+
+TMPBASE?=	/tmp
+DIR=		${TMPBASE}/0b8d3c54-77f1-4a52-9d0e-3f6b1e24c8a7	# a random UUID
+_!=		rm -rf ${DIR}; mkdir -p ${DIR}; echo ok
+
+HEADER=		f.h
+
+all: main.o other.o dbl.o phony.o empty.o
+
+_!=	printf '%s\n' \
+	    'main.o: main.c a.h \' \
+	    '  b.h' \
+	    'main.o other.o:c.h' \
+	    'other.o  : ./d.h ../e.h' \
+	    'main.o: $${HEADER}' \
+	    'dbl.o:: g.h' \
+	    '	@echo $$@: $$>' \
+	    '.PHONY: phony.o' \
+	    'phony.o: h.h; @echo $$@: $$>' \
+	    'empty.o:' > ${DIR}/depend; echo ok
+.dinclude "${DIR}/depend"
+
+main.c a.h b.h c.h ./d.h ../e.h f.h g.h h.h: .MADE
+
+main.o other.o empty.o:
+	@echo ${.TARGET}: ${.ALLSRC}
+
+# The special .MAKE.DEPENDFILE.TARGET variable names a file that is read
+# like a .dinclude, but only when make first looks at the target.  The
+# files of targets that are not needed are never read.
+all: dep-main.o
+
+_!=	printf '%s\n' 'dep-main.o: dep-foo.o dep-main.h' \
+	    'dep-main.o: dep-main.c' > ${DIR}/dep-main.d; echo ok
+_!=	echo 'dep-foo.o: dep-foo.h' > ${DIR}/dep-foo.d; echo ok
+_!=	echo '.error dep-bar.d must not be read' > ${DIR}/dep-bar.d; echo ok
+
+# Only these object files have a dependency file.  For all other targets,
+# the expression is empty.
+.MAKE.DEPENDFILE.TARGET= ${.TARGET:Mdep-*.o:R:S,^,${DIR}/,:S,$,.d,}
+
+dep-main.o dep-foo.o dep-bar.o:
+	@echo ${.TARGET}: ${.ALLSRC}
 
-# TODO: Implementation
+dep-main.h dep-main.c dep-foo.h:
+	@echo make ${.TARGET}
 
-all:
-	@:;
+.END:
+	@rm -rf ${DIR}
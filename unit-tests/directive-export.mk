@@ -2,7 +2,14 @@
 #
 # Tests for the .export directive.
 
-# TODO: Implementation
+# A variable whose value contains expressions is expanded again for each
+# command, so the commands see its current value.
+CNT:=	${TMPDIR:U/tmp}/directive-export.${.MAKE.PID}
+_!=	echo 0 > ${CNT}; echo
+N=	${:!cat ${CNT}!}
+.export N
 
 all:
-	@:;
+	@echo $$N; echo 1 > ${CNT}
+	@echo $$N; echo 2 > ${CNT}
+	@echo $$N; rm ${CNT}
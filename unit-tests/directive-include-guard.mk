@@ -0,0 +1,72 @@
+# $NetBSD$
+#
+# Tests for files that protect themselves against multiple inclusion, by
+# wrapping their whole content in a single conditional.  Once such a file
+# has been read and its guard condition has become false, including it
+# again has no effect, therefore the file is not even opened.
+#
+# To demonstrate this, some of the files are removed after they have been
+# included for the first time.  Including them again still works.
+
+TMPBASE?=	/tmp
+DIR=		${TMPBASE}/c6e7a3f2-4d2b-4b6e-a5d1-7e1c2f0b9a84	# a random UUID
+_!=		rm -rf ${DIR}; mkdir -p ${DIR}; echo ok
+
+# A guard using .ifndef.
+_!=	printf '%s\n' \
+	    '\# comment' \
+	    '.ifndef GUARD_IFNDEF' \
+	    'GUARD_IFNDEF=' \
+	    '.info reading ifndef.mk' \
+	    '.endif' \
+	    '\# comment' > ${DIR}/ifndef.mk; echo ok
+.include "${DIR}/ifndef.mk"
+_!=	rm ${DIR}/ifndef.mk; echo ok
+.include "${DIR}/ifndef.mk"
+
+# A guard using !target, with the name of the file in the guard target.
+_!=	printf '%s\n' \
+	    '.if !target(__$${.PARSEFILE}__)' \
+	    '__$${.PARSEFILE}__: .NOTMAIN' \
+	    '.info reading target.mk' \
+	    '.endif' > ${DIR}/target.mk; echo ok
+.include "${DIR}/target.mk"
+_!=	rm ${DIR}/target.mk; echo ok
+.include "${DIR}/target.mk"
+
+# When the guard condition becomes true again, the file is read again.
+_!=	printf '%s\n' \
+	    '.if !defined(GUARD_DEFINED)' \
+	    'GUARD_DEFINED=' \
+	    '.info reading defined.mk' \
+	    '.endif' > ${DIR}/defined.mk; echo ok
+.include "${DIR}/defined.mk"
+.include "${DIR}/defined.mk"
+.undef GUARD_DEFINED
+.include "${DIR}/defined.mk"
+
+# If there is anything after the guard, the file is read each time.
+_!=	printf '%s\n' \
+	    '.ifndef GUARD_AFTER' \
+	    'GUARD_AFTER=' \
+	    '.endif' \
+	    '.info reading after.mk' > ${DIR}/after.mk; echo ok
+.include "${DIR}/after.mk"
+.include "${DIR}/after.mk"
+
+# The same applies to an .else branch, no matter whether it is skipped or
+# taken.
+_!=	printf '%s\n' \
+	    '.ifndef GUARD_ELSE' \
+	    'GUARD_ELSE=' \
+	    '.else' \
+	    '.info reading the .else branch of else.mk' \
+	    '.endif' > ${DIR}/else.mk; echo ok
+.include "${DIR}/else.mk"
+.include "${DIR}/else.mk"
+.include "${DIR}/else.mk"
+
+_!=		rm -rf ${DIR}; echo ok
+
+all:
+	@:;
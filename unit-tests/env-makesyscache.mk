@@ -0,0 +1,60 @@
+# $NetBSD$
+#
+# Tests for the MAKESYSCACHE environment variable, which names a directory
+# for snapshots of the state after reading the system makefile.  Later runs
+# of make replay the snapshot instead of reading sys.mk again.
+
+TMPBASE?=	/tmp
+DIR=		${TMPBASE}/2b0e6c8a-6a4e-4f53-9d4e-0c7b3b1f8f2a	# a random UUID
+_!=		rm -rf ${DIR}; mkdir -p ${DIR}/mk ${DIR}/cache; echo ok
+
+# The system makefile sets variables, runs a command, includes another
+# file, defines a suffix transformation, exports a variable and adds a
+# command to a target.  Each time the command is actually run, it appends
+# a line to the log.
+_!=	{ \
+	  echo 'SYS_VAR=	sys'; \
+	  echo 'SYS_CMD!=	echo run >> ${DIR}/log; echo cmd'; \
+	  echo '.include "inc.mk"'; \
+	  echo '.SUFFIXES: .in .out'; \
+	  echo '.in.out:'; \
+	  echo '	@echo transform $$@'; \
+	  echo 'SYS_EXPORTED=	exported'; \
+	  echo '.export SYS_EXPORTED'; \
+	  echo '.if exists(${DIR}/flag)'; \
+	  echo 'SYS_FLAG=	yes'; \
+	  echo '.endif'; \
+	  echo '.info reading sys.mk'; \
+	  echo '.-include "${DIR}/abs/local.mk"'; \
+	  echo '.-include "sub/local.mk"'; \
+	} > ${DIR}/mk/sys.mk; echo ok
+_!=	echo 'SYS_INC=	inc' > ${DIR}/mk/inc.mk; echo ok
+_!=	{ \
+	  echo 'all: file.out'; \
+	  echo '	@echo $${SYS_VAR} $${SYS_CMD} $${SYS_INC} $${SYS_FLAG:Uno}'; \
+	  echo '	@echo $$$$SYS_EXPORTED'; \
+	  echo '	@wc -l < ${DIR}/log'; \
+	} > ${DIR}/Makefile; echo ok
+_!=	> ${DIR}/file.in; echo ok
+
+RUN=	cd ${DIR} && MAKEFLAGS= MAKESYSCACHE=${DIR}/cache ${.MAKE} -m ${DIR}/mk
+
+all:
+	@echo 'The first run records the snapshot.'
+	@${RUN} 2>&1 | sed 's,${DIR}/,,'
+	@echo 'The second run replays it.'
+	@${RUN} 2>&1 | sed 's,${DIR}/,,'
+	@echo 'A changed file is read again.'
+	@echo '# changed' >> ${DIR}/mk/inc.mk
+	@${RUN} 2>&1 | sed 's,${DIR}/,,'
+	@echo 'So is a changed result of exists().'
+	@> ${DIR}/flag
+	@${RUN} 2>&1 | sed 's,${DIR}/,,'
+	@${RUN} 2>&1 | sed 's,${DIR}/,,'
+	@echo 'So is a makefile that was not found before.'
+	@${RUN} -V LOCAL 2>&1 | sed 's,${DIR}/,,'
+	@mkdir ${DIR}/abs; echo 'LOCAL+= abs' > ${DIR}/abs/local.mk
+	@${RUN} -V LOCAL 2>&1 | sed 's,${DIR}/,,'
+	@mkdir ${DIR}/sub; echo 'LOCAL+= sub' > ${DIR}/sub/local.mk
+	@${RUN} -V LOCAL 2>&1 | sed 's,${DIR}/,,'
+	@rm -rf ${DIR}
@@ -2,7 +2,22 @@
 #
 # Tests for target-local variables, such as ${.TARGET} or $@.
 
-# TODO: Implementation
+# The local variables are only defined while the commands of a target are
+# run.  In the global context, they are undefined.
+.if defined(.TARGET) || defined(@)
+.  error
+.endif
 
-all:
-	@:;
+all: local-vars local-vars.o
+
+# Each target has its own set of local variables.  The long names are
+# aliases for the short names.
+local-vars local-vars.o: var-class-local.mk
+	@echo $@ ${.TARGET} $> ${.ALLSRC} ${.PREFIX} ${.MEMBER:Uundefined}
+
+# The variables .ALLSRC and .OODATE are computed on their first use, even
+# if that is in a later command of the target.
+all: lazy-allsrc
+lazy-allsrc: var-class-local.mk
+	@echo $@
+	@echo ${.OODATE} $>
@@ -63,6 +63,27 @@ all: mod-regex-errors
 .error
 .endif
 
+# Patterns without special characters, apart from the anchors '^' and '$',
+# are matched without calling regexec.  They must behave the same.
+.if ${:Uaxa xax:C,x,<&>,g} != "a<x>a <x>a<x>"
+.error
+.endif
+.if ${:Uxx axx:C,^x,y,g} != "yx axx"
+.error
+.endif
+.if ${:Uxx xax:C,x$,y,} != "xy xay"
+.error
+.endif
+.if ${:Ux xx:C,^x$,y,} != "y xx"
+.error
+.endif
+.if ${:Uab cd:C,^,<,g:C,$,>,} != "<ab> <cd>"
+.error
+.endif
+.if ${:U1 2 1:C,1,x,1} != "x 2 1"
+.error
+.endif
+
 # Multiple asterisks form an invalid regular expression.  This produces an
 # error message and (as of 2020-08-28) stops parsing in the middle of the
 # variable expression.  The unparsed part of the expression is then copied
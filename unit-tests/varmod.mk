@@ -48,4 +48,65 @@ DOLLAR2=	${:U\$}
 .  error
 .endif
 
+# Modifiers that do not contain nested expressions are parsed only once and
+# are then cached.  Evaluating the same modifiers again must give the same
+# results as parsing them each time.
+#
+# See ApplyModifiers and ModChain_TextLen.
+FILES=		a.c b.o c.c
+.for i in 1 2 3
+.  if ${FILES:S/./_/:S,_,<&>,:M*c} != "a<_>c c<_>c"
+.    error
+.  endif
+.endfor
+
+# The :S modifier with the '1' flag replaces only the first match, each time
+# the modifier is evaluated.
+FIRST=		aaa
+SECOND=		bab
+.if ${FIRST:S/a/x/1} != "xaa" || ${SECOND:S/a/x/1} != "bxb"
+.  error
+.endif
+
+# The closing brace is part of the cached text since it influences how the
+# modifiers are parsed.
+PAREN=		a)b}c
+.if ${PAREN:S,),_,} != "a_b}c" || $(PAREN:S,},_,) != "a)b_c"
+.  error
+.endif
+
+# Consecutive word modifiers pass the words on to the next modifier, without
+# joining them into a string in between.  If a modifier produces words that
+# Str_Words would split differently, the words are joined and the value is
+# split again.
+#
+# See ModifyWords and ApplyModifiersState_Words.
+.if ${:Ua.c b.c a.c:M*.c:T:R:S/^/obj\//:O:u} != "obj/a obj/b"
+.  error
+.endif
+.if ${:Ua b:S/a/x y/:[#]} != "3"
+.  error
+.endif
+.if ${:Ua b:S/a/"x y"/:[#]} != "2"
+.  error
+.endif
+.if ${:Ua b:ts,:S/a/x/:[#]} != "1"
+.  error
+.endif
+.if ${:Ua b c:N*b*:[#]} != "2"
+.  error
+.endif
+# Str_Words splits an empty string into a single empty word.
+.if ${:Ua:N*:[#]} != "1"
+.  error
+.endif
+# Taking the last part of a quoted word leaves an unclosed quote.
+.if ${:U"a/b c":T:[#]} != "2"
+.  error
+.endif
+# After sorting, the word with the unclosed quote comes first.
+.if ${:Ua 'b c:O:[#]} != "1"
+.  error
+.endif
+
 all: # nothing
@@ -0,0 +1,78 @@
+# $NetBSD$
+#
+# Tests for the special .MAKE.SHELL_CACHE variable, which caches the output
+# of shell commands on disk.
+
+TMPBASE?=	/tmp
+CACHE=		${TMPBASE}/bd9e32a1-4b8f-4c55-8f1d-57a3c43e5d69	# a random UUID
+_!=		rm -rf ${CACHE}; mkdir -p ${CACHE}; echo ok
+
+# Each time the command is actually run, it appends a line to the log.
+RUN=		echo run >> ${CACHE}/log; echo output
+
+# The cache is only used while .MAKE.SHELL_CACHE is set, so that it can be
+# enabled for selected assignments.  The number of runs is counted without
+# the cache.
+.MAKE.SHELL_CACHE=	${CACHE}
+FIRST!=		${RUN}
+SECOND!=	${RUN}
+.undef .MAKE.SHELL_CACHE
+.info ${FIRST} ${SECOND}, runs: ${:!cat ${CACHE}/log!:[#]}
+
+# The :sh modifier uses the same cache.
+.MAKE.SHELL_CACHE=	${CACHE}
+THIRD:=		${RUN:sh}
+.undef .MAKE.SHELL_CACHE
+.info ${THIRD}, runs: ${:!cat ${CACHE}/log!:[#]}
+
+# The environment variables from .MAKE.SHELL_CACHE.ENV are part of the key.
+.MAKE.SHELL_CACHE=	${CACHE}
+.MAKE.SHELL_CACHE.ENV=	SHELL_CACHE_TEST
+SHELL_CACHE_TEST=	value
+.export SHELL_CACHE_TEST
+FOURTH!=	${RUN}
+FIFTH!=		${RUN}
+.undef .MAKE.SHELL_CACHE
+.info ${FOURTH} ${FIFTH}, runs: ${:!cat ${CACHE}/log!:[#]}
+
+# So are the modification times of the files from .MAKE.SHELL_CACHE.FILES.
+.MAKE.SHELL_CACHE=	${CACHE}
+.MAKE.SHELL_CACHE.FILES=	${CACHE}/missing
+SIXTH!=		${RUN}
+.undef .MAKE.SHELL_CACHE
+.info ${SIXTH}, runs: ${:!cat ${CACHE}/log!:[#]}
+
+# Commands that fail are not cached.
+.MAKE.SHELL_CACHE=	${CACHE}
+FAIL!=		echo run >> ${CACHE}/log; false
+FAIL!=		echo run >> ${CACHE}/log; false
+.undef .MAKE.SHELL_CACHE
+.info runs: ${:!cat ${CACHE}/log!:[#]}
+
+# The values of the environment variables are taken from the environment
+# that the command gets, which includes the variables that are only
+# exported to the child processes, since their values contain expressions.
+.MAKE.SHELL_CACHE=	${CACHE}
+.MAKE.SHELL_CACHE.ENV=	SHELL_CACHE_EXPR
+SHELL_CACHE_EXPR=	${SHELL_CACHE_VALUE}
+.export SHELL_CACHE_EXPR
+SHELL_CACHE_VALUE=	one
+EXPR1!=		echo $$SHELL_CACHE_EXPR
+SHELL_CACHE_VALUE=	two
+EXPR2!=		echo $$SHELL_CACHE_EXPR
+.undef .MAKE.SHELL_CACHE
+.info ${EXPR1} ${EXPR2}
+
+# The current working directory is part of the key, since the output of
+# many commands depends on it, for example in sub-makes.
+_!=		mkdir ${CACHE}/a ${CACHE}/b; echo ok
+.for dir in a b
+PWD.${dir}!=	cd ${CACHE}/${dir} && ${MAKE} -r -f /dev/null \
+		    .MAKE.SHELL_CACHE=${CACHE} -V '$${:!pwd!}'
+.endfor
+.info ${PWD.a:T} ${PWD.b:T}
+
+_!=		rm -rf ${CACHE}; echo ok
+
+all:
+	@:;
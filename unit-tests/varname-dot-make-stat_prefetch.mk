@@ -0,0 +1,43 @@
+# $NetBSD$
+#
+# Tests for the special .MAKE.STAT_PREFETCH variable, which looks up the
+# modification times of the files in the dependency graph in several
+# processes at once.  The targets that are out of date are the same as
+# without it.
+
+TMPBASE?=	/tmp
+DIR=		${TMPBASE}/9e27c1b4-5a3f-4d86-8b10-7c6e2f4a9d53	# a random UUID
+
+.if ${STEP:U} == build
+
+.MAKE.STAT_PREFETCH=	3
+
+all: ${DIR}/old.o ${DIR}/new.o
+
+${DIR}/old.o: ${DIR}/old.c ${DIR}/old-sub.h
+${DIR}/new.o: ${DIR}/new.c
+${DIR}/old.o ${DIR}/new.o:
+	@echo make ${.TARGET:T} from ${.OODATE:T}
+
+.else
+
+_!=		rm -rf ${DIR}; mkdir -p ${DIR}; echo ok
+_!=		cd ${DIR} && touch -t 202001010000 old.c new.o old-sub.h && \
+		touch -t 202101010000 new.c old.o && echo ok
+
+# The debug log shows each time that is stored in the cache as "Caching".
+# All 5 files are looked up by the prefetch.  When the dependency graph is
+# examined afterwards, and when it is decided whether the targets are out
+# of date, the times come from the cache.  Only the target that has been
+# made is looked up again, one after the other, as without prefetching.
+all:
+	@${MAKE} -r -f ${MAKEFILE} -dd STEP=build 2>&1 \
+	| sed -n -e '/^Prefetching/p' \
+	    -e 's,^ *Caching .* for ${DIR}/,Caching ,p' \
+	    -e 's,^Using \([a-z]*\) time .* for ${DIR}/,Using \1 time ,p' \
+	    -e '/^make /p'
+
+.END:
+	@rm -rf ${DIR}
+
+.endif
@@ -2,42 +2,54 @@
 #
 # Tests for special variables, such as .MAKE or .PARSEDIR.
 
-# These following MAGIC variables have the same hash code, at least with
-# the default hashing algorithm, which is the same as in Java.  The order
-# in which these variables are defined determines the order in which they
-# appear in the Hash_Table.  New entries are prepended to the bucket lists,
-# therefore this test numbers the values in descending order.
+# The following MAGIC variables come in pairs that have the same hash
+# code, so they compete for the same slots in the hash table, and looking
+# them up requires comparing the names themselves.  The names in the last
+# two pairs even differ in length.  Each variable must keep its own value,
+# no matter in which order the variables are defined, and must still be
+# found after the other variable of its pair has been deleted.
 
 .if defined(ORDER_01)
 
-MAGIC0a0a0a=	8
-MAGIC0a0a1B=	7
-MAGIC0a1B0a=	6
-MAGIC0a1B1B=	5
-MAGIC1B0a0a=	4
-MAGIC1B0a1B=	3
-MAGIC1B1B0a=	2
-MAGIC1B1B1B=	1
-
-all: # nothing
+MAGIC09e8d=	1
+MAGIC0b56e=	2
+MAGIC09e6e=	3
+MAGIC0b58d=	4
+MAGICb88=	5
+MAGIC21303=	6
+MAGICf6e9=	7
+MAGIC2550d=	8
 
 .elif defined(ORDER_10)
 
-MAGIC1B1B1B=	8
-MAGIC1B1B0a=	7
-MAGIC1B0a1B=	6
-MAGIC1B0a0a=	5
-MAGIC0a1B1B=	4
-MAGIC0a1B0a=	3
-MAGIC0a0a1B=	2
-MAGIC0a0a0a=	1
+MAGIC2550d=	8
+MAGICf6e9=	7
+MAGIC21303=	6
+MAGICb88=	5
+MAGIC0b58d=	4
+MAGIC09e6e=	3
+MAGIC0b56e=	2
+MAGIC09e8d=	1
+
+.endif
+
+.if defined(ORDER_01) || defined(ORDER_10)
+
+.  for name in MAGIC09e8d MAGIC0b56e MAGIC09e6e MAGIC0b58d \
+	MAGICb88 MAGIC21303 MAGICf6e9 MAGIC2550d
+.    info ${name} = ${${name}}
+.  endfor
+
+.undef MAGIC0b56e
+.undef MAGICb88
+.info ${MAGIC09e8d} ${MAGIC0b56e:Uundef} ${MAGICb88:Uundef} ${MAGIC21303}
 
 all: # nothing
 
 .else
 
 all:
-	@${.MAKE} -f ${MAKEFILE} -dg1 ORDER_01=yes
-	@${.MAKE} -f ${MAKEFILE} -dg1 ORDER_10=yes
+	@${.MAKE} -f ${MAKEFILE} ORDER_01=yes
+	@${.MAKE} -f ${MAKEFILE} ORDER_10=yes
 
 .endif
@@ -124,6 +124,7 @@
 #include    "dir.h"
 #include    "job.h"
 #include    "metachar.h"
+#include    "strlist.h"
 
 /*	"@(#)var.c	8.3 (Berkeley) 3/19/94" */
 MAKE_RCSID("$NetBSD: var.c,v 1.570 2020/10/06 08:13:27 rillig Exp $");
@@ -225,10 +226,12 @@ ENUM_FLAGS_RTTI_6(VarFlags,
  * There are 3 kinds of variables: context variables, environment variables,
  * undefined variables.
  *
- * Context variables are stored in a GNode.context.  The only way to undefine
- * a context variable is using the .undef directive.  In particular, it must
- * not be possible to undefine a variable during the evaluation of an
- * expression, or Var.name might point nowhere.
+ * Context variables are stored in a GNode.context, except for the local
+ * variables of a target, which have fixed slots in GNode.localVars, see
+ * VarLocalIndex.  The only way to undefine a context variable is using the
+ * .undef directive.  In particular, it must not be possible to undefine a
+ * variable during the evaluation of an expression, or Var.name might point
+ * nowhere.
  *
  * Environment variables are temporary.  They are returned by VarFind, and
  * after using them, they must be freed using VarFreeEnv.
@@ -238,7 +241,8 @@ ENUM_FLAGS_RTTI_6(VarFlags,
  */
 typedef struct Var {
     /* The name of the variable, once set, doesn't change anymore.
-     * For context variables, it aliases the corresponding Hash_Entry name.
+     * For context variables, it aliases the corresponding Hash_Entry name,
+     * or one of localVarNames.
      * For environment and undefined variables, it is allocated. */
     const char *name;
     void *name_freeIt;
@@ -258,6 +262,37 @@ typedef enum {
 
 static VarExportedMode var_exportedVars = VAR_EXPORTED_NONE;
 
+/*
+ * The environment for the child processes.  Rather than exporting the
+ * variables in each child again, it is built once in the parent and reused
+ * until a global variable or the environment of the process changes.
+ * Only the variables whose values are literal are reused though, the others
+ * may expand differently each time, for example by running a command.
+ */
+typedef struct ChildEnv {
+    Boolean valid;
+    /* The overridden variables, in the form "name=value", in the order in
+     * which setenv would have added them.  The info is set while merging. */
+    strlist_t vars;
+    /* The names of the exported variables that are expanded again for
+     * each child. */
+    strlist_t exprs;
+    /* The environment, for passing it to execve. */
+    char **env;
+} ChildEnv;
+
+static ChildEnv childEnv;
+
+/*
+ * A snapshot of the environment of the process, mapping the names to the
+ * values, so that looking up an environment variable doesn't need to scan
+ * environ.  It is loaded in Var_Init and kept in sync with the changes that
+ * make itself does to its environment, see Var_Setenv.
+ */
+static Hash_Table envVars;
+
+extern char **environ;
+
 typedef enum {
     /*
      * We pass this to Var_Export when doing the initial export
@@ -291,35 +326,12 @@ VarNew(const char *name, void *name_freeIt, const char *value, VarFlags flags)
     return var;
 }
 
-/*-
- *-----------------------------------------------------------------------
- * VarFind --
- *	Find the given variable in the given context and any other contexts
- *	indicated.
- *
- * Input:
- *	name		name to find
- *	ctxt		context in which to find it
- *	flags		FIND_GLOBAL	look in VAR_GLOBAL as well
- *			FIND_CMD	look in VAR_CMD as well
- *			FIND_ENV	look in the environment as well
- *
- * Results:
- *	A pointer to the structure describing the desired variable or
- *	NULL if the variable does not exist.
- *-----------------------------------------------------------------------
- */
-static Var *
-VarFind(const char *name, GNode *ctxt, VarFindFlags flags)
+/* If the variable name begins with a '.', it could very well be one of the
+ * local ones.  Return the short version of the name if it matches one of
+ * them, otherwise the name itself. */
+static const char *
+CanonicalVarname(const char *name)
 {
-    Var *var;
-
-    /*
-     * If the variable name begins with a '.', it could very well be one of
-     * the local ones.  We check the name against all the local variables
-     * and substitute the short version in for 'name' if it matches one of
-     * them.
-     */
     if (*name == '.' && ch_isupper(name[1])) {
 	switch (name[1]) {
 	case 'A':
@@ -363,38 +375,120 @@ VarFind(const char *name, GNode *ctxt, VarFindFlags flags)
 	name = ALLSRC;
 #endif
 
+    return name;
+}
+
+/* The indexes of the variables in GNode.localVars. */
+enum {
+    VAR_LOCAL_TARGET,
+    VAR_LOCAL_OODATE,
+    VAR_LOCAL_ALLSRC,
+    VAR_LOCAL_IMPSRC,
+    VAR_LOCAL_PREFIX,
+    VAR_LOCAL_ARCHIVE,
+    VAR_LOCAL_MEMBER
+};
+
+/* The names of the variables in GNode.localVars. */
+static const char *const localVarNames[GNODE_LOCALVARS] = {
+    TARGET, OODATE, ALLSRC, IMPSRC, PREFIX, ARCHIVE, MEMBER
+};
+
+/* Return the index in GNode.localVars of a target-local variable such as
+ * TARGET or ALLSRC, or -1 if the variable is stored in the context's hash
+ * table.  The global contexts store all variables in their hash table, so
+ * that they can be enumerated. */
+static int
+VarLocalIndex(GNode *ctxt, const char *name, size_t len)
+{
+    if (len != 1 || ctxt == VAR_GLOBAL || ctxt == VAR_CMD ||
+	ctxt == VAR_INTERNAL)
+	return -1;
+
+    switch (name[0]) {
+    case '@':
+	return VAR_LOCAL_TARGET;
+    case '?':
+	return VAR_LOCAL_OODATE;
+    case '>':
+	return VAR_LOCAL_ALLSRC;
+    case '<':
+	return VAR_LOCAL_IMPSRC;
+    case '*':
+	return VAR_LOCAL_PREFIX;
+    case '!':
+	return VAR_LOCAL_ARCHIVE;
+    case '%':
+	return VAR_LOCAL_MEMBER;
+    default:
+	return -1;
+    }
+}
+
+/*-
+ *-----------------------------------------------------------------------
+ * VarFindKey --
+ *	Find the given variable in the given context and any other contexts
+ *	indicated.  The name has already been hashed and canonicalized, so
+ *	that it is hashed only once for all the contexts.
+ *
+ * Input:
+ *	key		name to find
+ *	ctxt		context in which to find it
+ *	flags		FIND_GLOBAL	look in VAR_GLOBAL as well
+ *			FIND_CMD	look in VAR_CMD as well
+ *			FIND_ENV	look in the environment as well
+ *
+ * Results:
+ *	A pointer to the structure describing the desired variable or
+ *	NULL if the variable does not exist.
+ *-----------------------------------------------------------------------
+ */
+static Var *
+VarFindKey(const Hash_Key *key, GNode *ctxt, VarFindFlags flags)
+{
+    Var *var;
+    int i;
+
     /*
      * First look for the variable in the given context. If it's not there,
      * look for it in VAR_CMD, VAR_GLOBAL and the environment, in that order,
-     * depending on the FIND_* flags in 'flags'
+     * depending on the FIND_* flags in 'flags'.  The ALLSRC and OODATE
+     * variables of a target are only computed when they are needed.
      */
-    var = Hash_FindValue(&ctxt->context, name);
+    i = VarLocalIndex(ctxt, key->str, key->len);
+    if (i == VAR_LOCAL_OODATE || i == VAR_LOCAL_ALLSRC)
+	Make_ForceAllVar(ctxt);
+    var = i >= 0 ? ctxt->localVars[i] : Hash_FindValueKey(&ctxt->context, key);
 
     if (var == NULL && (flags & FIND_CMD) && ctxt != VAR_CMD)
-	var = Hash_FindValue(&VAR_CMD->context, name);
+	var = Hash_FindValueKey(&VAR_CMD->context, key);
 
     if (!checkEnvFirst && var == NULL && (flags & FIND_GLOBAL) &&
 	ctxt != VAR_GLOBAL)
     {
-	var = Hash_FindValue(&VAR_GLOBAL->context, name);
+	var = Hash_FindValueKey(&VAR_GLOBAL->context, key);
 	if (var == NULL && ctxt != VAR_INTERNAL) {
 	    /* VAR_INTERNAL is subordinate to VAR_GLOBAL */
-	    var = Hash_FindValue(&VAR_INTERNAL->context, name);
+	    var = Hash_FindValueKey(&VAR_INTERNAL->context, key);
 	}
     }
 
     if (var == NULL && (flags & FIND_ENV)) {
-	char *env;
+	const char *env;
 
-	if ((env = getenv(name)) != NULL) {
-	    char *varname = bmake_strdup(name);
+	env = Hash_FindValueKey(&envVars, key);
+	if (Snapshot_Recording())
+	    Snapshot_Env(key->str, env);
+	if (env != NULL) {
+	    char *varname = bmake_strldup(key->str, key->len);
 	    return VarNew(varname, varname, env, VAR_FROM_ENV);
 	}
 
 	if (checkEnvFirst && (flags & FIND_GLOBAL) && ctxt != VAR_GLOBAL) {
-	    var = Hash_FindValue(&VAR_GLOBAL->context, name);
+	    var = Hash_FindValueKey(&VAR_GLOBAL->context, key);
 	    if (var == NULL && ctxt != VAR_INTERNAL)
-		var = Hash_FindValue(&VAR_INTERNAL->context, name);
+		var = Hash_FindValueKey(&VAR_INTERNAL->context, key);
 	    return var;
 	}
 
@@ -404,6 +498,17 @@ VarFind(const char *name, GNode *ctxt, VarFindFlags flags)
     return var;
 }
 
+/* Find the given variable in the given context and any other contexts
+ * indicated, see VarFindKey. */
+static Var *
+VarFind(const char *name, GNode *ctxt, VarFindFlags flags)
+{
+    Hash_Key key;
+
+    Hash_InitKey(&key, CanonicalVarname(name));
+    return VarFindKey(&key, ctxt, flags);
+}
+
 /*-
  *-----------------------------------------------------------------------
  * VarFreeEnv  --
@@ -428,15 +533,99 @@ VarFreeEnv(Var *v, Boolean destroy)
     return TRUE;
 }
 
+/* The environment of the process or the export status of a variable has
+ * changed, so the environment for the child processes needs to be built
+ * again. */
+static void
+VarEnvChanged(void)
+{
+    childEnv.valid = FALSE;
+}
+
+/* Load the snapshot of the environment from environ. */
+static void
+VarEnvLoad(void)
+{
+    Hash_Search search;
+    Hash_Entry *he;
+    char **ep;
+
+    for (he = Hash_EnumFirst(&envVars, &search); he != NULL;
+	 he = Hash_EnumNext(&search))
+	free(Hash_GetValue(he));
+    Hash_DeleteTable(&envVars);
+    Hash_InitTable(&envVars);
+
+    for (ep = environ; *ep != NULL; ep++) {
+	const char *eq = strchr(*ep, '=');
+	Hash_Key key;
+
+	if (eq == NULL || eq == *ep)
+	    continue;
+	Hash_InitKeyLen(&key, *ep, (size_t)(eq - *ep));
+	he = Hash_CreateEntryKey(&envVars, &key, NULL);
+	/* Like getenv, the first of several duplicate entries wins. */
+	if (Hash_GetValue(he) == NULL)
+	    Hash_SetValue(he, bmake_strdup(eq + 1));
+    }
+    VarEnvChanged();
+}
+
+/* Set the variable in the environment of the process, which is inherited
+ * by the child processes. */
+void
+Var_Setenv(const char *name, const char *val)
+{
+    Hash_Entry *he;
+
+    setenv(name, val, 1);
+    he = Hash_CreateEntry(&envVars, name, NULL);
+    free(Hash_GetValue(he));
+    Hash_SetValue(he, bmake_strdup(val));
+    VarEnvChanged();
+}
+
+/* Remove the variable from the environment of the process. */
+static void
+VarUnsetenv(const char *name)
+{
+    Hash_Entry *he;
+
+    unsetenv(name);
+    he = Hash_FindEntry(&envVars, name);
+    if (he != NULL) {
+	free(Hash_GetValue(he));
+	Hash_DeleteEntry(&envVars, he);
+    }
+    VarEnvChanged();
+}
+
+/* A variable has been set to the value, or deleted if val is NULL. */
+static void
+VarChanged(GNode *ctxt, const char *name, const char *val)
+{
+    if (ctxt == VAR_GLOBAL || ctxt == VAR_CMD || ctxt == VAR_INTERNAL) {
+	childEnv.valid = FALSE;
+	if (Snapshot_Recording())
+	    Snapshot_Var(ctxt, name, val);
+    }
+}
+
 /* Add a new variable of the given name and value to the given context.
  * The name and val arguments are duplicated so they may safely be freed. */
 static void
 VarAdd(const char *name, const char *val, GNode *ctxt, VarSet_Flags flags)
 {
-    Hash_Entry *he = Hash_CreateEntry(&ctxt->context, name, NULL);
-    Var *v = VarNew(he->name, NULL, val,
-		      flags & VAR_SET_READONLY ? VAR_READONLY : 0);
-    Hash_SetValue(he, v);
+    VarFlags vflags = flags & VAR_SET_READONLY ? VAR_READONLY : 0;
+    int i = VarLocalIndex(ctxt, name, strlen(name));
+
+    if (i >= 0)
+	ctxt->localVars[i] = VarNew(localVarNames[i], NULL, val, vflags);
+    else {
+	Hash_Entry *he = Hash_CreateEntry(&ctxt->context, name, NULL);
+	Hash_SetValue(he, VarNew(he->name, NULL, val, vflags));
+    }
+    VarChanged(ctxt, name, val);
     if (!(ctxt->flags & INTERNAL)) {
 	VAR_DEBUG3("%s:%s = %s\n", ctxt->name, name, val);
     }
@@ -447,41 +636,82 @@ void
 Var_Delete(const char *name, GNode *ctxt)
 {
     char *name_freeIt = NULL;
-    Hash_Entry *he;
+    Hash_Entry *he = NULL;
+    Var *v;
+    int i;
 
     if (strchr(name, '$') != NULL) {
 	(void)Var_Subst(name, VAR_GLOBAL, VARE_WANTRES, &name_freeIt);
 	/* TODO: handle errors */
 	name = name_freeIt;
     }
-    he = Hash_FindEntry(&ctxt->context, name);
+    i = VarLocalIndex(ctxt, name, strlen(name));
+    if (i >= 0)
+	v = ctxt->localVars[i];
+    else {
+	he = Hash_FindEntry(&ctxt->context, name);
+	v = he != NULL ? Hash_GetValue(he) : NULL;
+    }
     VAR_DEBUG3("%s:delete %s%s\n",
-	       ctxt->name, name, he != NULL ? "" : " (not found)");
+	       ctxt->name, name, v != NULL ? "" : " (not found)");
     free(name_freeIt);
 
-    if (he != NULL) {
-	Var *v = (Var *)Hash_GetValue(he);
+    if (v != NULL) {
 	if (v->flags & VAR_EXPORTED)
-	    unsetenv(v->name);
+	    VarUnsetenv(v->name);
 	if (strcmp(v->name, MAKE_EXPORTED) == 0)
 	    var_exportedVars = VAR_EXPORTED_NONE;
 	assert(v->name_freeIt == NULL);
-	Hash_DeleteEntry(&ctxt->context, he);
+	VarChanged(ctxt, v->name, NULL);
+	if (he != NULL)
+	    Hash_DeleteEntry(&ctxt->context, he);
+	else
+	    ctxt->localVars[i] = NULL;
 	Buf_Destroy(&v->val, TRUE);
 	free(v);
     }
 }
 
 
+/* Set the variable in the environment for the child processes. */
+static void
+ChildEnv_Set(ChildEnv *ce, const char *name, const char *val)
+{
+    size_t namelen = strlen(name);
+    char *str;
+    unsigned int i;
+
+    STRLIST_FOREACH(str, &ce->vars, i) {
+	if (strncmp(str, name, namelen) == 0 && str[namelen] == '=') {
+	    free(str);
+	    strlist_str(&ce->vars, i) = str_concat3(name, "=", val);
+	    return;
+	}
+    }
+    strlist_add_str(&ce->vars, str_concat3(name, "=", val), 0);
+}
+
+/* Set the variable in the environment for the child processes, or in the
+ * environment of the process if there is no ChildEnv. */
+static void
+VarSetenv(ChildEnv *ce, const char *name, const char *val)
+{
+    if (ce != NULL)
+	ChildEnv_Set(ce, name, val);
+    else
+	Var_Setenv(name, val);
+}
+
 /*
  * Export a single variable.
  * We ignore make internal variables (those which start with '.').
  * Also we jump through some hoops to avoid calling setenv
  * more than necessary since it can leak.
- * We only manipulate flags of vars if 'parent' is set.
+ * We only manipulate flags of vars if 'parent' is set, otherwise the
+ * variable is added to the environment 'ce' for the child processes.
  */
 static Boolean
-Var_Export1(const char *name, VarExportFlags flags)
+Var_Export1(const char *name, VarExportFlags flags, ChildEnv *ce)
 {
     VarExportFlags parent = flags & VAR_EXPORT_PARENT;
     Var *v;
@@ -538,38 +768,81 @@ Var_Export1(const char *name, VarExportFlags flags)
 	expr = str_concat3("${", name, "}");
 	(void)Var_Subst(expr, VAR_GLOBAL, VARE_WANTRES, &val);
 	/* TODO: handle errors */
-	setenv(name, val, 1);
+	VarSetenv(ce, name, val);
+	if (ce != NULL)
+	    strlist_add_str(&ce->exprs, bmake_strdup(name), 0);
 	free(val);
 	free(expr);
     } else {
-	if (parent)
+	if (parent) {
 	    v->flags &= ~(unsigned)VAR_REEXPORT;	/* once will do */
-	if (parent || !(v->flags & VAR_EXPORTED))
-	    setenv(name, val, 1);
+	    Var_Setenv(name, val);
+	} else if (!(v->flags & VAR_EXPORTED))
+	    VarSetenv(ce, name, val);
     }
     /*
      * This is so Var_Set knows to call Var_Export again...
      */
     if (parent) {
 	v->flags |= VAR_EXPORTED;
+	VarEnvChanged();
     }
     return TRUE;
 }
 
 static void
-Var_ExportVars_callback(void *entry, void *unused MAKE_ATTR_UNUSED)
+Var_ExportVars_callback(void *entry, void *data)
 {
     Var *var = entry;
-    Var_Export1(var->name, 0);
+    Var_Export1(var->name, 0, data);
 }
 
-/*
- * This gets called from our children.
- */
-void
-Var_ExportVars(void)
+/* Merge the process environment with the variables that are only exported
+ * to the child processes, like setenv would do. */
+static void
+ChildEnv_Merge(ChildEnv *ce)
+{
+    size_t n, i, j;
+    char *str;
+    unsigned int k;
+
+    STRLIST_FOREACH(str, &ce->vars, k)
+	strlist_set_info(&ce->vars, k, 0);
+    for (n = 0; environ[n] != NULL; n++)
+	continue;
+    free(ce->env);
+    ce->env = bmake_malloc((n + strlist_num(&ce->vars) + 1) * sizeof(char *));
+
+    j = 0;
+    for (i = 0; i < n; i++) {
+	const char *eq = strchr(environ[i], '=');
+	size_t namelen = eq != NULL ? (size_t)(eq - environ[i]) : 0;
+
+	ce->env[j] = environ[i];
+	STRLIST_FOREACH(str, &ce->vars, k) {
+	    if (strlist_info(&ce->vars, k) == 0 && namelen > 0 &&
+		strncmp(str, environ[i], namelen + 1) == 0) {
+		strlist_set_info(&ce->vars, k, 1);
+		ce->env[j] = str;
+		break;
+	    }
+	}
+	j++;
+    }
+    STRLIST_FOREACH(str, &ce->vars, k)
+	if (strlist_info(&ce->vars, k) == 0)
+	    ce->env[j++] = str;
+    ce->env[j] = NULL;
+}
+
+static void
+ChildEnv_Build(ChildEnv *ce)
 {
     char *val;
+    char tmp[BUFSIZ];
+
+    strlist_clean(&ce->vars);
+    strlist_clean(&ce->exprs);
 
     /*
      * Several make's support this sort of mechanism for tracking
@@ -577,30 +850,82 @@ Var_ExportVars(void)
      * We allow the makefiles to update MAKELEVEL and ensure
      * children see a correctly incremented value.
      */
-    char tmp[BUFSIZ];
     snprintf(tmp, sizeof(tmp), "%d", makelevel + 1);
-    setenv(MAKE_LEVEL_ENV, tmp, 1);
-
-    if (var_exportedVars == VAR_EXPORTED_NONE)
-	return;
+    ChildEnv_Set(ce, MAKE_LEVEL_ENV, tmp);
 
     if (var_exportedVars == VAR_EXPORTED_ALL) {
 	/* Ouch! This is crazy... */
-	Hash_ForEach(&VAR_GLOBAL->context, Var_ExportVars_callback, NULL);
-	return;
+	Hash_ForEach(&VAR_GLOBAL->context, Var_ExportVars_callback, ce);
+    } else if (var_exportedVars == VAR_EXPORTED_YES) {
+	(void)Var_Subst("${" MAKE_EXPORTED ":O:u}", VAR_GLOBAL, VARE_WANTRES,
+			&val);
+	/* TODO: handle errors */
+	if (*val) {
+	    Words words = Str_Words(val, FALSE);
+	    size_t i;
+
+	    for (i = 0; i < words.len; i++)
+		Var_Export1(words.words[i], 0, ce);
+	    Words_Free(words);
+	}
+	free(val);
     }
 
-    (void)Var_Subst("${" MAKE_EXPORTED ":O:u}", VAR_GLOBAL, VARE_WANTRES, &val);
-    /* TODO: handle errors */
-    if (*val) {
-	Words words = Str_Words(val, FALSE);
-	size_t i;
+    ChildEnv_Merge(ce);
+}
 
-	for (i = 0; i < words.len; i++)
-	    Var_Export1(words.words[i], 0);
-	Words_Free(words);
+/* Expand the exported variables that are not literal again. */
+static void
+ChildEnv_Refresh(ChildEnv *ce)
+{
+    char *name;
+    unsigned int i;
+
+    STRLIST_FOREACH(name, &ce->exprs, i) {
+	char *expr = str_concat3("${", name, "}");
+	char *val;
+
+	(void)Var_Subst(expr, VAR_GLOBAL, VARE_WANTRES, &val);
+	/* TODO: handle errors */
+	ChildEnv_Set(ce, name, val);
+	free(val);
+	free(expr);
     }
-    free(val);
+    ChildEnv_Merge(ce);
+}
+
+/*
+ * Return the environment for our children, for passing it to execve.
+ *
+ * The environment is cached until the next change to the global variables
+ * or the environment of the process, see VarEnvChanged.  The variables
+ * whose values contain expressions are expanded again each time.  If
+ * expanding an exported variable runs a shell command, that command gets an
+ * environment of its own, which is not cached.
+ */
+char **
+Var_ExportVars(void)
+{
+    static Boolean building = FALSE;
+    static ChildEnv nestedEnv;
+
+    if (building) {
+	ChildEnv_Build(&nestedEnv);
+	return nestedEnv.env;
+    }
+    if (!childEnv.valid) {
+	building = TRUE;
+	ChildEnv_Build(&childEnv);
+	building = FALSE;
+	/* Expanding the exported variables may have changed some. */
+	childEnv.valid = TRUE;
+    } else if (strlist_num(&childEnv.exprs) > 0) {
+	building = TRUE;
+	ChildEnv_Refresh(&childEnv);
+	building = FALSE;
+	childEnv.valid = TRUE;
+    }
+    return childEnv.env;
 }
 
 /*
@@ -640,7 +965,7 @@ Var_Export(const char *str, Boolean isExport)
 	size_t i;
 	for (i = 0; i < words.len; i++) {
 	    const char *name = words.words[i];
-	    if (Var_Export1(name, flags)) {
+	    if (Var_Export1(name, flags, NULL)) {
 		if (var_exportedVars != VAR_EXPORTED_ALL)
 		    var_exportedVars = VAR_EXPORTED_YES;
 		if (isExport && (flags & VAR_EXPORT_PARENT)) {
@@ -654,8 +979,6 @@ Var_Export(const char *str, Boolean isExport)
 }
 
 
-extern char **environ;
-
 /*
  * This is called when .unexport[-env] is seen.
  *
@@ -695,6 +1018,7 @@ Var_UnExport(const char *str)
 	newenv[1] = NULL;
 	if (cp && *cp)
 	    setenv(MAKE_LEVEL_ENV, cp, 1);
+	VarEnvLoad();
     } else {
 	cpp_skip_whitespace(&str);
 	if (str[0] != '\0')
@@ -725,7 +1049,7 @@ Var_UnExport(const char *str)
 	    VAR_DEBUG1("Unexporting \"%s\"\n", varname);
 	    if (!unexport_env && (v->flags & VAR_EXPORTED) &&
 		!(v->flags & VAR_REEXPORT))
-		unsetenv(v->name);
+		VarUnsetenv(v->name);
 	    v->flags &= ~(unsigned)(VAR_EXPORTED | VAR_REEXPORT);
 
 	    /*
@@ -750,6 +1074,7 @@ Var_UnExport(const char *str)
 	    free(varnames_freeIt);
 	}
     }
+    VarEnvChanged();
 }
 
 /* See Var_Set for documentation. */
@@ -813,10 +1138,11 @@ Var_Set_with_flags(const char *name, const char *val, GNode *ctxt,
 	Buf_Empty(&v->val);
 	if (val)
 	    Buf_AddStr(&v->val, val);
+	VarChanged(ctxt, name, val);
 
 	VAR_DEBUG3("%s:%s = %s\n", ctxt->name, name, val);
 	if (v->flags & VAR_EXPORTED) {
-	    Var_Export1(name, VAR_EXPORT_PARENT);
+	    Var_Export1(name, VAR_EXPORT_PARENT, NULL);
 	}
     }
     /*
@@ -838,7 +1164,7 @@ Var_Set_with_flags(const char *name, const char *val, GNode *ctxt,
 	 * Makefile settings.
 	 */
 	if (!varNoExportEnv)
-	    setenv(name, val ? val : "", 1);
+	    Var_Setenv(name, val ? val : "");
 
 	Var_Append(MAKEOVERRIDES, name, VAR_GLOBAL);
     }
@@ -933,6 +1259,7 @@ Var_Append(const char *name, const char *val, GNode *ctxt)
     } else if (ctxt == VAR_CMD || !(v->flags & VAR_FROM_CMD)) {
 	Buf_AddByte(&v->val, ' ');
 	Buf_AddStr(&v->val, val);
+	VarChanged(ctxt, name, Buf_GetAll(&v->val, NULL));
 
 	VAR_DEBUG3("%s:%s = %s\n",
 	    ctxt->name, name, Buf_GetAll(&v->val, NULL));
@@ -1066,6 +1393,69 @@ SepBuf_Destroy(SepBuf *buf, Boolean free_buf)
     return Buf_Destroy(&buf->buf, free_buf);
 }
 
+/* The value of an expression as a list of words, which a word modifier
+ * passes on to the next modifier instead of joining them into a string.
+ * The words are joined only when a modifier needs the value as a string,
+ * or at the end of the expression. */
+typedef struct WordList {
+    Words words;		/* words.words is NULL if there is no list */
+    char sep;			/* The separator for joining the words */
+    Boolean exact;		/* Whether these are the words that Str_Words
+				 * would split the joined value into */
+    Boolean simple;		/* Whether no word contains whitespace,
+				 * quotes or backslashes */
+    Boolean inPlace;		/* Whether the words follow each other in
+				 * words.freeIt, each followed by a single
+				 * byte where the separator belongs */
+} WordList;
+
+static void
+WordList_Init(WordList *wl)
+{
+    wl->words.words = NULL;
+    wl->words.len = 0;
+    wl->words.freeIt = NULL;
+    wl->sep = ' ';
+    wl->exact = FALSE;
+    wl->simple = FALSE;
+    wl->inPlace = FALSE;
+}
+
+static void
+WordList_Free(WordList *wl)
+{
+    Words_Free(wl->words);
+    WordList_Init(wl);
+}
+
+/* Join the words into a string, freeing the list. */
+static char *
+WordList_Join(WordList *wl)
+{
+    char *str;
+    size_t i;
+
+    if (wl->inPlace) {
+	for (i = 1; i < wl->words.len; i++)
+	    wl->words.words[i][-1] = wl->sep;
+	str = wl->words.freeIt;
+	wl->words.freeIt = NULL;
+    } else {
+	Buffer buf;
+
+	Buf_Init(&buf, 0);
+	for (i = 0; i < wl->words.len; i++) {
+	    if (i != 0)
+		Buf_AddByte(&buf, wl->sep);
+	    Buf_AddStr(&buf, wl->words.words[i]);
+	}
+	str = Buf_Destroy(&buf, FALSE);
+    }
+
+    WordList_Free(wl);
+    return str;
+}
+
 
 /* This callback for ModifyWords gets a single word from an expression and
  * typically adds a modification of this word to the buffer. It may also do
@@ -1339,8 +1729,183 @@ VarREError(int reerr, regex_t *pat, const char *str)
     free(errbuf);
 }
 
+/*
+ * A compiled pattern of the :C modifier.
+ *
+ * Patterns without special characters, apart from a leading '^' and a
+ * trailing '$', are matched using plain string comparison instead of
+ * regexec.
+ */
+typedef struct VarRegex {
+    struct VarRegex *prev;	/* The more recently used pattern */
+    struct VarRegex *next;	/* The less recently used pattern */
+    Hash_Entry *he;		/* The entry in regexCache */
+    Boolean isLiteral;
+    Boolean anchorStart;	/* Whether a literal pattern starts with '^' */
+    Boolean anchorEnd;		/* Whether a literal pattern ends with '$' */
+    const char *literal;	/* The literal text, without the anchors */
+    size_t literalLen;
+    size_t nsub;		/* The number of subexpressions, plus 1 */
+    regex_t re;			/* Only if !isLiteral */
+} VarRegex;
+
+#define VARREGEX_MAX	64
+
+/* The compiled patterns, keyed by the pattern text.  Since evaluating a
+ * :C modifier does not evaluate any other expressions, a pattern cannot
+ * be evicted while it is in use. */
+static Hash_Table regexCache;
+static VarRegex *regexFirst;	/* The most recently used pattern */
+static VarRegex *regexLast;	/* The least recently used pattern */
+static unsigned long regexHits;
+static unsigned long regexMisses;
+
+static void
+VarRegex_Unlink(VarRegex *rx)
+{
+    if (rx->prev != NULL)
+	rx->prev->next = rx->next;
+    else
+	regexFirst = rx->next;
+    if (rx->next != NULL)
+	rx->next->prev = rx->prev;
+    else
+	regexLast = rx->prev;
+}
+
+static void
+VarRegex_LinkFirst(VarRegex *rx)
+{
+    rx->prev = NULL;
+    rx->next = regexFirst;
+    if (regexFirst != NULL)
+	regexFirst->prev = rx;
+    else
+	regexLast = rx;
+    regexFirst = rx;
+}
+
+static void
+VarRegex_Free(VarRegex *rx)
+{
+    if (!rx->isLiteral)
+	regfree(&rx->re);
+    free(rx);
+}
+
+static void
+VarRegex_Evict(void)
+{
+    VarRegex *rx = regexLast;
+
+    VarRegex_Unlink(rx);
+    Hash_DeleteEntry(&regexCache, rx->he);
+    VarRegex_Free(rx);
+}
+
+/* See whether the pattern can be matched by plain string comparison. */
+static Boolean
+VarRegex_ParseLiteral(VarRegex *rx, const char *pattern)
+{
+    const char *p = pattern;
+    size_t len;
+
+    rx->anchorStart = *p == '^';
+    if (rx->anchorStart)
+	p++;
+    len = strcspn(p, "\\^$.[]|()*+?{}");
+    rx->anchorEnd = p[len] == '$' && p[len + 1] == '\0';
+    if (p[len] != '\0' && !rx->anchorEnd)
+	return FALSE;
+    if (len == 0 && !rx->anchorStart && !rx->anchorEnd)
+	return FALSE;
+
+    rx->literal = p;
+    rx->literalLen = len;
+    return TRUE;
+}
+
+/* Return the compiled pattern, or NULL after printing an error. */
+static VarRegex *
+VarRegex_Get(const char *pattern)
+{
+    Hash_Entry *he;
+    VarRegex *rx;
+    Boolean isNew;
+    int error;
+
+    he = Hash_CreateEntry(&regexCache, pattern, &isNew);
+    if (!isNew) {
+	regexHits++;
+	rx = Hash_GetValue(he);
+	if (rx != regexFirst) {
+	    VarRegex_Unlink(rx);
+	    VarRegex_LinkFirst(rx);
+	}
+	return rx;
+    }
+
+    regexMisses++;
+    rx = bmake_malloc(sizeof *rx);
+    rx->he = he;
+    rx->isLiteral = VarRegex_ParseLiteral(rx, he->name);
+    if (rx->isLiteral)
+	rx->nsub = 1;
+    else {
+	error = regcomp(&rx->re, pattern, REG_EXTENDED);
+	if (error) {
+	    VarREError(error, &rx->re, "Regex compilation error");
+	    Hash_DeleteEntry(&regexCache, he);
+	    free(rx);
+	    return NULL;
+	}
+	rx->nsub = rx->re.re_nsub + 1;
+    }
+
+    if (regexCache.numEntries > VARREGEX_MAX)
+	VarRegex_Evict();
+    Hash_SetValue(he, rx);
+    VarRegex_LinkFirst(rx);
+    return rx;
+}
+
+/* Match the pattern against the string, like regexec. */
+static int
+VarRegex_Exec(VarRegex *rx, const char *str, size_t nmatch, regmatch_t *m,
+	      int flags)
+{
+    const char *lit = rx->literal;
+    size_t len = rx->literalLen;
+    size_t start;
+
+    if (!rx->isLiteral)
+	return regexec(&rx->re, str, nmatch, m, flags);
+
+    if (rx->anchorStart) {
+	if ((flags & REG_NOTBOL) || strncmp(str, lit, len) != 0)
+	    return REG_NOMATCH;
+	if (rx->anchorEnd && str[len] != '\0')
+	    return REG_NOMATCH;
+	start = 0;
+    } else if (rx->anchorEnd) {
+	size_t strLen = strlen(str);
+	if (strLen < len || memcmp(str + strLen - len, lit, len) != 0)
+	    return REG_NOMATCH;
+	start = strLen - len;
+    } else {
+	const char *match = strstr(str, lit);
+	if (match == NULL)
+	    return REG_NOMATCH;
+	start = (size_t)(match - str);
+    }
+
+    m[0].rm_so = (regoff_t)start;
+    m[0].rm_eo = (regoff_t)(start + len);
+    return 0;
+}
+
 struct ModifyWord_SubstRegexArgs {
-    regex_t re;
+    VarRegex *rx;
     size_t nsub;
     char *replace;
     VarPatternFlags pflags;
@@ -1363,7 +1928,7 @@ ModifyWord_SubstRegex(const char *word, SepBuf *buf, void *data)
 	goto nosub;
 
 tryagain:
-    xrv = regexec(&args->re, wp, args->nsub, m, flags);
+    xrv = VarRegex_Exec(args->rx, wp, args->nsub, m, flags);
 
     switch (xrv) {
     case 0:
@@ -1417,7 +1982,7 @@ tryagain:
 	}
 	break;
     default:
-	VarREError(xrv, &args->re, "Unexpected regex error");
+	VarREError(xrv, &args->rx->re, "Unexpected regex error");
 	/* FALLTHROUGH */
     case REG_NOMATCH:
     nosub:
@@ -1467,61 +2032,55 @@ ModifyWord_Loop(const char *word, SepBuf *buf, void *data)
  * to scan the list backwards if first > last.
  */
 static char *
-VarSelectWords(char sep, Boolean oneBigWord, const char *str, int first,
-	       int last)
+VarSelectWords(char sep, const Words *words, int first, int last)
 {
-    Words words;
     int start, end, step;
     int i;
 
     SepBuf buf;
     SepBuf_Init(&buf, sep);
 
-    if (oneBigWord) {
-	/* fake what Str_Words() would do if there were only one word */
-	words.len = 1;
-	words.words = bmake_malloc((words.len + 1) * sizeof(char *));
-	words.freeIt = bmake_strdup(str);
-	words.words[0] = words.freeIt;
-	words.words[1] = NULL;
-    } else {
-	words = Str_Words(str, FALSE);
-    }
-
     /*
      * Now sanitize the given range.
      * If first or last are negative, convert them to the positive equivalents
      * (-1 gets converted to ac, -2 gets converted to (ac - 1), etc.).
      */
     if (first < 0)
-	first += (int)words.len + 1;
+	first += (int)words->len + 1;
     if (last < 0)
-	last += (int)words.len + 1;
+	last += (int)words->len + 1;
 
     /*
      * We avoid scanning more of the list than we need to.
      */
     if (first > last) {
-	start = MIN((int)words.len, first) - 1;
+	start = MIN((int)words->len, first) - 1;
 	end = MAX(0, last - 1);
 	step = -1;
     } else {
 	start = MAX(0, first - 1);
-	end = MIN((int)words.len, last);
+	end = MIN((int)words->len, last);
 	step = 1;
     }
 
     for (i = start; (step < 0) == (i >= end); i += step) {
-	SepBuf_AddStr(&buf, words.words[i]);
+	SepBuf_AddStr(&buf, words->words[i]);
 	SepBuf_Sep(&buf);
     }
 
-    Words_Free(words);
-
     return SepBuf_Destroy(&buf, FALSE);
 }
 
 
+/* Callback for ModifyWords to implement the :ts modifier.
+ * Add the word unchanged, with the new separator. */
+static void
+ModifyWord_Copy(const char *word, SepBuf *buf, void *data MAKE_ATTR_UNUSED)
+{
+    SepBuf_AddStr(buf, word);
+}
+
+
 /* Callback for ModifyWords to implement the :tA modifier.
  * Replace each word with the result of realpath() if successful. */
 static void
@@ -1537,87 +2096,6 @@ ModifyWord_Realpath(const char *word, SepBuf *buf, void *data MAKE_ATTR_UNUSED)
     SepBuf_AddStr(buf, word);
 }
 
-/*-
- *-----------------------------------------------------------------------
- * Modify each of the words of the passed string using the given function.
- *
- * Input:
- *	str		String whose words should be modified
- *	modifyWord	Function that modifies a single word
- *	modifyWord_args Custom arguments for modifyWord
- *
- * Results:
- *	A string of all the words modified appropriately.
- *-----------------------------------------------------------------------
- */
-static char *
-ModifyWords(GNode *ctx, char sep, Boolean oneBigWord, const char *str,
-	    ModifyWordsCallback modifyWord, void *modifyWord_args)
-{
-    SepBuf result;
-    Words words;
-    size_t i;
-
-    if (oneBigWord) {
-	SepBuf_Init(&result, sep);
-	modifyWord(str, &result, modifyWord_args);
-	return SepBuf_Destroy(&result, FALSE);
-    }
-
-    SepBuf_Init(&result, sep);
-
-    words = Str_Words(str, FALSE);
-
-    VAR_DEBUG2("ModifyWords: split \"%s\" into %zu words\n", str, words.len);
-
-    for (i = 0; i < words.len; i++) {
-	modifyWord(words.words[i], &result, modifyWord_args);
-	if (Buf_Len(&result.buf) > 0)
-	    SepBuf_Sep(&result);
-    }
-
-    Words_Free(words);
-
-    return SepBuf_Destroy(&result, FALSE);
-}
-
-
-static char *
-Words_JoinFree(Words words)
-{
-    Buffer buf;
-    size_t i;
-
-    Buf_Init(&buf, 0);
-
-    for (i = 0; i < words.len; i++) {
-	if (i != 0)
-	    Buf_AddByte(&buf, ' ');	/* XXX: st->sep, for consistency */
-	Buf_AddStr(&buf, words.words[i]);
-    }
-
-    Words_Free(words);
-
-    return Buf_Destroy(&buf, FALSE);
-}
-
-/* Remove adjacent duplicate words. */
-static char *
-VarUniq(const char *str)
-{
-    Words words = Str_Words(str, FALSE);
-
-    if (words.len > 1) {
-	size_t i, j;
-	for (j = 0, i = 1; i < words.len; i++)
-	    if (strcmp(words.words[i], words.words[j]) != 0 && (++j != i))
-		words.words[j] = words.words[i];
-	words.len = j + 1;
-    }
-
-    return Words_JoinFree(words);
-}
-
 
 /* Quote shell meta-characters and space characters in the string.
  * If quoteDollar is set, also quote and double any '$' characters. */
@@ -1798,6 +2276,39 @@ ENUM_FLAGS_RTTI_2(VarExprFlags,
 		  VEF_UNDEF, VEF_DEF);
 
 
+/*
+ * The modifiers of an expression, such as ":M*.c:S,.c,.o,:O:u", are cached
+ * after they have been parsed for the first time, provided that their text
+ * does not contain any nested expressions.  The cache records where each
+ * modifier ends, and for the word modifiers :M, :N and :S it also keeps the
+ * parsed arguments, so that these are not parsed again.  All other
+ * modifiers are cheap to parse and are simply parsed again.
+ */
+typedef struct ModStep {
+    size_t len;			/* The length of the modifier text */
+    ModifyWordsCallback callback; /* The callback for the pre-parsed word
+				 * modifiers, or NULL if the modifier is
+				 * parsed again each time. */
+    void *args;			/* The parsed arguments for the callback */
+    Boolean oneBigWord;		/* Whether :S treats the value as a single
+				 * word, see ApplyModifiersState */
+} ModStep;
+
+/* The maximum number of modifiers in a cached expression. */
+#define MODCHAIN_MAXSTEPS	16
+/* The maximum number of cached expressions. */
+#define MODCHAIN_MAXENTRIES	4096
+
+typedef struct ModChain {
+    unsigned int numSteps;
+    ModStep steps[1];		/* Actually numSteps elements */
+} ModChain;
+
+/* The cached modifiers, keyed by their text including the closing brace. */
+static Hash_Table modChains;
+static unsigned long modChainHits;
+static unsigned long modChainMisses;
+
 typedef struct ApplyModifiersState {
     const char startc;		/* '\0' or '{' or '(' */
     const char endc;		/* '\0' or '}' or ')' */
@@ -1806,9 +2317,11 @@ typedef struct ApplyModifiersState {
     const VarEvalFlags eflags;
 
     char *val;			/* The old value of the expression,
-				 * before applying the modifier, never NULL */
+				 * before applying the modifier, or NULL if
+				 * it is only available as words */
     char *newVal;		/* The new value of the expression,
-				 * after applying the modifier, never NULL */
+				 * after applying the modifier, or NULL if
+				 * the modifier left it as words */
     char sep;			/* Word separator in expansions
 				 * (see the :ts modifier) */
     Boolean oneBigWord;		/* TRUE if some modifiers that otherwise split
@@ -1816,8 +2329,173 @@ typedef struct ApplyModifiersState {
 				 * :C, treat the variable value as a single big
 				 * word, possibly containing spaces. */
     VarExprFlags exprFlags;
+    ModStep *step;		/* While the modifiers are cached, the word
+				 * modifiers store their parsed arguments
+				 * here instead of freeing them. */
+    WordList words;		/* The words of val, if known */
+    WordList newWords;		/* The words of newVal, if newVal is NULL */
+    void **freePtr;		/* Where ApplyModifiers keeps val if it has
+				 * to be freed */
 } ApplyModifiersState;
 
+/* Return the value as a string, joining the words from the previous
+ * modifier if necessary. */
+static char *
+ApplyModifiersState_Val(ApplyModifiersState *st)
+{
+    if (st->val == NULL) {
+	st->val = WordList_Join(&st->words);
+	*st->freePtr = st->val;
+    }
+    return st->val;
+}
+
+/* Return the words of the value, as Str_Words(val, FALSE) would split it.
+ * The words from the previous modifier are used as they are if possible.
+ * They stay valid until the modifier is finished. */
+static Words *
+ApplyModifiersState_Words(ApplyModifiersState *st)
+{
+    const char *val;
+
+    if (st->words.words.words != NULL && st->words.exact)
+	return &st->words.words;
+
+    val = ApplyModifiersState_Val(st);
+    WordList_Free(&st->words);
+    st->words.words = Str_Words(val, FALSE);
+    st->words.exact = TRUE;
+    st->words.simple = strpbrk(val, "\"'\\") == NULL;
+    return &st->words.words;
+}
+
+/* Let the modifier rearrange the words of the value, which then become
+ * its result.  They are joined by spaces. */
+static Words *
+ApplyModifiersState_MoveWords(ApplyModifiersState *st)
+{
+    (void)ApplyModifiersState_Words(st);
+    st->newWords = st->words;
+    st->newWords.sep = ' ';	/* XXX: st->sep, for consistency */
+    st->newWords.inPlace = FALSE;
+    WordList_Init(&st->words);
+    st->newVal = NULL;
+    return &st->newWords.words;
+}
+
+/*-
+ *-----------------------------------------------------------------------
+ * Modify each of the words of the value using the given function.
+ *
+ * Input:
+ *	st		The state, containing the value to be modified
+ *	oneBigWord	Whether to treat the value as a single word
+ *	modifyWord	Function that modifies a single word
+ *	modifyWord_args Custom arguments for modifyWord
+ *
+ * Results:
+ *	st->newVal	A string of all the words modified appropriately,
+ *			or NULL if they are in st->newWords.
+ *	st->newWords	The modified words, for the next modifier.
+ *-----------------------------------------------------------------------
+ */
+static void
+ModifyWords(ApplyModifiersState *st, Boolean oneBigWord,
+	    ModifyWordsCallback modifyWord, void *modifyWord_args)
+{
+    SepBuf result;
+    Words *words;
+    WordList *newWords;
+    size_t *starts;
+    Boolean whole, simple;
+    size_t i, n;
+
+    SepBuf_Init(&result, st->sep);
+
+    if (oneBigWord) {
+	modifyWord(ApplyModifiersState_Val(st), &result, modifyWord_args);
+	st->newVal = SepBuf_Destroy(&result, FALSE);
+	return;
+    }
+
+    words = ApplyModifiersState_Words(st);
+
+    /* In debug mode, LogBeforeApply has already joined the words. */
+    VAR_DEBUG2("ModifyWords: split \"%s\" into %zu words\n",
+	       st->val, words->len);
+
+    /*
+     * Str_Words only splits at spaces and tabs, and it stops at a newline.
+     * ModifyWord_Loop may leave out the separator.
+     */
+    if ((st->sep != ' ' && st->sep != '\t') || modifyWord == ModifyWord_Loop) {
+	for (i = 0; i < words->len; i++) {
+	    modifyWord(words->words[i], &result, modifyWord_args);
+	    if (Buf_Len(&result.buf) > 0)
+		SepBuf_Sep(&result);
+	}
+	st->newVal = SepBuf_Destroy(&result, FALSE);
+	return;
+    }
+
+    /*
+     * Whole words in their original order are still the words that
+     * Str_Words would split the result into, and parts of simple words
+     * are still simple.  Other results are checked, since the next
+     * modifier needs to know whether Str_Words would split them
+     * differently.
+     */
+    whole = modifyWord == ModifyWord_Match ||
+	    modifyWord == ModifyWord_NoMatch ||
+	    modifyWord == ModifyWord_Copy;
+    simple = st->words.simple && (whole ||
+	     modifyWord == ModifyWord_Head || modifyWord == ModifyWord_Tail ||
+	     modifyWord == ModifyWord_Suffix || modifyWord == ModifyWord_Root);
+
+    starts = bmake_malloc((words->len + 1) * sizeof *starts);
+    n = 0;
+    for (i = 0; i < words->len; i++) {
+	size_t start = (size_t)Buf_Len(&result.buf);
+	Boolean addSep = result.needSep;
+
+	modifyWord(words->words[i], &result, modifyWord_args);
+	if ((size_t)Buf_Len(&result.buf) > start) {
+	    if (addSep)
+		start++;
+	    starts[n++] = start;
+	    SepBuf_Sep(&result);
+	}
+    }
+
+    newWords = &st->newWords;
+    newWords->words.freeIt = SepBuf_Destroy(&result, FALSE);
+    newWords->words.words = bmake_malloc((n + 1) * sizeof(char *));
+    newWords->words.len = n;
+    for (i = 0; i < n; i++) {
+	char *word = (char *)newWords->words.freeIt + starts[i];
+	if (i > 0)
+	    word[-1] = '\0';
+	newWords->words.words[i] = word;
+    }
+    newWords->words.words[n] = NULL;
+    free(starts);
+
+    if (!simple) {
+	simple = TRUE;
+	for (i = 0; i < n && simple; i++) {
+	    const char *word = newWords->words.words[i];
+	    simple = word[strcspn(word, " \t\n\"'\\")] == '\0';
+	}
+    }
+
+    newWords->sep = st->sep;
+    /* Str_Words splits an empty string into a single empty word. */
+    newWords->exact = n > 0 && (whole || simple);
+    newWords->simple = simple;
+    newWords->inPlace = TRUE;
+    st->newVal = NULL;
+}
+
 static void
 ApplyModifiersState_Define(ApplyModifiersState *st)
 {
@@ -2020,8 +2698,7 @@ ApplyModifier_Loop(const char **pp, ApplyModifiersState *st)
     args.eflags = st->eflags & (VARE_UNDEFERR | VARE_WANTRES);
     prev_sep = st->sep;
     st->sep = ' ';		/* XXX: should be st->sep for consistency */
-    st->newVal = ModifyWords(st->ctxt, st->sep, st->oneBigWord, st->val,
-			     ModifyWord_Loop, &args);
+    ModifyWords(st, st->oneBigWord, ModifyWord_Loop, &args);
     st->sep = prev_sep;
     Var_Delete(args.tvar, st->ctxt);
     free(args.tvar);
@@ -2080,7 +2757,7 @@ ApplyModifier_Defined(const char **pp, ApplyModifiersState *st)
     if (eflags & VARE_WANTRES) {
 	st->newVal = Buf_Destroy(&buf, FALSE);
     } else {
-	st->newVal = st->val;
+	st->newVal = ApplyModifiersState_Val(st);
 	Buf_Destroy(&buf, TRUE);
     }
     return AMR_OK;
@@ -2114,7 +2791,7 @@ ApplyModifier_Gmtime(const char **pp, ApplyModifiersState *st)
 	utc = 0;
 	*pp = mod + 6;
     }
-    st->newVal = VarStrftime(st->val, TRUE, utc);
+    st->newVal = VarStrftime(ApplyModifiersState_Val(st), TRUE, utc);
     return AMR_OK;
 }
 
@@ -2136,7 +2813,7 @@ ApplyModifier_Localtime(const char **pp, ApplyModifiersState *st)
 	utc = 0;
 	*pp = mod + 9;
     }
-    st->newVal = VarStrftime(st->val, FALSE, utc);
+    st->newVal = VarStrftime(ApplyModifiersState_Val(st), FALSE, utc);
     return AMR_OK;
 }
 
@@ -2147,7 +2824,7 @@ ApplyModifier_Hash(const char **pp, ApplyModifiersState *st)
     if (!ModMatch(*pp, "hash", st->endc))
 	return AMR_UNKNOWN;
 
-    st->newVal = VarHash(st->val);
+    st->newVal = VarHash(ApplyModifiersState_Val(st));
     *pp += 4;
     return AMR_OK;
 }
@@ -2199,8 +2876,9 @@ ApplyModifier_ShellCommand(const char **pp, ApplyModifiersState *st)
 	st->newVal = emptyString;
     free(cmd);
 
+    /* XXX: why still return AMR_OK? */
     if (errfmt != NULL)
-	Error(errfmt, st->val);	/* XXX: why still return AMR_OK? */
+	Error(errfmt, ApplyModifiersState_Val(st));
 
     ApplyModifiersState_Define(st);
     return AMR_OK;
@@ -2228,11 +2906,8 @@ ApplyModifier_Range(const char **pp, ApplyModifiersState *st)
 	*pp = mod + 5;
     }
 
-    if (n == 0) {
-	Words words = Str_Words(st->val, FALSE);
-	n = words.len;
-	Words_Free(words);
-    }
+    if (n == 0)
+	n = ApplyModifiersState_Words(st)->len;
 
     Buf_Init(&buf, 0);
 
@@ -2314,12 +2989,16 @@ ApplyModifier_Match(const char **pp, ApplyModifiersState *st)
 	free(old_pattern);
     }
 
-    VAR_DEBUG3("Pattern[%s] for [%s] is [%s]\n", st->v->name, st->val, pattern);
+    VAR_DEBUG3("Pattern[%s] for [%s] is [%s]\n",
+	       st->v->name, ApplyModifiersState_Val(st), pattern);
 
     callback = mod[0] == 'M' ? ModifyWord_Match : ModifyWord_NoMatch;
-    st->newVal = ModifyWords(st->ctxt, st->sep, st->oneBigWord, st->val,
-			     callback, pattern);
-    free(pattern);
+    ModifyWords(st, st->oneBigWord, callback, pattern);
+    if (st->step != NULL && !needSubst) {
+	st->step->callback = callback;
+	st->step->args = pattern;
+    } else
+	free(pattern);
     return AMR_OK;
 }
 
@@ -2381,11 +3060,18 @@ ApplyModifier_Subst(const char **pp, ApplyModifiersState *st)
 	break;
     }
 
-    st->newVal = ModifyWords(st->ctxt, st->sep, oneBigWord, st->val,
-			     ModifyWord_Subst, &args);
+    ModifyWords(st, oneBigWord, ModifyWord_Subst, &args);
 
-    free(lhs);
-    free(rhs);
+    if (st->step != NULL) {
+	struct ModifyWord_SubstArgs *cached = bmake_malloc(sizeof *cached);
+	*cached = args;
+	st->step->callback = ModifyWord_Subst;
+	st->step->args = cached;
+	st->step->oneBigWord = oneBigWord;
+    } else {
+	free(lhs);
+	free(rhs);
+    }
     return AMR_OK;
 }
 
@@ -2398,7 +3084,6 @@ ApplyModifier_Regex(const char **pp, ApplyModifiersState *st)
     char *re;
     struct ModifyWord_SubstRegexArgs args;
     Boolean oneBigWord;
-    int error;
     VarParseResult res;
 
     char delim = (*pp)[1];
@@ -2440,20 +3125,17 @@ ApplyModifier_Regex(const char **pp, ApplyModifiersState *st)
 	break;
     }
 
-    error = regcomp(&args.re, re, REG_EXTENDED);
+    args.rx = VarRegex_Get(re);
     free(re);
-    if (error) {
-	VarREError(error, &args.re, "Regex compilation error");
+    if (args.rx == NULL) {
 	free(args.replace);
 	return AMR_CLEANUP;
     }
 
-    args.nsub = args.re.re_nsub + 1;
+    args.nsub = args.rx->nsub;
     if (args.nsub > 10)
 	args.nsub = 10;
-    st->newVal = ModifyWords(st->ctxt, st->sep, oneBigWord, st->val,
-			     ModifyWord_SubstRegex, &args);
-    regfree(&args.re);
+    ModifyWords(st, oneBigWord, ModifyWord_SubstRegex, &args);
     free(args.replace);
     return AMR_OK;
 }
@@ -2464,19 +3146,13 @@ static ApplyModifierResult
 ApplyModifier_Quote(const char **pp, ApplyModifiersState *st)
 {
     if ((*pp)[1] == st->endc || (*pp)[1] == ':') {
-	st->newVal = VarQuote(st->val, **pp == 'q');
+	st->newVal = VarQuote(ApplyModifiersState_Val(st), **pp == 'q');
 	(*pp)++;
 	return AMR_OK;
     } else
 	return AMR_UNKNOWN;
 }
 
-static void
-ModifyWord_Copy(const char *word, SepBuf *buf, void *data MAKE_ATTR_UNUSED)
-{
-    SepBuf_AddStr(buf, word);
-}
-
 /* :ts<separator> */
 static ApplyModifierResult
 ApplyModifier_ToSep(const char **pp, ApplyModifiersState *st)
@@ -2540,8 +3216,7 @@ ApplyModifier_ToSep(const char **pp, ApplyModifiersState *st)
     }
 
 ok:
-    st->newVal = ModifyWords(st->ctxt, st->sep, st->oneBigWord, st->val,
-			     ModifyWord_Copy, NULL);
+    ModifyWords(st, st->oneBigWord, ModifyWord_Copy, NULL);
     return AMR_OK;
 }
 
@@ -2567,35 +3242,36 @@ ApplyModifier_To(const char **pp, ApplyModifiersState *st)
 
     /* Check for two-character options: ":tu", ":tl" */
     if (mod[1] == 'A') {	/* absolute path */
-	st->newVal = ModifyWords(st->ctxt, st->sep, st->oneBigWord, st->val,
-				 ModifyWord_Realpath, NULL);
+	ModifyWords(st, st->oneBigWord, ModifyWord_Realpath, NULL);
 	*pp = mod + 2;
 	return AMR_OK;
     }
 
     if (mod[1] == 'u') {	/* :tu */
+	const char *val = ApplyModifiersState_Val(st);
 	size_t i;
-	size_t len = strlen(st->val);
+	size_t len = strlen(val);
 	st->newVal = bmake_malloc(len + 1);
 	for (i = 0; i < len + 1; i++)
-	    st->newVal[i] = ch_toupper(st->val[i]);
+	    st->newVal[i] = ch_toupper(val[i]);
 	*pp = mod + 2;
 	return AMR_OK;
     }
 
     if (mod[1] == 'l') {	/* :tl */
+	const char *val = ApplyModifiersState_Val(st);
 	size_t i;
-	size_t len = strlen(st->val);
+	size_t len = strlen(val);
 	st->newVal = bmake_malloc(len + 1);
 	for (i = 0; i < len + 1; i++)
-	    st->newVal[i] = ch_tolower(st->val[i]);
+	    st->newVal[i] = ch_tolower(val[i]);
 	*pp = mod + 2;
 	return AMR_OK;
     }
 
     if (mod[1] == 'W' || mod[1] == 'w') { /* :tW, :tw */
 	st->oneBigWord = mod[1] == 'W';
-	st->newVal = st->val;
+	st->newVal = ApplyModifiersState_Val(st);
 	*pp = mod + 2;
 	return AMR_OK;
     }
@@ -2612,6 +3288,8 @@ ApplyModifier_Words(const char **pp, ApplyModifiersState *st)
     char *estr;
     char *ep;
     int first, last;
+    Words words;
+    char *oneWord[2];
     VarParseResult res;
 
     (*pp)++;			/* skip the '[' */
@@ -2632,10 +3310,7 @@ ApplyModifier_Words(const char **pp, ApplyModifiersState *st)
 	    st->newVal = bmake_strdup("1");
 	} else {
 	    Buffer buf;
-
-	    Words words = Str_Words(st->val, FALSE);
-	    size_t ac = words.len;
-	    Words_Free(words);
+	    size_t ac = ApplyModifiersState_Words(st)->len;
 
 	    Buf_Init(&buf, 4);	/* 3 digits + '\0' is usually enough */
 	    Buf_AddInt(&buf, (int)ac);
@@ -2647,14 +3322,14 @@ ApplyModifier_Words(const char **pp, ApplyModifiersState *st)
     if (estr[0] == '*' && estr[1] == '\0') {
 	/* Found ":[*]" */
 	st->oneBigWord = TRUE;
-	st->newVal = st->val;
+	st->newVal = ApplyModifiersState_Val(st);
 	goto ok;
     }
 
     if (estr[0] == '@' && estr[1] == '\0') {
 	/* Found ":[@]" */
 	st->oneBigWord = FALSE;
-	st->newVal = st->val;
+	st->newVal = ApplyModifiersState_Val(st);
 	goto ok;
     }
 
@@ -2684,7 +3359,7 @@ ApplyModifier_Words(const char **pp, ApplyModifiersState *st)
     if (first == 0 && last == 0) {
 	/* ":[0]" or perhaps ":[0..0]" */
 	st->oneBigWord = TRUE;
-	st->newVal = st->val;
+	st->newVal = ApplyModifiersState_Val(st);
 	goto ok;
     }
 
@@ -2693,7 +3368,16 @@ ApplyModifier_Words(const char **pp, ApplyModifiersState *st)
 	goto bad_modifier;
 
     /* Normal case: select the words described by seldata. */
-    st->newVal = VarSelectWords(st->sep, st->oneBigWord, st->val, first, last);
+    if (st->oneBigWord) {
+	/* fake what Str_Words() would do if there were only one word */
+	oneWord[0] = ApplyModifiersState_Val(st);
+	oneWord[1] = NULL;
+	words.words = oneWord;
+	words.len = 1;
+	words.freeIt = NULL;
+    } else
+	words = *ApplyModifiersState_Words(st);
+    st->newVal = VarSelectWords(st->sep, &words, first, last);
 
 ok:
     free(estr);
@@ -2721,12 +3405,20 @@ static ApplyModifierResult
 ApplyModifier_Order(const char **pp, ApplyModifiersState *st)
 {
     const char *mod = (*pp)++;	/* skip past the 'O' in any case */
+    Words *words;
+
+    if (mod[1] != st->endc && mod[1] != ':' &&
+	!((mod[1] == 'r' || mod[1] == 'x') &&
+	  (mod[2] == st->endc || mod[2] == ':')))
+	return AMR_BAD;
 
-    Words words = Str_Words(st->val, FALSE);
+    words = ApplyModifiersState_MoveWords(st);
+    /* A word with an unclosed quote may no longer be the last one. */
+    st->newWords.exact = st->newWords.simple;
 
     if (mod[1] == st->endc || mod[1] == ':') {
 	/* :O sorts ascending */
-	qsort(words.words, words.len, sizeof(char *), str_cmp_asc);
+	qsort(words->words, words->len, sizeof(char *), str_cmp_asc);
 
     } else if ((mod[1] == 'r' || mod[1] == 'x') &&
 	       (mod[2] == st->endc || mod[2] == ':')) {
@@ -2734,7 +3426,7 @@ ApplyModifier_Order(const char **pp, ApplyModifiersState *st)
 
 	if (mod[1] == 'r') {
 	    /* :Or sorts descending */
-	    qsort(words.words, words.len, sizeof(char *), str_cmp_desc);
+	    qsort(words->words, words->len, sizeof(char *), str_cmp_desc);
 
 	} else {
 	    /* :Ox shuffles
@@ -2745,19 +3437,15 @@ ApplyModifier_Order(const char **pp, ApplyModifiersState *st)
 	     * 0 with probability 1).
 	     */
 	    size_t i;
-	    for (i = words.len - 1; i > 0; i--) {
+	    for (i = words->len - 1; i > 0; i--) {
 		size_t rndidx = (size_t)random() % (i + 1);
-		char *t = words.words[i];
-		words.words[i] = words.words[rndidx];
-		words.words[rndidx] = t;
+		char *t = words->words[i];
+		words->words[i] = words->words[rndidx];
+		words->words[rndidx] = t;
 	    }
 	}
-    } else {
-	Words_Free(words);
-	return AMR_BAD;
     }
 
-    st->newVal = Words_JoinFree(words);
     return AMR_OK;
 }
 
@@ -2919,14 +3607,14 @@ ApplyModifier_Remember(const char **pp, ApplyModifiersState *st)
     if (mod[1] == '=') {
 	size_t n = strcspn(mod + 2, ":)}");
 	char *name = bmake_strldup(mod + 2, n);
-	Var_Set(name, st->val, st->ctxt);
+	Var_Set(name, ApplyModifiersState_Val(st), st->ctxt);
 	free(name);
 	*pp = mod + 2 + n;
     } else {
-	Var_Set("_", st->val, st->ctxt);
+	Var_Set("_", ApplyModifiersState_Val(st), st->ctxt);
 	*pp = mod + 1;
     }
-    st->newVal = st->val;
+    st->newVal = ApplyModifiersState_Val(st);
     return AMR_OK;
 }
 
@@ -2939,8 +3627,7 @@ ApplyModifier_WordFunc(const char **pp, ApplyModifiersState *st,
     if (delim != st->endc && delim != ':')
 	return AMR_UNKNOWN;
 
-    st->newVal = ModifyWords(st->ctxt, st->sep, st->oneBigWord,
-			     st->val, modifyWord, NULL);
+    ModifyWords(st, st->oneBigWord, modifyWord, NULL);
     (*pp)++;
     return AMR_OK;
 }
@@ -2949,7 +3636,17 @@ static ApplyModifierResult
 ApplyModifier_Unique(const char **pp, ApplyModifiersState *st)
 {
     if ((*pp)[1] == st->endc || (*pp)[1] == ':') {
-	st->newVal = VarUniq(st->val);
+	/* Remove adjacent duplicate words. */
+	Words *words = ApplyModifiersState_MoveWords(st);
+	if (words->len > 1) {
+	    size_t i, j;
+	    for (j = 0, i = 1; i < words->len; i++)
+		if (strcmp(words->words[i], words->words[j]) != 0 &&
+		    (++j != i))
+		    words->words[j] = words->words[i];
+	    words->len = j + 1;
+	    words->words[words->len] = NULL;
+	}
 	(*pp)++;
 	return AMR_OK;
     } else
@@ -3004,12 +3701,11 @@ ApplyModifier_SysV(const char **pp, ApplyModifiersState *st)
      * string. Note the pattern is anchored at the end.
      */
     (*pp)--;
-    if (lhs[0] == '\0' && st->val[0] == '\0') {
+    if (lhs[0] == '\0' && ApplyModifiersState_Val(st)[0] == '\0') {
 	st->newVal = st->val;	/* special case */
     } else {
 	struct ModifyWord_SYSVSubstArgs args = {st->ctxt, lhs, rhs};
-	st->newVal = ModifyWords(st->ctxt, st->sep, st->oneBigWord, st->val,
-				 ModifyWord_SYSVSubst, &args);
+	ModifyWords(st, st->oneBigWord, ModifyWord_SYSVSubst, &args);
     }
     free(lhs);
     free(rhs);
@@ -3026,7 +3722,7 @@ ApplyModifier_SunShell(const char **pp, ApplyModifiersState *st)
     if (p[1] == 'h' && (p[2] == st->endc || p[2] == ':')) {
 	if (st->eflags & VARE_WANTRES) {
 	    const char *errfmt;
-	    st->newVal = Cmd_Exec(st->val, &errfmt);
+	    st->newVal = Cmd_Exec(ApplyModifiersState_Val(st), &errfmt);
 	    if (errfmt)
 		Error(errfmt, st->val);
 	} else
@@ -3039,7 +3735,7 @@ ApplyModifier_SunShell(const char **pp, ApplyModifiersState *st)
 #endif
 
 static void
-LogBeforeApply(const ApplyModifiersState *st, const char *mod, const char endc)
+LogBeforeApply(ApplyModifiersState *st, const char *mod, const char endc)
 {
     char eflags_str[VarEvalFlags_ToStringSize];
     char vflags_str[VarFlags_ToStringSize];
@@ -3050,7 +3746,8 @@ LogBeforeApply(const ApplyModifiersState *st, const char *mod, const char endc)
     /* At this point, only the first character of the modifier can
      * be used since the end of the modifier is not yet known. */
     debug_printf("Applying ${%s:%c%s} to \"%s\" (%s, %s, %s)\n",
-		 st->v->name, mod[0], is_single_char ? "" : "...", st->val,
+		 st->v->name, mod[0], is_single_char ? "" : "...",
+		 ApplyModifiersState_Val(st),
 		 Enum_FlagsToString(eflags_str, sizeof eflags_str,
 				    st->eflags, VarEvalFlags_ToStringSpecs),
 		 Enum_FlagsToString(vflags_str, sizeof vflags_str,
@@ -3066,8 +3763,13 @@ LogAfterApply(ApplyModifiersState *st, const char *p, const char *mod)
     char eflags_str[VarEvalFlags_ToStringSize];
     char vflags_str[VarFlags_ToStringSize];
     char exprflags_str[VarExprFlags_ToStringSize];
-    const char *quot = st->newVal == var_Error ? "" : "\"";
-    const char *newVal = st->newVal == var_Error ? "error" : st->newVal;
+    const char *quot, *newVal;
+
+    /* The debug log shows the value as a string. */
+    if (st->newVal == NULL)
+	st->newVal = WordList_Join(&st->newWords);
+    quot = st->newVal == var_Error ? "" : "\"";
+    newVal = st->newVal == var_Error ? "error" : st->newVal;
 
     debug_printf("Result of ${%s:%.*s} is %s%s%s (%s, %s, %s)\n",
 		 st->v->name, (int)(p - mod), mod, quot, newVal, quot,
@@ -3146,6 +3848,85 @@ ApplyModifier(const char **pp, ApplyModifiersState *st)
     }
 }
 
+/* Apply a single modifier, falling back to the SysV modifier :from=to. */
+static ApplyModifierResult
+ApplyModifierOrSysV(const char **pp, ApplyModifiersState *st)
+{
+    ApplyModifierResult res = ApplyModifier(pp, st);
+
+#ifdef SYSVVARSUB
+    if (res == AMR_UNKNOWN)
+	res = ApplyModifier_SysV(pp, st);
+#endif
+    return res;
+}
+
+/* Return the length of the modifiers up to the closing brace, or 0 if they
+ * cannot be cached. */
+static size_t
+ModChain_TextLen(const char *p, char endc)
+{
+    const char *q;
+
+    /* Cached modifiers don't produce the debug output. */
+    if (endc == '\0' || DEBUG(VAR) || DEBUG(LINT))
+	return 0;
+
+    for (q = p; *q != endc; q++)
+	if (*q == '\0' || *q == '$')
+	    return 0;
+    return (size_t)(q - p);
+}
+
+/* Apply a modifier from the cache. */
+static ApplyModifierResult
+ModStep_Apply(const ModStep *step, const char **pp, ApplyModifiersState *st)
+{
+    if (step->callback == ModifyWord_Subst) {
+	struct ModifyWord_SubstArgs args =
+	    *(const struct ModifyWord_SubstArgs *)step->args;
+	args.matched = FALSE;
+	ModifyWords(st, step->oneBigWord, ModifyWord_Subst, &args);
+    } else if (step->callback != NULL) {
+	ModifyWords(st, st->oneBigWord, step->callback, step->args);
+    } else
+	return ApplyModifierOrSysV(pp, st);
+
+    *pp += step->len;
+    return AMR_OK;
+}
+
+static void
+ModChain_FreeSteps(ModStep *steps, unsigned int numSteps)
+{
+    unsigned int i;
+
+    for (i = 0; i < numSteps; i++) {
+	if (steps[i].callback == ModifyWord_Subst) {
+	    struct ModifyWord_SubstArgs *args = steps[i].args;
+	    free(UNCONST(args->lhs));
+	    free(UNCONST(args->rhs));
+	}
+	free(steps[i].args);
+    }
+}
+
+static void
+ModChain_Store(const Hash_Key *key, ModStep *steps, unsigned int numSteps)
+{
+    ModChain *chain;
+
+    if (numSteps == 0 || modChains.numEntries >= MODCHAIN_MAXENTRIES) {
+	ModChain_FreeSteps(steps, numSteps);
+	return;
+    }
+
+    chain = bmake_malloc(sizeof *chain + (numSteps - 1) * sizeof *steps);
+    chain->numSteps = numSteps;
+    memcpy(chain->steps, steps, numSteps * sizeof *steps);
+    Hash_SetValue(Hash_CreateEntryKey(&modChains, key, NULL), chain);
+}
+
 /* Apply any modifiers (such as :Mpattern or :@var@loop@ or :Q or ::=value). */
 static char *
 ApplyModifiers(
@@ -3164,17 +3945,41 @@ ApplyModifiers(
 	var_Error,		/* .newVal */
 	' ',			/* .sep */
 	FALSE,			/* .oneBigWord */
-	*exprFlags		/* .exprFlags */
+	*exprFlags,		/* .exprFlags */
+	NULL,			/* .step */
+	{ { NULL, 0, NULL }, ' ', FALSE, FALSE, FALSE }, /* .words */
+	{ { NULL, 0, NULL }, ' ', FALSE, FALSE, FALSE }, /* .newWords */
+	freePtr
     };
     const char *p;
     const char *mod;
     ApplyModifierResult res;
+    size_t chainLen;
+    Hash_Key chainKey;
+    ModChain *chain = NULL;	/* The cached modifiers */
+    ModStep steps[MODCHAIN_MAXSTEPS]; /* The modifiers to be cached */
+    unsigned int numSteps = 0;
+    Boolean caching = FALSE;
 
     assert(startc == '(' || startc == '{' || startc == '\0');
     assert(endc == ')' || endc == '}' || endc == '\0');
     assert(val != NULL);
 
     p = *pp;
+
+    chainLen = ModChain_TextLen(p, endc);
+    if (chainLen > 0) {
+	/* Include the closing brace, since it affects the parsing. */
+	Hash_InitKeyLen(&chainKey, p, chainLen + 1);
+	chain = Hash_FindValueKey(&modChains, &chainKey);
+	if (chain != NULL)
+	    modChainHits++;
+	else {
+	    modChainMisses++;
+	    caching = TRUE;
+	}
+    }
+
     while (*p != '\0' && *p != endc) {
 
 	if (*p == '$') {
@@ -3215,8 +4020,10 @@ ApplyModifiers(
 
 	    if (rval[0] != '\0') {
 		const char *rval_pp = rval;
-		st.val = ApplyModifiers(&rval_pp, st.val, '\0', '\0', v,
+		st.val = ApplyModifiers(&rval_pp, ApplyModifiersState_Val(&st),
+					'\0', '\0', v,
 					&st.exprFlags, ctxt, eflags, freePtr);
+		WordList_Free(&st.words);
 		if (st.val == var_Error
 		    || (st.val == varUndefined && !(st.eflags & VARE_UNDEFERR))
 		    || *rval_pp != '\0') {
@@ -3242,14 +4049,24 @@ ApplyModifiers(
 	if (DEBUG(VAR))
 	    LogBeforeApply(&st, mod, endc);
 
-	res = ApplyModifier(&p, &st);
-
-#ifdef SYSVVARSUB
-	if (res == AMR_UNKNOWN) {
-	    assert(p == mod);
-	    res = ApplyModifier_SysV(&p, &st);
+	if (chain != NULL) {
+	    assert(numSteps < chain->numSteps);
+	    res = ModStep_Apply(&chain->steps[numSteps++], &p, &st);
+	} else if (caching && numSteps < MODCHAIN_MAXSTEPS) {
+	    st.step = &steps[numSteps++];
+	    st.step->callback = NULL;
+	    st.step->args = NULL;
+	    st.step->oneBigWord = FALSE;
+	    res = ApplyModifierOrSysV(&p, &st);
+	    st.step->len = (size_t)(p - mod);
+	    st.step = NULL;
+	} else {
+	    if (caching) {
+		ModChain_FreeSteps(steps, numSteps);
+		caching = FALSE;
+	    }
+	    res = ApplyModifierOrSysV(&p, &st);
 	}
-#endif
 
 	if (res == AMR_UNKNOWN) {
 	    Error("Unknown modifier '%c'", *mod);
@@ -3262,24 +4079,33 @@ ApplyModifiers(
 	if (res == AMR_BAD)
 	    goto bad_modifier;
 
+	if (caching && (res != AMR_OK || st.newVal == var_Error ||
+			(*p != ':' && *p != endc))) {
+	    ModChain_FreeSteps(steps, numSteps);
+	    caching = FALSE;
+	}
+
 	if (DEBUG(VAR))
 	    LogAfterApply(&st, p, mod);
 
-	if (st.newVal != st.val) {
+	if (st.newVal == NULL || st.newVal != st.val) {
 	    if (*freePtr) {
 		free(st.val);
 		*freePtr = NULL;
 	    }
+	    WordList_Free(&st.words);
 	    st.val = st.newVal;
-	    if (st.val != var_Error && st.val != varUndefined &&
-		st.val != emptyString) {
+	    if (st.val != NULL && st.val != var_Error &&
+		st.val != varUndefined && st.val != emptyString) {
 		*freePtr = st.val;
 	    }
+	    st.words = st.newWords;
+	    WordList_Init(&st.newWords);
 	}
 	if (*p == '\0' && st.endc != '\0') {
 	    Error("Unclosed variable specification (expecting '%c') "
 		  "for \"%s\" (value \"%s\") modifier %c",
-		  st.endc, st.v->name, st.val, *mod);
+		  st.endc, st.v->name, ApplyModifiersState_Val(&st), *mod);
 	} else if (*p == ':') {
 	    p++;
 	} else if (DEBUG(LINT) && *p != '\0' && *p != endc) {
@@ -3289,6 +4115,14 @@ ApplyModifiers(
 	}
     }
 out:
+    if (caching) {
+	if (p == *pp + chainLen)
+	    ModChain_Store(&chainKey, steps, numSteps);
+	else
+	    ModChain_FreeSteps(steps, numSteps);
+    }
+    (void)ApplyModifiersState_Val(&st);
+    WordList_Free(&st.words);
     *pp = p;
     assert(st.val != NULL);	/* Use var_Error or varUndefined instead. */
     *exprFlags = st.exprFlags;
@@ -3299,6 +4133,10 @@ bad_modifier:
 	  (int)strcspn(mod, ":)}"), mod, st.v->name);
 
 cleanup:
+    if (caching)
+	ModChain_FreeSteps(steps, numSteps);
+    WordList_Free(&st.words);
+    WordList_Free(&st.newWords);
     *pp = p;
     free(*freePtr);
     *freePtr = NULL;
@@ -3553,6 +4391,8 @@ Var_Parse(const char **pp, GNode *ctxt, VarEvalFlags eflags,
     } else {
 	size_t namelen;
 	char *varname;
+	const char *cname;
+	Hash_Key key;
 
 	endc = startc == '(' ? ')' : '}';
 
@@ -3571,7 +4411,13 @@ Var_Parse(const char **pp, GNode *ctxt, VarEvalFlags eflags,
 	    return VPR_PARSE_MSG;
 	}
 
-	v = VarFind(varname, ctxt, FIND_ENV | FIND_GLOBAL | FIND_CMD);
+	/* The name is hashed only once, for all the contexts. */
+	cname = CanonicalVarname(varname);
+	if (cname == varname)
+	    Hash_InitKeyLen(&key, varname, namelen);
+	else
+	    Hash_InitKey(&key, cname);
+	v = VarFindKey(&key, ctxt, FIND_ENV | FIND_GLOBAL | FIND_CMD);
 
 	/* At this point, p points just after the variable name,
 	 * either at ':' or at endc. */
@@ -3842,6 +4688,12 @@ Var_Init(void)
     VAR_INTERNAL = Targ_NewGN("Internal");
     VAR_GLOBAL = Targ_NewGN("Global");
     VAR_CMD = Targ_NewGN("Command");
+    Hash_InitTable(&modChains);
+#ifndef NO_REGEX
+    Hash_InitTable(&regexCache);
+#endif
+    Hash_InitTable(&envVars);
+    VarEnvLoad();
 }
 
 
@@ -3849,12 +4701,38 @@ void
 Var_End(void)
 {
     Var_Stats();
+#ifdef CLEANUP
+    {
+	Hash_Search search;
+	Hash_Entry *he;
+
+	for (he = Hash_EnumFirst(&modChains, &search); he != NULL;
+	     he = Hash_EnumNext(&search)) {
+	    ModChain *chain = Hash_GetValue(he);
+	    ModChain_FreeSteps(chain->steps, chain->numSteps);
+	    free(chain);
+	}
+	Hash_DeleteTable(&modChains);
+    }
+#ifndef NO_REGEX
+    while (regexLast != NULL)
+	VarRegex_Evict();
+    Hash_DeleteTable(&regexCache);
+#endif
+#endif
 }
 
 void
 Var_Stats(void)
 {
     Hash_DebugStats(&VAR_GLOBAL->context, "VAR_GLOBAL");
+    Hash_DebugStats(&modChains, "modifiers");
+    DEBUG2(HASH, "Var_Stats: modifier cache: %lu hits, %lu misses\n",
+	   modChainHits, modChainMisses);
+#ifndef NO_REGEX
+    DEBUG2(HASH, "Var_Stats: regex cache: %lu hits, %lu misses\n",
+	   regexHits, regexMisses);
+#endif
 }
 
 
@@ -3870,5 +4748,41 @@ VarPrintVar(void *vp, void *data MAKE_ATTR_UNUSED)
 void
 Var_Dump(GNode *ctxt)
 {
+    int i;
+
+    for (i = 0; i < GNODE_LOCALVARS; i++)
+	if (ctxt->localVars[i] != NULL)
+	    VarPrintVar(ctxt->localVars[i], NULL);
     Hash_ForEach(&ctxt->context, VarPrintVar, NULL);
 }
+
+/* Append the variables of a global context to the buffer, sorted by name,
+ * for the key of the snapshot of the system makefile.  The variables that
+ * differ in each run of make are left out. */
+void
+Var_AppendState(Buffer *buf, GNode *ctxt)
+{
+    Hash_Search search;
+    Hash_Entry *he;
+    const char **names;
+    unsigned int i, n = 0;
+
+    names = bmake_malloc((ctxt->context.numEntries + 1) * sizeof names[0]);
+    for (he = Hash_EnumFirst(&ctxt->context, &search); he != NULL;
+	 he = Hash_EnumNext(&search)) {
+	if (strcmp(he->name, ".MAKE.PID") == 0 ||
+	    strcmp(he->name, ".MAKE.PPID") == 0)
+	    continue;
+	names[n++] = he->name;
+    }
+    qsort(names, n, sizeof names[0], str_cmp_asc);
+
+    for (i = 0; i < n; i++) {
+	Var *v = Hash_FindValue(&ctxt->context, names[i]);
+	Buf_AddStr(buf, names[i]);
+	Buf_AddByte(buf, v->flags & VAR_EXPORTED ? '!' : '=');
+	Buf_AddStr(buf, Buf_GetAll(&v->val, NULL));
+	Buf_AddByte(buf, '\n');
+    }
+    free(names);
+}